@@ -23,7 +23,8 @@ IndexManager::~IndexManager()
 
 RC IndexManager::createFile(const string &fileName)
 {
-    return pfm->createFile(fileName);
+    // entry changes reach the log through writePage and appendPage
+    return pfm->createFile(fileName, FILE_LOGGED | FILE_CHECKSUM);
 }
 
 RC IndexManager::destroyFile(const string &fileName)
@@ -49,12 +50,20 @@ RC IndexManager::openFile(const string &fileName, IXFileHandle &ixFileHandle)
         if (handle->appendPage(data) == -1) {
             return -1;
         }
+        handle->setIndexRoot(0);
     } else {
-        ixFileHandle.getHandle()->readPage(0, data);
+        // a crashed handle may not have saved the header, the first root is page 0
+        if (handle->getIndexRoot() == NO_PAGE) {
+            handle->setIndexRoot(0);
+        }
+        // the root moves when it splits, the file header says where it is now
+        if (handle->readPage(handle->getIndexRoot(), data) == -1) {
+            return -1;
+        }
     }
 
     ixFileHandle.setRoot(data);
-    ixFileHandle.getHandle()->currentPageNum = 0; // Fix to compensate for close/open file
+    ixFileHandle.setRootPageNum(handle->getIndexRoot());
     return 0;
 }
 
@@ -63,6 +72,7 @@ RC IndexManager::closeFile(IXFileHandle &ixfileHandle)
     FileHandle* handle = ixfileHandle.getHandle();
     void *root =ixfileHandle.getRoot();
     handle->writePage(ixfileHandle.getRootPageNum(), root);
+    handle->setIndexRoot(ixfileHandle.getRootPageNum());
     if (pfm->closeFile(*handle) == -1) return -1;
     delete handle;
     free(root);
@@ -82,7 +92,7 @@ RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
         // Test if node is full (This is what makes top-down, top-down
         if(!hasEnoughSpace(child, attribute)) {
             // if not enough space we need to split
-            splitChild(child, parent, attribute, ixFileHandle, key, childPageNum, parentPageNum);
+            RC rc = splitChild(child, parent, attribute, ixFileHandle, key, childPageNum, parentPageNum);
 
             // if parent != root, free
             if (parentPageNum != ixFileHandle.getRootPageNum()) {
@@ -96,6 +106,9 @@ RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
                 free(child);
                 child = NULL;
             }
+            if (rc == -1) {
+                return -1;
+            }
             return insertEntry(ixFileHandle, attribute, key, rid);
         }
 
@@ -110,14 +123,16 @@ RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
             void *rightPointerData = malloc(PAGE_SIZE);
 
             // Initialize Left Pointer
-            int leftPointerNum = ixFileHandle.getAvailablePageNumber();
-            ixFileHandle.initializeNewNode(leftPointerData, TypeLeaf);
-            ixFileHandle.getHandle()->appendPage(leftPointerData);
+            int leftPointerNum = ixFileHandle.allocateNode(leftPointerData, TypeLeaf);
 
             // Initialize Right Pointer
-            int rightPointerNum = ixFileHandle.getAvailablePageNumber();
-            ixFileHandle.initializeNewNode(rightPointerData, TypeLeaf);
-            ixFileHandle.getHandle()->appendPage(rightPointerData);
+            int rightPointerNum = leftPointerNum == -1 ? -1 : ixFileHandle.allocateNode(rightPointerData, TypeLeaf);
+            if (rightPointerNum == -1) {
+                // no page for the leaves, leave the root without them
+                free(leftPointerData);
+                free(rightPointerData);
+                return -1;
+            }
 
             // Link left pointer to right pointer
             ixFileHandle.setRightPointer(leftPointerData, rightPointerNum);
@@ -181,7 +196,7 @@ RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
     // If the node does not have enough space, we need to split the node
     if(!hasEnoughSpace(child, attribute)) {
         // if not enough space we need to split
-        splitChild(child, parent, attribute, ixFileHandle, key, childPageNum, parentPageNum);
+        RC rc = splitChild(child, parent, attribute, ixFileHandle, key, childPageNum, parentPageNum);
 
         // if parent != root, free
         if (parentPageNum != ixFileHandle.getRootPageNum()) {
@@ -195,6 +210,9 @@ RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
             free(child);
             child = NULL;
         }
+        if (rc == -1) {
+            return -1;
+        }
 
         // Now the parent and children have been created/modified, reinsert into tree
         return insertEntry(ixFileHandle, attribute, key, rid);
@@ -320,6 +338,10 @@ RC IndexManager::scan(IXFileHandle &ixfileHandle,
     // find the first leaf node that contains the lowKey
     if (lowKey == NULL) {
         while(ixfileHandle.getNodeType(searchNode) != TypeLeaf) {
+            // the node above the leaf lists the leaves to read ahead
+            if (parentNode == NULL) parentNode = malloc(PAGE_SIZE);
+            memcpy((char *) parentNode, (char *) searchNode, PAGE_SIZE);
+
             // test the left node, if its null increase the offset and go right
             // not having a left node will only happen if the left node is dead (deleted)
             if(!ixfileHandle.isLeftNodeNull(searchNode, searchOffset, searchPageNum)) {
@@ -333,6 +355,7 @@ RC IndexManager::scan(IXFileHandle &ixfileHandle,
 
         // once we have found our left-most leaf we need to save it to the scanner
         ix_ScanIterator.setLeafNode(searchNode);
+        if (parentNode != NULL) ix_ScanIterator.setParentNode(parentNode, searchPageNum);
     } else {
         // find the leaf node where the lowKey is located, we'll let geNextEntry() worry about inclusive
         while(ixfileHandle.getNodeType(searchNode) != TypeLeaf) {
@@ -343,7 +366,9 @@ RC IndexManager::scan(IXFileHandle &ixfileHandle,
             }
         }
         ix_ScanIterator.setLeafNode(searchNode);
+        if (parentNode != NULL) ix_ScanIterator.setParentNode(parentNode, searchPageNum);
     }
+    ix_ScanIterator.readAhead();
     // let's set our type and functions
     switch(attribute.type) {
         case TypeInt:
@@ -593,13 +618,12 @@ RC IndexManager::splitChild(void* child, void *parent
         case TypeRoot:
             //printBtree(ixFileHandle, attribute);
             // create a new root node
-            parentPageNum = ixFileHandle.getAvailablePageNumber();
             parent = malloc(PAGE_SIZE);
-            ixFileHandle.initializeNewNode(parent, TypeRoot);
-            
-            // in order for getAvailablePageNumber() to work on the right page 
-            // we need to append the new root now
-            ixFileHandle.getHandle()->appendPage(parent);
+            parentPageNum = ixFileHandle.allocateNode(parent, TypeRoot);
+            if (parentPageNum == -1) {
+                free(parent);
+                return -1;
+            }
 
             switch (attribute.type) {
                 case TypeInt:
@@ -638,10 +662,14 @@ RC IndexManager::splitChild(void* child, void *parent
                 currentDirectorOffset = nextDirectorOffset;
             }
             // Initialize right page
-            rightPageNum = ixFileHandle.getAvailablePageNumber();
             rightPage = malloc(PAGE_SIZE);
-            ixFileHandle.initializeNewNode(rightPage, TypeNode);
-            ixFileHandle.getHandle()->appendPage(rightPage);
+            rightPageNum = ixFileHandle.allocateNode(rightPage, TypeNode);
+            if (rightPageNum == -1) {
+                // nothing has been written yet, the root stays as it was
+                free(rightPage);
+                free(parent);
+                return -1;
+            }
 
             // Save copy data to right page
             shiftedSize = freeSpaceOffset - splitPosition;
@@ -739,9 +767,13 @@ RC IndexManager::splitChild(void* child, void *parent
                 currentDirectorOffset = nextDirectorOffset;
             }
             // Initialize right page
-            rightPageNum = ixFileHandle.getAvailablePageNumber();
             rightPage = malloc(PAGE_SIZE);
-            ixFileHandle.initializeNewNode(rightPage, TypeNode);
+            rightPageNum = ixFileHandle.allocateNode(rightPage, TypeNode);
+            if (rightPageNum == -1) {
+                // nothing has been written yet, the node stays as it was
+                free(rightPage);
+                return -1;
+            }
 
             // Save copy data to right page
             shiftedSize = freeSpaceOffset - splitPosition;
@@ -789,7 +821,7 @@ RC IndexManager::splitChild(void* child, void *parent
 
             // I think here we need to write to write our pages to file for all pages
             ixFileHandle.getHandle()->writePage(childPageNum, child);
-            ixFileHandle.getHandle()->appendPage(rightPage);
+            ixFileHandle.getHandle()->writePage(rightPageNum, rightPage);
 
             // free up the right page
             if (rightPage != NULL) {
@@ -835,9 +867,13 @@ RC IndexManager::splitChild(void* child, void *parent
             }
 
             // Initialize right page
-            rightPageNum = ixFileHandle.getAvailablePageNumber();
             rightPage = malloc(PAGE_SIZE);
-            ixFileHandle.initializeNewNode(rightPage, TypeLeaf);
+            rightPageNum = ixFileHandle.allocateNode(rightPage, TypeLeaf);
+            if (rightPageNum == -1) {
+                // nothing has been written yet, the leaf stays as it was
+                free(rightPage);
+                return -1;
+            }
 
             // Save copy data to right page
             shiftedSize = freeSpaceOffset - splitPosition;
@@ -875,7 +911,7 @@ RC IndexManager::splitChild(void* child, void *parent
 
             // I think here we need to write to write our pages to file for all pages
             ixFileHandle.getHandle()->writePage(childPageNum, child);
-            ixFileHandle.getHandle()->appendPage(rightPage);
+            ixFileHandle.getHandle()->writePage(rightPageNum, rightPage);
 
             // free up the right page
             if (directorKey != NULL) free(directorKey);
@@ -1600,6 +1636,7 @@ RC IndexManager::getKeysInNonLeaf(IXFileHandle &ixFileHandle
 IX_ScanIterator::IX_ScanIterator()
 {
     ixFileHandle = NULL;
+    leavesInFlight = 0;
     leafNode = malloc(PAGE_SIZE);
     currentLeafOffset = 0;
     keyIndex = 0;
@@ -1624,7 +1661,20 @@ RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
         if (currentLeafOffset >= freeSpaceOffset && keyIndex == keyRids.size()) {
             nextPageNum = ixFileHandle->getRightPointer(leafNode);
             if (nextPageNum == -1) return IX_EOF;
-            ixFileHandle->getHandle()->readPage(nextPageNum, leafNode);
+
+            // the sibling is copied out like the first leaf, an insert or a delete
+            // during the scan must not move the entries under our offsets
+            if (ixFileHandle->getHandle()->readPage(nextPageNum, leafNode) == -1) return -1;
+
+            // the window follows the siblings for as long as no split has changed them
+            if (!aheadLeaves.empty() && aheadLeaves.front() == nextPageNum) {
+                aheadLeaves.pop_front();
+                if (leavesInFlight > 0) leavesInFlight--;
+            } else {
+                aheadLeaves.clear();
+                leavesInFlight = 0;
+            }
+            readAhead();
             freeSpace = IXFileHandle::getFreeSpace(leafNode);
             freeSpaceOffset = IXFileHandle::getFreeSpaceOffset(freeSpace);
             currentLeafOffset = 0;
@@ -1874,6 +1924,57 @@ RID IX_ScanIterator::getNextRid() {
     return keyRids[keyIndex];
 }
 
+void IX_ScanIterator::setParentNode(void *parent, int leafPageNum)
+{
+    // a node holds a pointer before, between and after its keys, the pointers
+    // after the first leaf are its right siblings in key order
+    aheadLeaves.clear();
+    leavesInFlight = 0;
+    int freeSpaceOffset = IXFileHandle::getFreeSpaceOffset(IXFileHandle::getFreeSpace(parent));
+    bool afterLeaf = false;
+    int offset = 0;
+    while (offset + (int) sizeof(int) <= freeSpaceOffset) {
+        int childPageNum;
+        memcpy(&childPageNum, (char *) parent + offset, sizeof(int));
+        offset += sizeof(int);
+        if (afterLeaf && childPageNum >= 0) {
+            aheadLeaves.push_back(childPageNum);
+        }
+        if (childPageNum == leafPageNum) {
+            afterLeaf = true;
+        }
+
+        // skip the key that follows the pointer
+        if (offset >= freeSpaceOffset) {
+            break;
+        }
+        if (attribute->type == TypeVarChar) {
+            int length;
+            memcpy(&length, (char *) parent + offset, sizeof(int));
+            offset += sizeof(int) + length;
+        } else {
+            offset += sizeof(int);
+        }
+    }
+}
+
+void IX_ScanIterator::readAhead()
+{
+    // past the leaves the parent listed only the right pointer tells what comes next
+    FileHandle *handle = ixFileHandle->getHandle();
+    if (aheadLeaves.empty()) {
+        int rightPageNum = ixFileHandle->getRightPointer(leafNode);
+        if (rightPageNum != -1) {
+            handle->prefetchPages(rightPageNum, 1);
+        }
+        return;
+    }
+    while (leavesInFlight < aheadLeaves.size() && leavesInFlight < IX_READ_AHEAD_LEAVES) {
+        handle->prefetchPages(aheadLeaves[leavesInFlight], 1);
+        leavesInFlight++;
+    }
+}
+
 RC IX_ScanIterator::close()
 {
     hasBegan = false;
@@ -1897,7 +1998,7 @@ RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePa
 }
 
 int IXFileHandle::initializeNewNode(void *data, NodeType type) {
-    // initially set the page to 4096 0's
+    // initially zero the whole page
     memset(data, 0, PAGE_SIZE);
 
     // initializes the free space slot with the free space value
@@ -2023,16 +2124,15 @@ void IX_ScanIterator::setHighKeyValues(const void *highK, bool highKInc, const A
     highKeyInclusive = highKInc;
 }
 
-int IXFileHandle::getAvailablePageNumber() {
-    // If there is a page open in freePages use one of those first to reduce File size
-    if (this->freePages.size() != 0) {
-       int freePage = freePages.front();
-       freePages.erase(freePages.begin());
-       return freePage;
-    }
+int IXFileHandle::allocateNode(void *data, NodeType type) {
+    initializeNewNode(data, type);
 
-    // else return numPages
-    return handle->numPages;
+    // a page freed in the file is used before the file grows
+    PageNum pageNum;
+    if (handle->allocatePage(data, pageNum) == -1) {
+        return -1;
+    }
+    return pageNum;
 }
 
 void IX_PrintError (RC rc)
@@ -3,19 +3,21 @@
 
 #include <vector>
 #include <string>
+#include <deque>
 
 #include "../rbf/rbfm.h"
 
 # define IX_EOF (-1)  // end of the index scan
 
 // Constants
-const int NODE_FREE = PAGE_SIZE - sizeof(int);
-const int NODE_RIGHT = PAGE_SIZE - ((sizeof(int) * 2));
-const int NODE_TYPE = PAGE_SIZE - ((sizeof(int) * 3));
+const int NODE_FREE = PAGE_DATA_SIZE - sizeof(int);
+const int NODE_RIGHT = PAGE_DATA_SIZE - ((sizeof(int) * 2));
+const int NODE_TYPE = PAGE_DATA_SIZE - ((sizeof(int) * 3));
 const int RID_SIZE = 2 * sizeof(int);
 const int SPLIT_THRESHOLD = PAGE_SIZE / 2;
 
-const int DEFAULT_FREE = PAGE_SIZE - (sizeof(int) * 3);
+const int DEFAULT_FREE = PAGE_DATA_SIZE - (sizeof(int) * 3);
+const unsigned IX_READ_AHEAD_LEAVES = 16;   // sibling leaves a scan keeps in flight, as many pages as the record scan
 
 // Nodes
 typedef enum { TypeNode = 10, TypeLeaf = 11, TypeRoot = 12} NodeType;
@@ -127,7 +129,8 @@ class IX_ScanIterator {
         void setAttribute(const Attribute &attr) { attribute = &attr; };
         void setLowKeyValues(const void *lowKey, bool lowKeyInclusive, const Attribute &attribute);
         void setHighKeyValues(const void *highKey, bool highKeyInclusive, const Attribute &attribute);
-        void setLeafNode(void *node) { memcpy((char *) leafNode, (char *) node, PAGE_SIZE); };
+        void setLeafNode(void *node) { memcpy((char *) leafNode, (char *) node, PAGE_SIZE); aheadLeaves.clear(); leavesInFlight = 0; };
+        void setParentNode(void *parent, int leafPageNum);  // the leaves after the first one are read ahead from its parent
         void setType(void (*f)(void*&, RID&, void*, int&)) { getKey = f; };
         void setFunc(bool (*f)(void*, const void*, const void*, void*, int, bool, bool)) { compareTypeFunc = f; };
         void setLeafOffset(int newOffset) { currentLeafOffset = newOffset; };
@@ -135,6 +138,7 @@ class IX_ScanIterator {
         void setKeyIndex(int index) { keyIndex = index; };
         int getLeafOffset() { return currentLeafOffset; };
         RID getNextRid();
+        void readAhead();                                   // start reading the leaves after the one walked
 
         // static functions used to extract types
         static void getIntType(void *&type, RID &rid, void *node, int &offset);
@@ -145,7 +149,7 @@ class IX_ScanIterator {
         static bool compareVarChars(void *incomingKey, const void *low, const void *high, void *node, int offset, bool lowInc, bool highInc);
 
     private:
-        void *leafNode;
+        void *leafNode;   // private copy of the leaf being walked
         IXFileHandle *ixFileHandle;
         const Attribute *attribute;
         const void *lowKey;
@@ -158,6 +162,8 @@ class IX_ScanIterator {
         bool (*compareTypeFunc)(void*, const void*, const void*, void*, int, bool, bool); 
         vector<RID> keyRids; // this is iterated for single or multiple rids for a key
         int keyIndex; // this is reset to 0 when a new key is discovered
+        deque<int> aheadLeaves; // leaves after the walked one, in key order, as the parent of the first leaf lists them
+        unsigned leavesInFlight; // the first of aheadLeaves whose reads were started
 };
 
 
@@ -184,7 +190,7 @@ class IXFileHandle {
         int getRightPointer(void *node);
         void setRightPointer(void *node, int rightPageNum);
         int initializeNewNode(void *data, NodeType type); // Initializes a new node, setting it's free space and node type
-        int getAvailablePageNumber(); // This helper function will get the first available page
+        int allocateNode(void *data, NodeType type); // Initializes a new node and writes it to a free page of the file, -1 on failure
 
         // static functions that don't require an instance of ixFileHandler
         static int getFreeSpace(void *data);
@@ -198,7 +204,6 @@ class IXFileHandle {
 
     private:
         FileHandle *handle;
-        vector<int> freePages; // when a page becomes free on delete, it is added to this list.  This will be used first when opening a new page.
 
 };
 
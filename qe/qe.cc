@@ -7,10 +7,11 @@ Filter::Filter(Iterator* input, const Condition &condition) {
     //string attr = condition.bRhsIsAttr ? condition.rhsAttr : condition.lhsAttr;
 
     // initializes to return all attributes
-    vector<Attribute> attrs;
     in->getAttributes(attrs);
 
     // Search for left and right condition positions
+    leftConditionPos = -1;
+    rightConditionPos = -1;
     for(unsigned i = 0; i < attrs.size(); ++i)
     {
         if (attrs[i].name == condition.lhsAttr) {
@@ -27,44 +28,26 @@ Filter::Filter(Iterator* input, const Condition &condition) {
 }
 
 RC Filter::getNextTuple(void *data) {
-    // loop until a tuple is found that satisfies the condition
-    vector<Attribute> attrs;
-    in->getAttributes(attrs);
-
     // null indicator information
     int attributeCount = attrs.size();
     int indicatorSize = 1 + ((attributeCount - 1) / 8);
-    int offset = indicatorSize;
-
-    void* leftValue = malloc(PAGE_SIZE);
-    void* rightValue = malloc(PAGE_SIZE);
 
+    // loop until a tuple is found that satisfies the condition, the values
+    // are compared where they lie in the tuple
     while (in->getNextTuple(data) != -1) {
-        // search for condition value
-        for (int i = 0; i <  attrs.size(); i++) {
-            // TODO Handle Nulls
-            // we are at the position, test its value
+        const char *leftValue = NULL;
+        const char *rightValue = NULL;
+        int offset = indicatorSize;
+        for (int i = 0; i < attributeCount; i++) {
+            // a null value takes no room and matches nothing
+            if (RecordBasedFileManager::isFieldNull(data, i)) {
+                continue;
+            }
             if (leftConditionPos == i) {
-                switch (leftConditionAttr.type) {
-                case TypeInt: memcpy((char*)leftValue, (char *) data + offset, sizeof(int));
-                    break;
-                case TypeReal: memcpy((char*)leftValue, (char *) data + offset, sizeof(float));
-                    break;
-                case TypeVarChar: memcpy((char*)leftValue, (char *) data + offset, leftConditionAttr.length + sizeof(int));
-                    break;
-                }
-
+                leftValue = (char *) data + offset;
             }
-
             if (filterCondition.bRhsIsAttr && rightConditionPos == i) {
-                switch (rightConditoinAttr.type) {
-                case TypeInt: memcpy((char*)rightValue, (char *) data + offset, sizeof(int));
-                    break;
-                case TypeReal: memcpy((char*)rightValue, (char *) data + offset, sizeof(float));
-                    break;
-                case TypeVarChar: memcpy((char*)rightValue, (char *) data + offset, rightConditoinAttr.length + sizeof(int));
-                    break;
-                }
+                rightValue = (char *) data + offset;
             }
 
             // skip over the attribute
@@ -83,20 +66,20 @@ RC Filter::getNextTuple(void *data) {
                 }
         }
 
-        if ((filterCondition.bRhsIsAttr && compareValues(leftValue, rightValue))
-            || compareValues(leftValue, filterCondition.rhsValue.data)){
+        if (leftValue == NULL) {
+            continue;
+        }
+        if (filterCondition.bRhsIsAttr ? rightValue != NULL && compareValues(leftValue, rightValue)
+                                       : compareValues(leftValue, filterCondition.rhsValue.data)) {
             return 0;
         }
-
-        // reset offset
-        offset = indicatorSize;
     }
 
     // if it reached this point, we have reached the end of the tuples
     return -1;
 }
 
-bool Filter::compareValues(void *left, void* right) {
+bool Filter::compareValues(const void *left, const void *right) {
     switch (leftConditionAttr.type) {
     case TypeInt:
         int leftInt;
@@ -138,25 +121,23 @@ bool Filter::compareValues(void *left, void* right) {
     case TypeVarChar:
         int leftLength;
         memcpy(&leftLength, (char *) left, sizeof(int));
-        char* leftVal = new char[leftLength + 1];
-        memcpy(leftVal, (char *) left + sizeof(int), leftLength);
-        leftVal[leftLength] = '\0';
-        string leftVarChar = std::string(leftVal);
 
         int rightLength;
         memcpy(&rightLength, (char *) right, sizeof(int));
-        char* rightVal = new char[rightLength + 1];
-        memcpy(rightVal, (char *) right + sizeof(int), rightLength);
-        rightVal[rightLength] = '\0';
-        string rightVarChar = std::string(rightVal);
+
+        // compare the characters in place, the shorter string goes first on a tie
+        int cmp = memcmp((char *) left + sizeof(int), (char *) right + sizeof(int), min(leftLength, rightLength));
+        if (cmp == 0) {
+            cmp = leftLength - rightLength;
+        }
 
         switch(filterCondition.op) {
-            case EQ_OP:     return leftVarChar == rightVarChar;
-            case LT_OP:     return leftVarChar < rightVarChar;
-            case GT_OP:     return leftVarChar > rightVarChar;
-            case LE_OP:     return leftVarChar <= rightVarChar;
-            case GE_OP:     return leftVarChar >= rightVarChar;
-            case NE_OP:     return leftVarChar != rightVarChar;
+            case EQ_OP:     return cmp == 0;
+            case LT_OP:     return cmp < 0;
+            case GT_OP:     return cmp > 0;
+            case LE_OP:     return cmp <= 0;
+            case GE_OP:     return cmp >= 0;
+            case NE_OP:     return cmp != 0;
             case NO_OP:     return true;
             default:        return false;
         }
@@ -125,6 +125,12 @@ class TableScan : public Iterator
             return iter->getNextTuple(rid, data);
         };
 
+        // Many tuples at a time, for operators that work on a batch
+        RC getNextBatch(RecordBatch &batch)
+        {
+            return iter->getNextBatch(batch);
+        };
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -235,9 +241,10 @@ class Filter : public Iterator {
         RC getNextTuple(void *data);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const { in->getAttributes(attrs); };
-        bool compareValues(void *left, void* right);
+        bool compareValues(const void *left, const void *right);
     private:
         Iterator *in;
+        vector<Attribute> attrs;
         int leftConditionPos;
         Attribute leftConditionAttr;
         int rightConditionPos;
@@ -0,0 +1,367 @@
+#include "aio.h"
+#include "iostats.h"
+
+#include <errno.h>
+#include <sys/syscall.h>
+
+// move every byte described by iov, picking up where a short transfer stopped
+static RC transferAll(int fd, struct iovec *iov, int count, off_t offset, bool write)
+{
+    while (count > 0) {
+        ssize_t done = write ? pwritev(fd, iov, count, offset) : preadv(fd, iov, count, offset);
+        if (done <= 0) {
+            if (done == -1 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        offset += done;
+        while (count > 0 && (size_t) done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0 && done > 0) {
+            iov->iov_base = (char *) iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+
+static RC transferPages(int fd, PageNum pageNum, unsigned count, void * const *data, bool write)
+{
+    struct iovec iov[AIO_MAX_RUN_PAGES];
+    for (unsigned first = 0; first < count; first += AIO_MAX_RUN_PAGES) {
+        unsigned run = min(count - first, AIO_MAX_RUN_PAGES);
+        for (unsigned i = 0; i < run; i++) {
+            iov[i].iov_base = data[first + i];
+            iov[i].iov_len = PAGE_SIZE;
+        }
+        if (transferAll(fd, iov, run, pageOffset(pageNum + first), write) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+RC readPagesAt(int fd, PageNum pageNum, unsigned count, void * const *data)
+{
+    return transferPages(fd, pageNum, count, data, false);
+}
+
+
+RC writePagesAt(int fd, PageNum pageNum, unsigned count, const void * const *data)
+{
+    return transferPages(fd, pageNum, count, (void * const *) data, true);
+}
+
+
+AsyncIO* AsyncIO::create(int fd)
+{
+    IoUringIO *ring = new IoUringIO(fd);
+    if (ring->isReady()) {
+        return ring;
+    }
+    // old kernels or sandboxes that forbid io_uring
+    delete ring;
+    return new ThreadPoolIO(fd);
+}
+
+
+RC AsyncIO::queueRead(PageNum pageNum, void * const *data, unsigned count)
+{
+    if (count == 0 || count > AIO_MAX_RUN_PAGES || getFreeSlots() == 0) {
+        return -1;
+    }
+    AIORequest request;
+    request.pageNum = pageNum;
+    request.count = count;
+    request.queued = ioClock();
+    for (unsigned i = 0; i < count; i++) {
+        request.iov[i].iov_base = data[i];
+        request.iov[i].iov_len = PAGE_SIZE;
+    }
+    queue(request);
+    inFlight++;
+    return 0;
+}
+
+
+RC AsyncIO::submit(const PageNum *pageNums, void * const *data, unsigned count)
+{
+    if (count > getFreeSlots()) {
+        return -1;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        queueRead(pageNums[i], &data[i], 1);
+    }
+    return kick();
+}
+
+
+RC AsyncIO::drain()
+{
+    vector<AIOCompletion> completed;
+    while (inFlight > 0) {
+        if (poll(completed, true) == -1) {
+            return -1;
+        }
+        completed.clear();
+    }
+    return 0;
+}
+
+
+IoUringIO::IoUringIO(int fd) : AsyncIO(fd)
+{
+    sqRing = MAP_FAILED;
+    cqRing = MAP_FAILED;
+    sqes = (struct io_uring_sqe *) MAP_FAILED;
+    sqRingSize = 0;
+    cqRingSize = 0;
+    sqesSize = 0;
+    unsubmitted = 0;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &params);
+    if (ringFd == -1) {
+        return;
+    }
+
+    // map the two rings, newer kernels share one mapping for both
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing != MAP_FAILED) {
+        cqRing = singleMap ? sqRing
+                 : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (cqRing != MAP_FAILED) {
+        sqes = (struct io_uring_sqe *) mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ringFd, IORING_OFF_SQES);
+    }
+    if (sqes == MAP_FAILED) {
+        unmapRings();
+        close(ringFd);
+        ringFd = -1;
+        return;
+    }
+
+    sqHead = (unsigned *) ((char *) sqRing + params.sq_off.head);
+    sqTail = (unsigned *) ((char *) sqRing + params.sq_off.tail);
+    sqMask = (unsigned *) ((char *) sqRing + params.sq_off.ring_mask);
+    sqArray = (unsigned *) ((char *) sqRing + params.sq_off.array);
+    cqHead = (unsigned *) ((char *) cqRing + params.cq_off.head);
+    cqTail = (unsigned *) ((char *) cqRing + params.cq_off.tail);
+    cqMask = (unsigned *) ((char *) cqRing + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *) ((char *) cqRing + params.cq_off.cqes);
+
+    slots.resize(AIO_QUEUE_DEPTH);
+    for (unsigned i = AIO_QUEUE_DEPTH; i > 0; i--) {
+        freeSlots.push_back(i - 1);
+    }
+}
+
+
+IoUringIO::~IoUringIO()
+{
+    if (ringFd == -1) {
+        return;
+    }
+    // the kernel may still write into the buffers of queued reads
+    kick();
+    drain();
+    unmapRings();
+    close(ringFd);
+}
+
+
+void IoUringIO::unmapRings()
+{
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+}
+
+
+void IoUringIO::queue(const AIORequest &request)
+{
+    // the iovecs have to stay put until the read completes, so they live in the slot
+    unsigned slot = freeSlots.back();
+    freeSlots.pop_back();
+    slots[slot] = request;
+
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long) (uintptr_t) slots[slot].iov;
+    sqe->len = request.count;
+    sqe->off = (unsigned long long) pageOffset(request.pageNum);
+    sqe->user_data = slot;
+    sqArray[index] = index;
+
+    // the kernel only looks at the entry once the tail moves past it
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    unsubmitted++;
+}
+
+
+RC IoUringIO::kick()
+{
+    // one system call hands every queued entry to the kernel
+    while (unsubmitted > 0) {
+        int n = syscall(__NR_io_uring_enter, ringFd, unsubmitted, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        unsubmitted -= n;
+    }
+    return 0;
+}
+
+
+RC IoUringIO::poll(vector<AIOCompletion> &completed, bool wait)
+{
+    if (kick() == -1) {
+        return -1;
+    }
+    while (true) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned reaped = 0;
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+            AIORequest &request = slots[cqe->user_data];
+            AIOCompletion completion;
+            completion.pageNum = request.pageNum;
+            completion.count = request.count;
+            completion.data = request.iov[0].iov_base;
+            // a short read means some page is not (fully) in the file
+            completion.rc = cqe->res == (int) (request.count * PAGE_SIZE) ? 0 : -1;
+            completion.nanos = ioClock() - request.queued;
+            completed.push_back(completion);
+            freeSlots.push_back(cqe->user_data);
+            head++;
+            reaped++;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        inFlight -= reaped;
+
+        if (reaped > 0 || !wait || inFlight == 0) {
+            return 0;
+        }
+        if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+
+ThreadPoolIO::ThreadPoolIO(int fd) : AsyncIO(fd)
+{
+    stopping = false;
+    for (unsigned i = 0; i < AIO_WORKER_THREADS; i++) {
+        workers.push_back(thread(&ThreadPoolIO::work, this));
+    }
+}
+
+
+ThreadPoolIO::~ThreadPoolIO()
+{
+    kick();
+    drain();
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+}
+
+
+void ThreadPoolIO::queue(const AIORequest &request)
+{
+    staged.push_back(request);
+}
+
+
+RC ThreadPoolIO::kick()
+{
+    if (staged.empty()) {
+        return 0;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        pending.insert(pending.end(), staged.begin(), staged.end());
+    }
+    staged.clear();
+    workReady.notify_all();
+    return 0;
+}
+
+
+RC ThreadPoolIO::poll(vector<AIOCompletion> &completed, bool wait)
+{
+    kick();
+    unique_lock<mutex> guard(lock);
+    if (wait && inFlight > 0) {
+        workDone.wait(guard, [this] { return !finished.empty(); });
+    }
+    inFlight -= finished.size();
+    completed.insert(completed.end(), finished.begin(), finished.end());
+    finished.clear();
+    return 0;
+}
+
+
+void ThreadPoolIO::work()
+{
+    while (true) {
+        AIORequest request;
+        {
+            unique_lock<mutex> guard(lock);
+            workReady.wait(guard, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            request = pending.front();
+            pending.pop_front();
+        }
+
+        AIOCompletion completion;
+        completion.pageNum = request.pageNum;
+        completion.count = request.count;
+        completion.data = request.iov[0].iov_base;
+        completion.rc = transferAll(fd, request.iov, request.count, pageOffset(request.pageNum), false);
+        completion.nanos = ioClock() - request.queued;
+
+        {
+            lock_guard<mutex> guard(lock);
+            finished.push_back(completion);
+        }
+        workDone.notify_all();
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef _aio_h_
+#define _aio_h_
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "pfm.h"
+
+using namespace std;
+
+// Number of reads a single engine keeps in flight
+const unsigned AIO_QUEUE_DEPTH = 64;
+// Worker threads used when io_uring is not available
+const unsigned AIO_WORKER_THREADS = 4;
+// Longest run of consecutive pages moved by one request (256 KB)
+const unsigned AIO_MAX_RUN_PAGES = 64;
+
+// Vectored transfers of consecutive pages, one preadv/pwritev per IOV_MAX pages.
+// Page numbers are those of a FileHandle, the header page is skipped
+RC readPagesAt(int fd, PageNum pageNum, unsigned count, void * const *data);
+RC writePagesAt(int fd, PageNum pageNum, unsigned count, const void * const *data);
+
+// A finished asynchronous read of count consecutive pages, rc is 0 when all of them were read
+typedef struct
+{
+    PageNum pageNum;
+    unsigned count;
+    void *data;          // buffer of the first page
+    RC rc;
+    uint64_t nanos;      // from queueRead to the completion
+} AIOCompletion;
+
+// A read waiting in the engine, each page has its own buffer
+typedef struct
+{
+    PageNum pageNum;
+    unsigned count;
+    uint64_t queued;     // ioClock() at queueRead
+    struct iovec iov[AIO_MAX_RUN_PAGES];
+} AIORequest;
+
+
+// Asynchronous page reads against one file descriptor. Reads are queued with
+// queueRead(), handed over with kick() and reaped with poll(). Completions come
+// back in any order.
+class AsyncIO
+{
+public:
+    static AsyncIO* create(int fd);                                              // io_uring if the kernel has it, worker threads otherwise
+
+    virtual ~AsyncIO() {};
+    RC queueRead(PageNum pageNum, void * const *data, unsigned count);          // Queue one read of count consecutive pages, needs a free slot
+    virtual RC kick() = 0;                                                       // Start every queued read
+    virtual RC poll(vector<AIOCompletion> &completed, bool wait) = 0;           // Reap finished reads, block for one if wait is set
+    virtual const char* getName() = 0;
+    RC submit(const PageNum *pageNums, void * const *data, unsigned count);     // Queue and start single page reads
+
+    unsigned getInFlight() { return inFlight; };
+    unsigned getFreeSlots() { return AIO_QUEUE_DEPTH - inFlight; };
+    RC drain();                                                                  // Wait for every queued read, dropping the results
+
+protected:
+    AsyncIO(int fd) : fd(fd), inFlight(0) {};
+    virtual void queue(const AIORequest &request) = 0;
+
+    int fd;
+    unsigned inFlight;   // queued or running requests
+};
+
+
+// io_uring through the raw system calls, one submission and completion ring per file
+class IoUringIO : public AsyncIO
+{
+public:
+    IoUringIO(int fd);
+    ~IoUringIO();
+
+    bool isReady() { return ringFd != -1; };
+    RC kick();
+    RC poll(vector<AIOCompletion> &completed, bool wait);
+    const char* getName() { return "io_uring"; };
+
+protected:
+    void queue(const AIORequest &request);
+
+private:
+    int ringFd;
+    void *sqRing;
+    void *cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    vector<AIORequest> slots;   // request behind each entry, indexed by its user_data
+    vector<unsigned> freeSlots;
+    unsigned unsubmitted;       // entries filled in but not yet handed to the kernel
+
+    void unmapRings();
+};
+
+
+// Fallback when io_uring cannot be set up, a few threads doing blocking preadv calls
+class ThreadPoolIO : public AsyncIO
+{
+public:
+    ThreadPoolIO(int fd);
+    ~ThreadPoolIO();
+
+    RC kick();
+    RC poll(vector<AIOCompletion> &completed, bool wait);
+    const char* getName() { return "threads"; };
+
+protected:
+    void queue(const AIORequest &request);
+
+private:
+    vector<thread> workers;
+    vector<AIORequest> staged;
+    deque<AIORequest> pending;
+    deque<AIOCompletion> finished;
+    mutex lock;
+    condition_variable workReady;
+    condition_variable workDone;
+    bool stopping;
+
+    void work();
+};
+
+#endif
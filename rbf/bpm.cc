@@ -0,0 +1,823 @@
+#include "bpm.h"
+
+#include <algorithm>
+
+BufferPoolManager* BufferPoolManager::_bp_manager = 0;
+
+BufferPoolManager* BufferPoolManager::instance()
+{
+    if(!_bp_manager)
+        _bp_manager = new BufferPoolManager();
+
+    return _bp_manager;
+}
+
+
+BufferPoolManager::BufferPoolManager()
+{
+    // aligned frames can be handed straight to an IO_DIRECT descriptor
+    void *data = NULL;
+    if (posix_memalign(&data, PAGE_ALIGNMENT, (size_t) BUFFER_POOL_FRAMES * PAGE_SIZE) != 0) {
+        data = NULL;
+    }
+    frameData = (char *) data;
+    frames.resize(BUFFER_POOL_FRAMES);
+    for (unsigned i = 0; i < BUFFER_POOL_FRAMES; i++) {
+        frames[i].fileId = 0;
+        frames[i].pageNum = 0;
+        frames[i].pinCount = 0;
+        frames[i].valid = false;
+        frames[i].dirty = false;
+        frames[i].referenced = false;
+        frames[i].loading = false;
+        frames[i].owner = NULL;
+        frames[i].loader = NULL;
+        frames[i].writing = false;
+        frames[i].lsn = 0;
+        pthread_rwlock_init(&frames[i].latch, NULL);
+    }
+    clockHand = 0;
+    hitCounter = 0;
+    missCounter = 0;
+    evictCounter = 0;
+    dirtyFrames = 0;
+    dirtyAgeMs = DEFAULT_DIRTY_AGE_MS;
+    dirtyPercent = DEFAULT_DIRTY_PERCENT;
+    stopFlusher = false;
+    flusher = thread(&BufferPoolManager::runFlusher, this);
+}
+
+
+BufferPoolManager::~BufferPoolManager()
+{
+    {
+        lock_guard<mutex> guard(poolLock);
+        stopFlusher = true;
+        flushWanted.notify_one();
+    }
+    flusher.join();
+    for (unsigned i = 0; i < frames.size(); i++) {
+        pthread_rwlock_destroy(&frames[i].latch);
+    }
+    free(frameData);
+}
+
+
+RC BufferPoolManager::fetchPage(FileHandle &fileHandle, PageNum pageNum, void *&page, bool readFromDisk, LatchMode latch)
+{
+    unsigned long long key = makeKey(fileHandle.fileId, pageNum);
+    unique_lock<mutex> guard(poolLock);
+    unsigned frameNum;
+    while (true) {
+        // a page that is still being read is waited for, a failed load becomes a miss
+        auto it = pageTable.find(key);
+        while (it != pageTable.end() && isBusy(it->second)) {
+            if (waitForLoad(guard, it->second) == -1) {
+                return -1;
+            }
+            it = pageTable.find(key);
+        }
+
+        // a hit only needs to be pinned again
+        if (it != pageTable.end()) {
+            frameNum = it->second;
+            Frame &frame = frames[frameNum];
+            frame.pinCount++;
+            frame.referenced = true;
+            hitCounter++;
+            fileHandle.hitPageCounter++;
+            page = getFrameData(frameNum);
+            // the pin keeps the frame in place while we wait for its latch
+            guard.unlock();
+            latchFrame(frameNum, latch);
+            return 0;
+        }
+
+        // on a miss we need a frame to load the page into. Writing back the
+        // victim lets go of the mutex, so another thread may have loaded the
+        // page meanwhile and the frame is left free
+        if (claimFrame(fileHandle, frameNum, &guard) == -1) {
+            return -1;
+        }
+        if (pageTable.find(key) == pageTable.end()) {
+            break;
+        }
+    }
+    missCounter++;
+    fileHandle.missPageCounter++;
+
+    Frame &frame = frames[frameNum];
+    page = getFrameData(frameNum);
+    frame.fileId = fileHandle.fileId;
+    frame.pageNum = pageNum;
+    frame.pinCount = 1;
+    frame.valid = true;
+    frame.dirty = false;
+    frame.referenced = true;
+    frame.loading = readFromDisk;
+    frame.owner = NULL;
+    frame.loader = NULL;
+    pageTable[key] = frameNum;
+    // nobody else has the frame pinned, so its latch is free and trying cannot fail
+    tryLatchFrame(frameNum, latch);
+    if (!readFromDisk) {
+        return 0;
+    }
+
+    // other threads asking for the page wait for this read instead of starting their own
+    guard.unlock();
+    RC rc = fileHandle.readPageFromDisk(pageNum, page);
+    guard.lock();
+    frame.loading = false;
+    loaded.notify_all();
+    if (rc == -1) {
+        if (latch != LATCH_NONE) {
+            unlatchFrame(frameNum);
+        }
+        pageTable.erase(key);
+        frame.valid = false;
+        frame.pinCount = 0;
+        return -1;
+    }
+    return 0;
+}
+
+
+RC BufferPoolManager::prefetchPages(FileHandle &fileHandle, PageNum pageNum, unsigned count)
+{
+    AsyncIO *asyncIO = fileHandle.getAsyncIO();
+    if (asyncIO == NULL) {
+        return -1;
+    }
+    lock_guard<mutex> guard(poolLock);
+
+    // claim frames for the pages that are not cached yet, every run of
+    // consecutive ones becomes a single vectored read
+    vector<void *> run;
+    PageNum runStart = pageNum;
+    for (PageNum p = pageNum; p <= pageNum + count; p++) {
+        bool endOfRange = p == pageNum + count || p >= fileHandle.numPages;
+        unsigned long long key = makeKey(fileHandle.fileId, p);
+        bool cached = !endOfRange && pageTable.find(key) != pageTable.end();
+
+        if (!run.empty() && (endOfRange || cached || run.size() == AIO_MAX_RUN_PAGES)) {
+            if (asyncIO->queueRead(runStart, &run[0], run.size()) == -1) {
+                endLoads(fileHandle, runStart, run.size(), -1);
+            }
+            run.clear();
+        }
+        if (endOfRange || asyncIO->getFreeSlots() == 0) {
+            break;
+        }
+        if (cached) {
+            continue;
+        }
+
+        // the frames claimed so far are not queued yet, so the mutex is kept
+        // and a victim that would need writing back ends the prefetch
+        unsigned frameNum;
+        if (claimFrame(fileHandle, frameNum, NULL) == -1) {
+            break;
+        }
+        Frame &frame = frames[frameNum];
+        frame.fileId = fileHandle.fileId;
+        frame.pageNum = p;
+        frame.pinCount = 0;
+        frame.valid = true;
+        frame.dirty = false;
+        frame.referenced = true;
+        frame.loading = true;
+        frame.owner = NULL;
+        frame.loader = &fileHandle;
+        pageTable[key] = frameNum;
+        if (run.empty()) {
+            runStart = p;
+        }
+        run.push_back(getFrameData(frameNum));
+    }
+    if (!run.empty() && asyncIO->queueRead(runStart, &run[0], run.size()) == -1) {
+        endLoads(fileHandle, runStart, run.size(), -1);
+    }
+
+    // one system call starts every run
+    return asyncIO->kick();
+}
+
+
+RC BufferPoolManager::readPages(FileHandle &fileHandle, PageNum pageNum, unsigned count, void *data)
+{
+    // cached pages are pinned and copied out of their frames, the others are
+    // read straight into the buffer a run at a time
+    vector<pair<unsigned, char *> > hits;
+    vector<pair<PageNum, vector<void *> > > runs;
+    RC rc = 0;
+    unique_lock<mutex> guard(poolLock);
+    for (PageNum p = pageNum; rc == 0 && p < pageNum + count; p++) {
+        unsigned long long key = makeKey(fileHandle.fileId, p);
+        auto it = pageTable.find(key);
+        while (rc == 0 && it != pageTable.end() && isBusy(it->second)) {
+            rc = waitForLoad(guard, it->second);
+            it = pageTable.find(key);
+        }
+
+        char *page = (char *) data + (size_t) (p - pageNum) * PAGE_SIZE;
+        if (it != pageTable.end()) {
+            frames[it->second].pinCount++;
+            frames[it->second].referenced = true;
+            hits.push_back(make_pair(it->second, page));
+            hitCounter++;
+            fileHandle.hitPageCounter++;
+        } else {
+            if (runs.empty() || runs.back().first + runs.back().second.size() != p) {
+                runs.push_back(make_pair(p, vector<void *>()));
+            }
+            runs.back().second.push_back(page);
+            missCounter++;
+            fileHandle.missPageCounter++;
+        }
+    }
+    guard.unlock();
+
+    for (auto run = runs.begin(); rc == 0 && run != runs.end(); ++run) {
+        rc = fileHandle.readPagesFromDisk(run->first, run->second.size(), &run->second[0]);
+    }
+    for (auto hit = hits.begin(); rc == 0 && hit != hits.end(); ++hit) {
+        latchFrame(hit->first, LATCH_SHARED);
+        memcpy(hit->second, (char *) getFrameData(hit->first), PAGE_SIZE);
+        unlatchFrame(hit->first);
+    }
+
+    guard.lock();
+    for (auto hit = hits.begin(); hit != hits.end(); ++hit) {
+        frames[hit->first].pinCount--;
+    }
+    return rc;
+}
+
+
+RC BufferPoolManager::writePages(FileHandle &fileHandle, PageNum pageNum, unsigned count, const void *data)
+{
+    // pin the cached copies so they stay put, a read still landing in one
+    // would overwrite the new contents so it is waited for
+    vector<pair<unsigned, PageNum> > cached;
+    RC rc = 0;
+    unique_lock<mutex> guard(poolLock);
+    for (PageNum p = pageNum; rc == 0 && p < pageNum + count; p++) {
+        unsigned long long key = makeKey(fileHandle.fileId, p);
+        auto it = pageTable.find(key);
+        while (rc == 0 && it != pageTable.end() && isBusy(it->second)) {
+            rc = waitForLoad(guard, it->second);
+            it = pageTable.find(key);
+        }
+        if (it != pageTable.end()) {
+            frames[it->second].pinCount++;
+            cached.push_back(make_pair(it->second, p));
+        }
+    }
+    guard.unlock();
+
+    vector<const void *> pages;
+    for (unsigned i = 0; i < count; i++) {
+        pages.push_back((char *) data + (size_t) i * PAGE_SIZE);
+    }
+    if (rc == 0) {
+        rc = fileHandle.writePagesToDisk(pageNum, count, &pages[0]);
+    }
+
+    // cached copies now match the file
+    for (auto it = cached.begin(); it != cached.end(); ++it) {
+        Frame &frame = frames[it->first];
+        if (rc == 0) {
+            latchFrame(it->first, LATCH_EXCLUSIVE);
+            memcpy((char *) getFrameData(it->first), (char *) pages[it->second - pageNum], PAGE_SIZE);
+        }
+        guard.lock();
+        if (rc == 0) {
+            markClean(it->first);
+            frame.owner = NULL;
+        }
+        frame.pinCount--;
+        guard.unlock();
+        if (rc == 0) {
+            unlatchFrame(it->first);
+        }
+    }
+    return rc;
+}
+
+
+void BufferPoolManager::completeLoad(FileHandle &fileHandle, PageNum pageNum, unsigned count, RC rc)
+{
+    lock_guard<mutex> guard(poolLock);
+    endLoads(fileHandle, pageNum, count, rc);
+}
+
+
+void BufferPoolManager::endLoads(FileHandle &fileHandle, PageNum pageNum, unsigned count, RC rc)
+{
+    for (PageNum p = pageNum; p < pageNum + count; p++) {
+        auto it = pageTable.find(makeKey(fileHandle.fileId, p));
+        if (it != pageTable.end() && frames[it->second].loading && frames[it->second].loader == &fileHandle) {
+            finishLoad(it->second, rc == 0 ? fileHandle.verifyPage(p, getFrameData(it->second)) : rc);
+        }
+    }
+}
+
+
+void BufferPoolManager::finishLoad(unsigned frameNum, RC rc)
+{
+    Frame &frame = frames[frameNum];
+    frame.loading = false;
+    frame.loader = NULL;
+    if (rc == -1) {
+        // forget the page, the next fetch reads it synchronously
+        pageTable.erase(makeKey(frame.fileId, frame.pageNum));
+        frame.valid = false;
+    }
+}
+
+
+RC BufferPoolManager::unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty, LatchMode latch, uint64_t lsn)
+{
+    lock_guard<mutex> guard(poolLock);
+    auto it = pageTable.find(makeKey(fileHandle.fileId, pageNum));
+    if (it == pageTable.end()) {
+        return -1;
+    }
+
+    Frame &frame = frames[it->second];
+    if (frame.pinCount == 0) {
+        return -1;
+    }
+    // the latch goes first, once unpinned the frame may be handed to another page
+    if (latch != LATCH_NONE) {
+        unlatchFrame(it->second);
+    }
+    frame.pinCount--;
+
+    // remember who dirtied the frame so the eviction can write it back
+    if (dirty) {
+        markDirty(it->second, fileHandle, lsn);
+    }
+    return 0;
+}
+
+
+RC BufferPoolManager::flushFile(FileHandle &fileHandle, bool closing)
+{
+    unique_lock<mutex> pass(flushLock);
+    unique_lock<mutex> guard(poolLock);
+
+    // collect the dirty frames in page order so neighbours go out with one pwritev
+    RC rc = 0;
+    vector<pair<PageNum, unsigned> > dirtyFrames;
+    for (unsigned i = 0; i < frames.size(); i++) {
+        Frame &frame = frames[i];
+        if (!frame.valid || frame.fileId != fileHandle.fileId || !frame.dirty) {
+            continue;
+        }
+        // a page some thread is modifying right now cannot be written yet
+        if (tryLatchFrame(i, LATCH_SHARED)) {
+            dirtyFrames.push_back(make_pair(frame.pageNum, i));
+            continue;
+        }
+        if (!closing) {
+            rc = -1;
+            continue;
+        }
+
+        // a closing handle must not leave the page behind, so wait for the
+        // thread to finish with it and start over. Nothing is held meanwhile,
+        // the thread may need the pool to get there
+        for (unsigned j = 0; j < dirtyFrames.size(); j++) {
+            unlatchFrame(dirtyFrames[j].second);
+        }
+        dirtyFrames.clear();
+        guard.unlock();
+        pass.unlock();
+        latchFrame(i, LATCH_SHARED);
+        unlatchFrame(i);
+        pass.lock();
+        guard.lock();
+        i = -1;
+    }
+    sort(dirtyFrames.begin(), dirtyFrames.end());
+
+    // one force of the log covers every frame
+    uint64_t lsn = 0;
+    for (unsigned i = 0; i < dirtyFrames.size(); i++) {
+        lsn = max(lsn, frames[dirtyFrames[i].second].lsn);
+    }
+    if (fileHandle.forceLog(lsn) == -1) {
+        for (unsigned i = 0; i < dirtyFrames.size(); i++) {
+            unlatchFrame(dirtyFrames[i].second);
+        }
+        return -1;
+    }
+
+    vector<const void *> run;
+    for (unsigned i = 0; i < dirtyFrames.size(); i++) {
+        run.push_back(getFrameData(dirtyFrames[i].second));
+        bool lastOfRun = i + 1 == dirtyFrames.size() || dirtyFrames[i + 1].first != dirtyFrames[i].first + 1
+                         || run.size() == AIO_MAX_RUN_PAGES;
+        if (!lastOfRun) {
+            continue;
+        }
+
+        unsigned first = i + 1 - run.size();
+        bool written = fileHandle.writePagesToDisk(dirtyFrames[first].first, run.size(), &run[0]) == 0;
+        if (!written) {
+            rc = -1;
+        }
+        for (unsigned j = first; j <= i; j++) {
+            if (written) {
+                markClean(dirtyFrames[j].second);
+            }
+            unlatchFrame(dirtyFrames[j].second);
+        }
+        run.clear();
+    }
+
+    // the handle is about to go away so it can no longer write a frame back.
+    // A frame that could not be written keeps its owner and the close fails,
+    // leaving the handle open
+    if (closing) {
+        for (unsigned i = 0; i < frames.size(); i++) {
+            Frame &frame = frames[i];
+            if (!frame.valid || frame.fileId != fileHandle.fileId || frame.owner != &fileHandle) {
+                continue;
+            }
+            if (frame.dirty) {
+                rc = -1;
+            } else {
+                frame.owner = NULL;
+            }
+        }
+    }
+    return rc;
+}
+
+
+void BufferPoolManager::discardFile(const string &fileName)
+{
+    lock_guard<mutex> pass(flushLock);
+    unique_lock<mutex> guard(poolLock);
+    auto id = fileIds.find(fileName);
+    if (id == fileIds.end()) {
+        return;
+    }
+    unsigned fileId = id->second;
+
+    for (unsigned i = 0; i < frames.size(); i++) {
+        Frame &frame = frames[i];
+        // the read must land before the frame can be reused
+        while (frame.valid && frame.fileId == fileId && isBusy(i)) {
+            waitForLoad(guard, i);
+        }
+        if (frame.valid && frame.fileId == fileId) {
+            pageTable.erase(makeKey(frame.fileId, frame.pageNum));
+            frame.valid = false;
+            markClean(i);
+            frame.pinCount = 0;
+            frame.owner = NULL;
+        }
+    }
+}
+
+
+RC BufferPoolManager::discardPages(FileHandle &fileHandle, PageNum pageNum)
+{
+    lock_guard<mutex> pass(flushLock);
+    unique_lock<mutex> guard(poolLock);
+    for (unsigned i = 0; i < frames.size(); i++) {
+        Frame &frame = frames[i];
+        while (frame.valid && frame.fileId == fileHandle.fileId && frame.pageNum >= pageNum && isBusy(i)) {
+            waitForLoad(guard, i);
+        }
+        if (frame.valid && frame.fileId == fileHandle.fileId && frame.pageNum >= pageNum && frame.pinCount != 0) {
+            return -1;
+        }
+    }
+
+    for (unsigned i = 0; i < frames.size(); i++) {
+        Frame &frame = frames[i];
+        if (frame.valid && frame.fileId == fileHandle.fileId && frame.pageNum >= pageNum) {
+            pageTable.erase(makeKey(frame.fileId, frame.pageNum));
+            frame.valid = false;
+            markClean(i);
+            frame.owner = NULL;
+        }
+    }
+    return 0;
+}
+
+
+RC BufferPoolManager::setFlushPolicy(unsigned dirtyAgeMs, unsigned dirtyPercent)
+{
+    if (dirtyPercent > 100) {
+        return -1;
+    }
+    lock_guard<mutex> guard(poolLock);
+    this->dirtyAgeMs = dirtyAgeMs;
+    this->dirtyPercent = dirtyPercent;
+    flushWanted.notify_one();
+    return 0;
+}
+
+
+bool BufferPoolManager::isCached(FileHandle &fileHandle, PageNum pageNum)
+{
+    lock_guard<mutex> guard(poolLock);
+    return pageTable.find(makeKey(fileHandle.fileId, pageNum)) != pageTable.end();
+}
+
+
+unsigned BufferPoolManager::getFileId(const string &fileName)
+{
+    lock_guard<mutex> guard(poolLock);
+    auto id = fileIds.find(fileName);
+    if (id != fileIds.end()) {
+        return id->second;
+    }
+
+    unsigned newId = fileIds.size() + 1;
+    fileIds[fileName] = newId;
+    return newId;
+}
+
+
+RC BufferPoolManager::collectCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictCount)
+{
+    lock_guard<mutex> guard(poolLock);
+    hitCount = hitCounter;
+    missCount = missCounter;
+    evictCount = evictCounter;
+    return 0;
+}
+
+
+int BufferPoolManager::findVictim()
+{
+    // two full sweeps are enough to clear every reference bit once
+    for (unsigned i = 0; i < 2 * frames.size(); i++) {
+        unsigned frameNum = clockHand;
+        clockHand = (clockHand + 1) % frames.size();
+
+        Frame &frame = frames[frameNum];
+        if (!frame.valid) {
+            return frameNum;
+        }
+        if (frame.pinCount > 0 || frame.loading) {
+            continue;
+        }
+        if (frame.referenced) {
+            // give the frame a second chance
+            frame.referenced = false;
+            continue;
+        }
+        return frameNum;
+    }
+    return -1;
+}
+
+
+RC BufferPoolManager::claimFrame(FileHandle &fileHandle, unsigned &frameNum, unique_lock<mutex> *guard)
+{
+    // like a flusher pass, a write back holds flushLock so the owner of the
+    // victim cannot be closed while the mutex is released
+    unique_lock<mutex> pass(flushLock, defer_lock);
+    while (true) {
+        int victim = findVictim();
+        if (victim == -1) {
+            // every frame is pinned or loading
+            return -1;
+        }
+
+        Frame &frame = frames[victim];
+        if (frame.valid && frame.dirty) {
+            if (guard == NULL) {
+                return -1;
+            }
+            if (!pass.owns_lock() && !pass.try_lock()) {
+                // flushLock comes before the mutex, the victim is picked again once both are held
+                guard->unlock();
+                pass.lock();
+                guard->lock();
+                continue;
+            }
+            if (writeBack(victim, *guard) == -1) {
+                return -1;
+            }
+        }
+        if (frame.valid) {
+            pageTable.erase(makeKey(frame.fileId, frame.pageNum));
+            frame.valid = false;
+            evictCounter++;
+            fileHandle.evictPageCounter++;
+        }
+        frameNum = victim;
+        return 0;
+    }
+}
+
+
+RC BufferPoolManager::waitForLoad(unique_lock<mutex> &guard, unsigned frameNum)
+{
+    while (isBusy(frameNum)) {
+        FileHandle *loader = frames[frameNum].loader;
+        if (loader == NULL) {
+            // another thread is reading the page synchronously or writing it back
+            loaded.wait(guard);
+            continue;
+        }
+        AsyncIO *asyncIO = loader->getAsyncIO();
+        if (asyncIO == NULL || asyncIO->getInFlight() == 0) {
+            // nothing left that could finish the load
+            finishLoad(frameNum, -1);
+            break;
+        }
+        // completions come back through completeLoad, which needs the mutex
+        guard.unlock();
+        RC rc = loader->reapReads(true);
+        guard.lock();
+        if (rc == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+void BufferPoolManager::latchFrame(unsigned frameNum, LatchMode latch)
+{
+    if (latch == LATCH_SHARED) {
+        pthread_rwlock_rdlock(&frames[frameNum].latch);
+    } else if (latch == LATCH_EXCLUSIVE) {
+        pthread_rwlock_wrlock(&frames[frameNum].latch);
+    }
+}
+
+
+bool BufferPoolManager::tryLatchFrame(unsigned frameNum, LatchMode latch)
+{
+    if (latch == LATCH_SHARED) {
+        return pthread_rwlock_tryrdlock(&frames[frameNum].latch) == 0;
+    } else if (latch == LATCH_EXCLUSIVE) {
+        return pthread_rwlock_trywrlock(&frames[frameNum].latch) == 0;
+    }
+    return true;
+}
+
+
+RC BufferPoolManager::writeBack(unsigned frameNum, unique_lock<mutex> &guard)
+{
+    Frame &frame = frames[frameNum];
+    FileHandle *owner = frame.owner;
+    if (owner == NULL) {
+        return -1;
+    }
+
+    // the pin keeps the clock off the frame while the mutex is released, and
+    // other threads wait instead of pinning it, as for the flusher
+    PageNum pageNum = frame.pageNum;
+    uint64_t lsn = frame.lsn;
+    frame.pinCount++;
+    frame.writing = true;
+    guard.unlock();
+    // write ahead: the log records of the frame go first
+    RC rc = 0;
+    if (owner->forceLog(lsn) == -1 || owner->writePageToDisk(pageNum, getFrameData(frameNum)) == -1) {
+        rc = -1;
+    }
+    guard.lock();
+    frame.writing = false;
+    frame.pinCount--;
+    loaded.notify_all();
+    if (rc == -1) {
+        return -1;
+    }
+    markClean(frameNum);
+    frame.owner = NULL;
+    return 0;
+}
+
+
+void BufferPoolManager::markDirty(unsigned frameNum, FileHandle &fileHandle, uint64_t lsn)
+{
+    Frame &frame = frames[frameNum];
+    frame.lsn = max(frame.lsn, lsn);
+    if (!frame.dirty) {
+        frame.dirty = true;
+        frame.dirtySince = chrono::steady_clock::now();
+        dirtyFrames++;
+    }
+    frame.owner = &fileHandle;
+    if (tooManyDirty()) {
+        flushWanted.notify_one();
+    }
+}
+
+
+void BufferPoolManager::markClean(unsigned frameNum)
+{
+    Frame &frame = frames[frameNum];
+    if (frame.dirty) {
+        frame.dirty = false;
+        frame.lsn = 0;
+        dirtyFrames--;
+    }
+}
+
+
+void BufferPoolManager::runFlusher()
+{
+    unique_lock<mutex> guard(poolLock);
+    while (!stopFlusher) {
+        flushWanted.wait_for(guard, chrono::milliseconds(FLUSH_INTERVAL_MS));
+        if (stopFlusher || dirtyFrames == 0 || (dirtyAgeMs == 0 && dirtyPercent == 0)) {
+            continue;
+        }
+        guard.unlock();
+        flushDirtyFrames();
+        guard.lock();
+    }
+}
+
+
+void BufferPoolManager::flushDirtyFrames()
+{
+    lock_guard<mutex> pass(flushLock);
+    unique_lock<mutex> guard(poolLock);
+
+    // frames somebody is using are left for a later pass
+    vector<pair<chrono::steady_clock::time_point, unsigned> > candidates;
+    for (unsigned i = 0; i < frames.size(); i++) {
+        Frame &frame = frames[i];
+        if (frame.valid && frame.dirty && frame.owner != NULL && !frame.loading && frame.pinCount == 0) {
+            candidates.push_back(make_pair(frame.dirtySince, i));
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+
+    // old frames always go, and while too many are dirty the oldest ones go
+    // until half of the limit is left
+    unsigned excess = 0;
+    if (tooManyDirty()) {
+        excess = dirtyFrames - dirtyPercent * frames.size() / 200;
+    }
+    chrono::steady_clock::time_point oldest = chrono::steady_clock::now() - chrono::milliseconds(dirtyAgeMs);
+    vector<pair<pair<FileHandle *, PageNum>, unsigned> > picked;
+    vector<uint64_t> lsns(frames.size());
+    for (unsigned i = 0; i < candidates.size(); i++) {
+        bool old = dirtyAgeMs != 0 && candidates[i].first <= oldest;
+        if (!old && i >= excess) {
+            break;
+        }
+        // the pin keeps the frame and its owner while the mutex is released,
+        // and other threads wait instead of pinning it themselves
+        Frame &frame = frames[candidates[i].second];
+        frame.pinCount++;
+        frame.writing = true;
+        lsns[candidates[i].second] = frame.lsn;
+        picked.push_back(make_pair(make_pair(frame.owner, frame.pageNum), candidates[i].second));
+    }
+    if (picked.empty()) {
+        return;
+    }
+    guard.unlock();
+
+    // neighbouring pages of one handle go out with one pwritev
+    sort(picked.begin(), picked.end());
+    vector<unsigned> written;
+    vector<const void *> run;
+    uint64_t lsn = 0;
+    for (unsigned i = 0; i < picked.size(); i++) {
+        run.push_back(getFrameData(picked[i].second));
+        lsn = max(lsn, lsns[picked[i].second]);
+        bool lastOfRun = i + 1 == picked.size() || picked[i + 1].first.first != picked[i].first.first
+                         || picked[i + 1].first.second != picked[i].first.second + 1 || run.size() == AIO_MAX_RUN_PAGES;
+        if (!lastOfRun) {
+            continue;
+        }
+
+        unsigned first = i + 1 - run.size();
+        FileHandle *owner = picked[first].first.first;
+        if (owner->forceLog(lsn) == 0 && owner->writePagesToDisk(picked[first].first.second, run.size(), &run[0]) == 0) {
+            for (unsigned j = first; j <= i; j++) {
+                written.push_back(picked[j].second);
+            }
+        }
+        run.clear();
+        lsn = 0;
+    }
+
+    guard.lock();
+    for (unsigned i = 0; i < written.size(); i++) {
+        markClean(written[i]);
+    }
+    for (unsigned i = 0; i < picked.size(); i++) {
+        frames[picked[i].second].writing = false;
+        frames[picked[i].second].pinCount--;
+    }
+    loaded.notify_all();
+}
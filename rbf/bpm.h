@@ -0,0 +1,130 @@
+#ifndef _bpm_h_
+#define _bpm_h_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <pthread.h>
+
+#include "pfm.h"
+#include "aio.h"
+
+using namespace std;
+
+// Number of page frames held by the buffer pool
+const unsigned BUFFER_POOL_FRAMES = 1024;
+
+// Write back policy of the background flusher
+const unsigned FLUSH_INTERVAL_MS = 100;       // how often the flusher looks for work
+const unsigned DEFAULT_DIRTY_AGE_MS = 1000;   // pages dirty for longer than this are written back
+const unsigned DEFAULT_DIRTY_PERCENT = 50;    // more dirty frames than this wakes the flusher at once
+
+// A single page frame of the buffer pool
+typedef struct
+{
+    unsigned fileId;      // file the cached page belongs to
+    PageNum pageNum;      // page number inside that file
+    unsigned pinCount;    // number of callers currently using the frame
+    bool valid;           // the frame holds a page
+    bool dirty;           // the frame is newer than the page on disk
+    bool referenced;      // second chance bit used by the clock
+    bool loading;         // a read into the frame has not finished yet
+    bool writing;         // the flusher or an eviction is writing the frame back, pins wait for it like for a load
+    chrono::steady_clock::time_point dirtySince;  // when the frame went from clean to dirty
+    uint64_t lsn;             // log record of the latest logged change, the log is forced up to it before a write back
+    FileHandle *owner;    // handle used to write the frame back on eviction
+    FileHandle *loader;   // handle whose engine is reading into a loading frame, NULL for a synchronous read
+    pthread_rwlock_t latch;   // page latch, only taken while the frame is pinned
+} Frame;
+
+
+// The buffer pool sits beneath every FileHandle. Pages are cached in a fixed
+// number of frames keyed by (file, PageNum), callers pin a frame while they use
+// it and a clock sweep picks the victim when a miss needs a free frame.
+//
+// One mutex guards the frame table. Disk reads for a miss happen outside of it
+// while the frame is marked loading, and page latches are never waited for
+// while it is held, so a thread may hold a latch and then take the mutex but
+// not the other way round. FileHandle::ioLock is taken before the mutex.
+//
+// Dirty frames are written back on eviction, when their file is flushed and by
+// a background thread that writes the ones dirty for longer than the age limit,
+// or the oldest ones when too many frames are dirty. Evictions and the flusher
+// write with the mutex released, and nobody can pin a frame they are writing,
+// so a page is never changed halfway through its write. The flusher holds flushLock for a whole
+// pass, an eviction while it writes its victim and flushFile takes it too, so a
+// handle is never closed under a write back that uses it. flushLock is taken
+// before the mutex.
+class BufferPoolManager
+{
+public:
+    static BufferPoolManager* instance();                                       // Access to the _bp_manager instance
+
+    RC fetchPage     (FileHandle &fileHandle, PageNum pageNum, void *&page, bool readFromDisk = true,
+                      LatchMode latch = LATCH_NONE);                            // Pin a page, loading it on a miss, and latch it
+    RC unpinPage     (FileHandle &fileHandle, PageNum pageNum, bool dirty, LatchMode latch = LATCH_NONE,
+                      uint64_t lsn = 0);                                        // Unlatch and release a pinned page, lsn of the change if it was logged
+    RC prefetchPages (FileHandle &fileHandle, PageNum pageNum, unsigned count); // Start asynchronous loads of the pages that are not cached
+    RC readPages     (FileHandle &fileHandle, PageNum pageNum, unsigned count, void *data);       // Copy out consecutive pages, uncached runs come from one preadv
+    RC writePages    (FileHandle &fileHandle, PageNum pageNum, unsigned count, const void *data); // Write consecutive pages with pwritev and refresh cached copies
+    RC flushFile     (FileHandle &fileHandle, bool closing = true);             // Write back every dirty page of a file, closing waits for latched ones and forgets the handle
+    RC setFlushPolicy(unsigned dirtyAgeMs, unsigned dirtyPercent);              // Background write back limits, 0 turns a limit off
+    void discardFile (const string &fileName);                                  // Drop every page of a file without writing it
+    RC discardPages  (FileHandle &fileHandle, PageNum pageNum);                 // Drop the pages of a file from pageNum on, -1 if one is pinned
+    unsigned getFileId(const string &fileName);                                 // Id used to key the pages of a file
+    bool isCached    (FileHandle &fileHandle, PageNum pageNum);                 // Is the page in a frame, loaded or on its way
+    RC collectCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictCount); // Pool wide hit, miss and eviction counters
+
+    // used by FileHandle when the asynchronous reads of the pool complete
+    bool isFrame(const void *data) { return (char *) data >= frameData && (char *) data < frameData + (size_t) BUFFER_POOL_FRAMES * PAGE_SIZE; };
+    void completeLoad(FileHandle &fileHandle, PageNum pageNum, unsigned count, RC rc);
+
+protected:
+    BufferPoolManager();                                                        // Constructor
+    ~BufferPoolManager();                                                       // Destructor
+
+private:
+    static BufferPoolManager *_bp_manager;
+
+    char *frameData;
+    vector<Frame> frames;
+    unordered_map<unsigned long long, unsigned> pageTable;
+    unordered_map<string, unsigned> fileIds;
+    unsigned clockHand;
+    unsigned hitCounter;
+    unsigned missCounter;
+    unsigned evictCounter;
+    mutex poolLock;
+    condition_variable loaded;    // a synchronous read into a frame or a background write of one has finished
+    unsigned dirtyFrames;
+    unsigned dirtyAgeMs;
+    unsigned dirtyPercent;
+    bool stopFlusher;
+    mutex flushLock;              // held by a write back pass, keeps the owners of its frames open
+    condition_variable flushWanted;
+    thread flusher;
+
+    int findVictim();
+    RC claimFrame(FileHandle &fileHandle, unsigned &frameNum, unique_lock<mutex> *guard); // a dirty victim is written back with guard released, none without a guard
+    RC writeBack(unsigned frameNum, unique_lock<mutex> &guard);
+    void markDirty(unsigned frameNum, FileHandle &fileHandle, uint64_t lsn);
+    void markClean(unsigned frameNum);
+    bool tooManyDirty() { return dirtyPercent != 0 && dirtyFrames * 100 > dirtyPercent * frames.size(); };
+    void runFlusher();
+    void flushDirtyFrames();
+    RC waitForLoad(unique_lock<mutex> &guard, unsigned frameNum);
+    bool isBusy(unsigned frameNum) { return frames[frameNum].loading || frames[frameNum].writing; };
+    void latchFrame(unsigned frameNum, LatchMode latch);
+    bool tryLatchFrame(unsigned frameNum, LatchMode latch);
+    void unlatchFrame(unsigned frameNum) { pthread_rwlock_unlock(&frames[frameNum].latch); };
+    void endLoads(FileHandle &fileHandle, PageNum pageNum, unsigned count, RC rc);
+    void finishLoad(unsigned frameNum, RC rc);
+    void* getFrameData(unsigned frameNum) { return frameData + ((size_t) frameNum * PAGE_SIZE); };
+    static unsigned long long makeKey(unsigned fileId, PageNum pageNum) { return ((unsigned long long) fileId << 32) | pageNum; };
+};
+
+#endif
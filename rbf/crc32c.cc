@@ -0,0 +1,203 @@
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// reflected CRC-32C polynomial
+const uint32_t CRC32C_POLY = 0x82f63b78;
+
+// the hardware version runs three crc32 instructions side by side over blocks
+// of these sizes and merges the results by shifting the first two over the rest
+const size_t CRC_LONG_BLOCK = 8192;
+const size_t CRC_SHORT_BLOCK = 256;
+
+
+// Tables are built on first use, checksums may be needed by static constructors
+class CRC32CTables
+{
+public:
+    uint32_t bytes[8][256];        // slicing by 8
+    uint32_t longShift[4][256];    // appends CRC_LONG_BLOCK zero bytes to a crc
+    uint32_t shortShift[4][256];   // appends CRC_SHORT_BLOCK zero bytes to a crc
+    bool hardware;
+
+    CRC32CTables();
+};
+
+static const CRC32CTables& getTables()
+{
+    static CRC32CTables tables;
+    return tables;
+}
+
+
+// multiply a vector by a matrix over GF(2), a matrix is 32 columns of bits
+static uint32_t gf2Times(const uint32_t *matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for (; vector != 0; vector >>= 1, matrix++) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+    }
+    return sum;
+}
+
+
+static void gf2Square(uint32_t *square, const uint32_t *matrix)
+{
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2Times(matrix, matrix[n]);
+    }
+}
+
+
+// tables that apply length zero bytes to a crc a byte of it at a time,
+// length must be a power of two
+static void buildShift(uint32_t shift[4][256], size_t length)
+{
+    // one zero bit, then square up to a zero byte and on to length of them
+    uint32_t op[32], square[32];
+    op[0] = CRC32C_POLY;
+    for (int n = 1; n < 32; n++) {
+        op[n] = 1u << (n - 1);
+    }
+    for (size_t bits = 1; bits < length * 8; bits <<= 1) {
+        gf2Square(square, op);
+        for (int n = 0; n < 32; n++) {
+            op[n] = square[n];
+        }
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        shift[0][n] = gf2Times(op, n);
+        shift[1][n] = gf2Times(op, n << 8);
+        shift[2][n] = gf2Times(op, n << 16);
+        shift[3][n] = gf2Times(op, n << 24);
+    }
+}
+
+
+static inline uint32_t applyShift(const uint32_t shift[4][256], uint32_t crc)
+{
+    return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+
+CRC32CTables::CRC32CTables()
+{
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t crc = n;
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        bytes[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t crc = bytes[0][n];
+        for (int k = 1; k < 8; k++) {
+            crc = bytes[0][crc & 0xff] ^ (crc >> 8);
+            bytes[k][n] = crc;
+        }
+    }
+    buildShift(longShift, CRC_LONG_BLOCK);
+    buildShift(shortShift, CRC_SHORT_BLOCK);
+#if defined(__x86_64__)
+    // we may run among the static constructors, before the cpu checks are set up
+    __builtin_cpu_init();
+    hardware = __builtin_cpu_supports("sse4.2");
+#else
+    hardware = false;
+#endif
+}
+
+
+uint32_t crc32cSoftware(uint32_t crc, const void *data, size_t length)
+{
+    const CRC32CTables &tables = getTables();
+    const unsigned char *next = (const unsigned char *) data;
+    uint64_t value = crc ^ 0xffffffff;
+    while (length > 0 && (uintptr_t) next % 8 != 0) {
+        value = tables.bytes[0][(value ^ *next++) & 0xff] ^ (value >> 8);
+        length--;
+    }
+    for (; length >= 8; length -= 8, next += 8) {
+        value ^= *(const uint64_t *) next;
+        value = tables.bytes[7][value & 0xff] ^ tables.bytes[6][(value >> 8) & 0xff]
+              ^ tables.bytes[5][(value >> 16) & 0xff] ^ tables.bytes[4][(value >> 24) & 0xff]
+              ^ tables.bytes[3][(value >> 32) & 0xff] ^ tables.bytes[2][(value >> 40) & 0xff]
+              ^ tables.bytes[1][(value >> 48) & 0xff] ^ tables.bytes[0][value >> 56];
+    }
+    while (length > 0) {
+        value = tables.bytes[0][(value ^ *next++) & 0xff] ^ (value >> 8);
+        length--;
+    }
+    return (uint32_t) value ^ 0xffffffff;
+}
+
+
+#if defined(__x86_64__)
+
+// crc of three blocks at once, merged into the first one
+__attribute__((target("sse4.2")))
+static inline uint64_t crc32cBlocks(uint64_t crc0, const unsigned char *&next, size_t block, const uint32_t shift[4][256])
+{
+    uint64_t crc1 = 0, crc2 = 0;
+    const unsigned char *end = next + block;
+    for (; next < end; next += 8) {
+        crc0 = _mm_crc32_u64(crc0, *(const uint64_t *) next);
+        crc1 = _mm_crc32_u64(crc1, *(const uint64_t *) (next + block));
+        crc2 = _mm_crc32_u64(crc2, *(const uint64_t *) (next + 2 * block));
+    }
+    next += 2 * block;
+    crc0 = applyShift(shift, crc0) ^ crc1;
+    return applyShift(shift, crc0) ^ crc2;
+}
+
+
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, const void *data, size_t length)
+{
+    const CRC32CTables &tables = getTables();
+    const unsigned char *next = (const unsigned char *) data;
+    uint64_t value = crc ^ 0xffffffff;
+    while (length > 0 && (uintptr_t) next % 8 != 0) {
+        value = _mm_crc32_u8(value, *next++);
+        length--;
+    }
+    for (; length >= 3 * CRC_LONG_BLOCK; length -= 3 * CRC_LONG_BLOCK) {
+        value = crc32cBlocks(value, next, CRC_LONG_BLOCK, tables.longShift);
+    }
+    for (; length >= 3 * CRC_SHORT_BLOCK; length -= 3 * CRC_SHORT_BLOCK) {
+        value = crc32cBlocks(value, next, CRC_SHORT_BLOCK, tables.shortShift);
+    }
+    for (; length >= 8; length -= 8, next += 8) {
+        value = _mm_crc32_u64(value, *(const uint64_t *) next);
+    }
+    while (length > 0) {
+        value = _mm_crc32_u8(value, *next++);
+        length--;
+    }
+    return (uint32_t) value ^ 0xffffffff;
+}
+
+#else
+
+uint32_t crc32cHardware(uint32_t crc, const void *data, size_t length)
+{
+    return crc32cSoftware(crc, data, length);
+}
+
+#endif
+
+
+bool crc32cHasHardware()
+{
+    return getTables().hardware;
+}
+
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length)
+{
+    return getTables().hardware ? crc32cHardware(crc, data, length) : crc32cSoftware(crc, data, length);
+}
@@ -0,0 +1,17 @@
+#ifndef _crc32c_h_
+#define _crc32c_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli) of length bytes, continuing from crc (0 to start).
+// Uses the SSE4.2 crc32 instruction when the processor has it, three streams
+// at a time so its latency is hidden, and a slicing by 8 table otherwise
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+
+// The two implementations behind crc32c, the hardware one needs crc32cHasHardware()
+uint32_t crc32cSoftware(uint32_t crc, const void *data, size_t length);
+uint32_t crc32cHardware(uint32_t crc, const void *data, size_t length);
+bool crc32cHasHardware();
+
+#endif
@@ -0,0 +1,307 @@
+#include "iostats.h"
+
+#include <fstream>
+#include <stdio.h>
+
+IOStatsManager* IOStatsManager::_stats_manager = 0;
+
+IOStatsManager* IOStatsManager::instance()
+{
+    if(!_stats_manager)
+        _stats_manager = new IOStatsManager();
+
+    return _stats_manager;
+}
+
+
+IOStatsManager::IOStatsManager()
+{
+}
+
+
+IOStatsManager::~IOStatsManager()
+{
+}
+
+
+IOStats* IOStatsManager::openStats(const string &fileName)
+{
+    lock_guard<mutex> guard(statsLock);
+    auto it = stats.find(fileName);
+    if (it != stats.end()) {
+        it->second->users++;
+        return it->second;
+    }
+    IOStats *fileStats = new IOStats(fileName);
+    fileStats->users = 1;
+    stats[fileName] = fileStats;
+    return fileStats;
+}
+
+
+void IOStatsManager::closeStats(IOStats *fileStats)
+{
+    if (fileStats == NULL) {
+        return;
+    }
+    lock_guard<mutex> guard(statsLock);
+    if (--fileStats->users == 0 && !fileStats->named) {
+        delete fileStats;
+    }
+}
+
+
+void IOStatsManager::dropStats(const string &fileName)
+{
+    lock_guard<mutex> guard(statsLock);
+    auto it = stats.find(fileName);
+    if (it == stats.end()) {
+        return;
+    }
+    // a handle still open on the destroyed file keeps recording into them
+    IOStats *fileStats = it->second;
+    stats.erase(it);
+    fileStats->named = false;
+    if (fileStats->users == 0) {
+        delete fileStats;
+    }
+}
+
+
+IOStats* IOStatsManager::getStats(const string &fileName)
+{
+    lock_guard<mutex> guard(statsLock);
+    auto it = stats.find(fileName);
+    return it != stats.end() ? it->second : NULL;
+}
+
+
+RC IOStatsManager::dumpJSON(ostream &out)
+{
+    lock_guard<mutex> guard(statsLock);
+    out << "{\"files\":[";
+    bool first = true;
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
+        if (!first) {
+            out << ",";
+        }
+        first = false;
+        it->second->dumpJSON(out);
+    }
+    out << "]}" << endl;
+    return out.good() ? 0 : -1;
+}
+
+
+RC IOStatsManager::dumpJSON(const string &path)
+{
+    ofstream out(path.c_str(), ios::out | ios::trunc);
+    if (!out.is_open()) {
+        return -1;
+    }
+    return dumpJSON((ostream &) out);
+}
+
+
+IOStats::IOStats(const string &fileName) : fileName(fileName)
+{
+    for (unsigned i = 0; i < IO_OP_COUNT; i++) {
+        bytes[i] = 0;
+        sequential[i] = 0;
+        random[i] = 0;
+        nextOffset[i] = -1;
+    }
+    users = 0;
+    named = true;
+}
+
+
+void IOStats::record(IOOp op, off_t offset, size_t length, uint64_t nanos)
+{
+    histograms[op].record(nanos);
+    bytes[op].fetch_add(length, memory_order_relaxed);
+    if (offset < 0) {
+        return;
+    }
+    // concurrent transfers may race on the offset, that only blurs the split
+    if (nextOffset[op].exchange(offset + length, memory_order_relaxed) == offset) {
+        sequential[op].fetch_add(1, memory_order_relaxed);
+    } else {
+        random[op].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+
+RC IOStats::collectOpValues(IOOp op, uint64_t &count, uint64_t &byteCount, uint64_t &sequentialCount, uint64_t &randomCount, uint64_t &nanos)
+{
+    if (op < 0 || op >= IO_OP_COUNT) {
+        return -1;
+    }
+    count = histograms[op].getCount();
+    byteCount = bytes[op].load(memory_order_relaxed);
+    sequentialCount = sequential[op].load(memory_order_relaxed);
+    randomCount = random[op].load(memory_order_relaxed);
+    nanos = histograms[op].getTotalNanos();
+    return 0;
+}
+
+
+void IOStats::reset()
+{
+    for (unsigned i = 0; i < IO_OP_COUNT; i++) {
+        histograms[i].reset();
+        bytes[i] = 0;
+        sequential[i] = 0;
+        random[i] = 0;
+        nextOffset[i] = -1;
+    }
+}
+
+
+const char* IOStats::getOpName(IOOp op)
+{
+    switch (op) {
+    case IO_OP_READ:       return "read";
+    case IO_OP_WRITE:      return "write";
+    case IO_OP_ASYNC_READ: return "asyncRead";
+    case IO_OP_SYNC:       return "sync";
+    case IO_OP_LOG_WRITE:  return "logWrite";
+    case IO_OP_LOG_SYNC:   return "logSync";
+    default:               return "unknown";
+    }
+}
+
+
+// file names are the only strings that come from outside
+static void writeJSONString(ostream &out, const string &value)
+{
+    out << '"';
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = value[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+
+void IOStats::dumpJSON(ostream &out)
+{
+    out << "{\"file\":";
+    writeJSONString(out, fileName);
+    out << ",\"ops\":{";
+    for (unsigned i = 0; i < IO_OP_COUNT; i++) {
+        LatencyHistogram &histogram = histograms[i];
+        if (i != 0) {
+            out << ",";
+        }
+        out << "\"" << getOpName((IOOp) i) << "\":{"
+            << "\"count\":" << histogram.getCount()
+            << ",\"bytes\":" << bytes[i].load(memory_order_relaxed)
+            << ",\"sequential\":" << sequential[i].load(memory_order_relaxed)
+            << ",\"random\":" << random[i].load(memory_order_relaxed)
+            << ",\"totalNanos\":" << histogram.getTotalNanos()
+            << ",\"maxNanos\":" << histogram.getMaxNanos()
+            << ",\"p50\":" << histogram.getPercentile(50)
+            << ",\"p90\":" << histogram.getPercentile(90)
+            << ",\"p99\":" << histogram.getPercentile(99)
+            << ",\"p999\":" << histogram.getPercentile(99.9)
+            << ",\"buckets\":[";
+        // only the buckets in use, each as its highest latency and its count
+        bool first = true;
+        for (unsigned bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+            uint64_t count = histogram.getBucketCount(bucket);
+            if (count == 0) {
+                continue;
+            }
+            if (!first) {
+                out << ",";
+            }
+            first = false;
+            out << "[" << LatencyHistogram::bucketHigh(bucket) << "," << count << "]";
+        }
+        out << "]}";
+    }
+    out << "}}";
+}
+
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+
+void LatencyHistogram::record(uint64_t nanos)
+{
+    buckets[bucketOf(nanos)].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    totalNanos.fetch_add(nanos, memory_order_relaxed);
+    uint64_t highest = maxNanos.load(memory_order_relaxed);
+    while (nanos > highest && !maxNanos.compare_exchange_weak(highest, nanos, memory_order_relaxed)) {
+    }
+}
+
+
+uint64_t LatencyHistogram::getPercentile(double percentile)
+{
+    uint64_t total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+    // the rank of the value asked for, counted from 1
+    uint64_t rank = (uint64_t) (percentile / 100 * total + 0.999999);
+    rank = max(rank, (uint64_t) 1);
+    uint64_t seen = 0;
+    for (unsigned bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        seen += getBucketCount(bucket);
+        if (seen >= rank) {
+            return min(bucketHigh(bucket), getMaxNanos());
+        }
+    }
+    return getMaxNanos();
+}
+
+
+void LatencyHistogram::reset()
+{
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+    count = 0;
+    totalNanos = 0;
+    maxNanos = 0;
+}
+
+
+unsigned LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < HISTOGRAM_SUB_BUCKETS) {
+        return nanos;
+    }
+    if (nanos >> HISTOGRAM_OCTAVES != 0) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    // the top bit picks the power of two, the bits under it the step inside it
+    unsigned top = 63 - __builtin_clzll(nanos);
+    unsigned shift = top - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + ((nanos >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+
+uint64_t LatencyHistogram::bucketHigh(unsigned bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t) (HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return low + ((uint64_t) 1 << shift) - 1;
+}
@@ -0,0 +1,125 @@
+#ifndef _iostats_h_
+#define _iostats_h_
+
+#include <string>
+#include <ostream>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "pfm.h"
+
+using namespace std;
+
+// Transfers timed for every file, the log ones are those of its write ahead log
+typedef enum { IO_OP_READ = 0,      // pread, preadv or a stream read of pages or of the header
+               IO_OP_WRITE,         // pwrite, pwritev or a stream write
+               IO_OP_ASYNC_READ,    // read through the asynchronous engine, from queueing to completion
+               IO_OP_SYNC,          // fdatasync of the file
+               IO_OP_LOG_WRITE,     // log records written out
+               IO_OP_LOG_SYNC,      // fdatasync of the log
+               IO_OP_COUNT
+} IOOp;
+
+// Latencies are kept in log buckets: each power of two of nanoseconds is cut
+// into HISTOGRAM_SUB_BUCKETS linear steps, so a bucket is within 1/8 of its
+// values whatever their size. Anything past 2^HISTOGRAM_OCTAVES ns goes in the last one
+const unsigned HISTOGRAM_SUB_BITS = 3;
+const unsigned HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+const unsigned HISTOGRAM_OCTAVES = 40;          // about 18 minutes
+const unsigned HISTOGRAM_BUCKETS = (HISTOGRAM_OCTAVES - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+// Nanoseconds on the clock the latencies are measured with
+inline uint64_t ioClock()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Latencies of one kind of transfer. Recording is a few relaxed atomic adds,
+// readers may see a count a transfer ahead of its bucket
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t nanos);
+    uint64_t getCount() { return count.load(memory_order_relaxed); };
+    uint64_t getTotalNanos() { return totalNanos.load(memory_order_relaxed); };
+    uint64_t getMaxNanos() { return maxNanos.load(memory_order_relaxed); };
+    uint64_t getPercentile(double percentile);                          // Highest latency of the bucket holding it, 0 if nothing was recorded
+    uint64_t getBucketCount(unsigned bucket) { return buckets[bucket].load(memory_order_relaxed); };
+    void reset();
+
+    static unsigned bucketOf(uint64_t nanos);
+    static uint64_t bucketHigh(unsigned bucket);                        // Highest latency that falls in a bucket
+
+private:
+    atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    atomic<uint64_t> count;
+    atomic<uint64_t> totalNanos;
+    atomic<uint64_t> maxNanos;
+};
+
+
+// Everything measured on one file, shared by every handle open on it and by
+// its log. A transfer is sequential when it starts where the last one of the
+// same kind ended, whichever handle made it
+class IOStats
+{
+public:
+    IOStats(const string &fileName);
+
+    void record(IOOp op, off_t offset, size_t bytes, uint64_t nanos);   // offset -1 for a sync, it is neither sequential nor random
+    RC collectOpValues(IOOp op, uint64_t &count, uint64_t &bytes, uint64_t &sequential, uint64_t &random, uint64_t &nanos);
+    LatencyHistogram &getHistogram(IOOp op) { return histograms[op]; };
+    const string &getFileName() { return fileName; };
+    void reset();
+    void dumpJSON(ostream &out);                                        // One JSON object, see IOStatsManager::dumpJSON
+
+    static const char* getOpName(IOOp op);
+
+private:
+    string fileName;
+    LatencyHistogram histograms[IO_OP_COUNT];
+    atomic<uint64_t> bytes[IO_OP_COUNT];
+    atomic<uint64_t> sequential[IO_OP_COUNT];
+    atomic<uint64_t> random[IO_OP_COUNT];
+    atomic<off_t> nextOffset[IO_OP_COUNT];  // where the last transfer of a kind ended
+
+    friend class IOStatsManager;
+    unsigned users;                         // handles and logs holding the stats, under the manager's lock
+    bool named;                             // the file has not been destroyed
+};
+
+
+// Stats are kept per file name for as long as the process runs, so a file
+// that was closed still shows up. Destroying the file drops them once no
+// handle uses them any more
+class IOStatsManager
+{
+public:
+    static IOStatsManager* instance();                                      // Access to the _stats_manager instance
+
+    IOStats* openStats(const string &fileName);                             // Stats of a file for a new user, made on first use
+    void closeStats(IOStats *stats);                                        // The user is done, the stats stay
+    void dropStats(const string &fileName);                                 // The file was destroyed
+    IOStats* getStats(const string &fileName);                              // NULL if the file was never opened, valid until it is destroyed
+    RC dumpJSON(ostream &out);                                              // Every file as {"files":[...]}
+    RC dumpJSON(const string &path);                                        // The same, into a file
+
+protected:
+    IOStatsManager();                                                       // Constructor
+    ~IOStatsManager();                                                      // Destructor
+
+private:
+    static IOStatsManager *_stats_manager;
+
+    unordered_map<string, IOStats *> stats;
+    mutex statsLock;
+};
+
+#endif
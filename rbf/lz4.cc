@@ -0,0 +1,201 @@
+#include "lz4.h"
+
+#include <stdint.h>
+#include <string.h>
+
+const int LZ4_MIN_MATCH = 4;
+const int LZ4_LAST_LITERALS = 5;        // the block ends with at least this many literals
+const int LZ4_MATCH_FIND_LIMIT = 12;    // and its last match starts this far from the end
+const int LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_LOG = 12;
+const int LZ4_SKIP_TRIGGER = 6;         // after 2^6 failed probes the search steps two bytes, and so on
+
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(uint32_t));
+    return value;
+}
+
+
+static inline unsigned hash4(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+
+// the part of a length that does not fit in its token nibble, 255 at a time
+static inline unsigned char* writeLength(unsigned char *out, unsigned length)
+{
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = (unsigned char) length;
+    return out;
+}
+
+
+// room for a sequence with this many literals and a match of this length
+static inline bool fits(const unsigned char *out, const unsigned char *outEnd, unsigned literals, unsigned matchLength)
+{
+    size_t needed = 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1;
+    return (size_t) (outEnd - out) >= needed;
+}
+
+
+int lz4Compress(const void *source, int length, void *dest, int capacity)
+{
+    const unsigned char *base = (const unsigned char *) source;
+    const unsigned char *end = base + length;
+    const unsigned char *matchLimit = end - LZ4_LAST_LITERALS;
+    const unsigned char *findLimit = end - LZ4_MATCH_FIND_LIMIT;
+    unsigned char *out = (unsigned char *) dest;
+    unsigned char *outEnd = out + capacity;
+    const unsigned char *anchor = base;
+
+    if (length > LZ4_MATCH_FIND_LIMIT) {
+        // positions of the last 4 byte sequences seen, a stale one only costs a compare
+        uint32_t table[1 << LZ4_HASH_LOG];
+        memset(table, 0, sizeof(table));
+        const unsigned char *ip = base + 1;
+
+        while (ip <= findLimit) {
+            // the search speeds up the longer it finds nothing, so data that
+            // does not compress is skipped over quickly
+            const unsigned char *match = NULL;
+            unsigned probes = 1 << LZ4_SKIP_TRIGGER;
+            while (ip <= findLimit) {
+                uint32_t sequence = read32(ip);
+                unsigned h = hash4(sequence);
+                const unsigned char *candidate = base + table[h];
+                table[h] = ip - base;
+                if (candidate < ip && ip - candidate <= LZ4_MAX_OFFSET && read32(candidate) == sequence) {
+                    match = candidate;
+                    break;
+                }
+                ip += probes++ >> LZ4_SKIP_TRIGGER;
+            }
+            if (match == NULL) {
+                break;
+            }
+
+            // grow the match backwards into the literals, then forwards
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+            unsigned literals = ip - anchor;
+            const unsigned char *matchEnd = ip + LZ4_MIN_MATCH;
+            while (matchEnd < matchLimit && *matchEnd == match[matchEnd - ip]) {
+                matchEnd++;
+            }
+            unsigned matchLength = matchEnd - ip - LZ4_MIN_MATCH;
+            if (!fits(out, outEnd, literals, matchLength)) {
+                return 0;
+            }
+
+            unsigned char *token = out++;
+            *token = (literals >= 15 ? 15 : literals) << 4;
+            if (literals >= 15) {
+                out = writeLength(out, literals - 15);
+            }
+            memcpy(out, anchor, literals);
+            out += literals;
+            unsigned offset = ip - match;
+            *out++ = offset & 0xff;
+            *out++ = offset >> 8;
+            *token |= matchLength >= 15 ? 15 : matchLength;
+            if (matchLength >= 15) {
+                out = writeLength(out, matchLength - 15);
+            }
+
+            ip = anchor = matchEnd;
+            if (ip <= findLimit) {
+                table[hash4(read32(ip - 2))] = ip - 2 - base;
+            }
+        }
+    }
+
+    // whatever is left goes out as literals
+    unsigned literals = end - anchor;
+    if (!fits(out, outEnd, literals, 0)) {
+        return 0;
+    }
+    *out++ = (literals >= 15 ? 15 : literals) << 4;
+    if (literals >= 15) {
+        out = writeLength(out, literals - 15);
+    }
+    memcpy(out, anchor, literals);
+    out += literals;
+    return out - (unsigned char *) dest;
+}
+
+
+// a length continued past its nibble, false if the block ends first
+static inline bool readLength(const unsigned char *&ip, const unsigned char *ipEnd, unsigned &length)
+{
+    unsigned char next;
+    do {
+        if (ip >= ipEnd) {
+            return false;
+        }
+        next = *ip++;
+        length += next;
+    } while (next == 255);
+    return true;
+}
+
+
+int lz4Decompress(const void *source, int sourceLength, void *dest, int capacity)
+{
+    const unsigned char *ip = (const unsigned char *) source;
+    const unsigned char *ipEnd = ip + sourceLength;
+    unsigned char *op = (unsigned char *) dest;
+    unsigned char *opEnd = op + capacity;
+
+    // every length and offset is checked, the block may come from a damaged page
+    while (ip < ipEnd) {
+        unsigned token = *ip++;
+        unsigned literals = token >> 4;
+        if (literals == 15 && !readLength(ip, ipEnd, literals)) {
+            return -1;
+        }
+        if (literals > (size_t) (ipEnd - ip) || literals > (size_t) (opEnd - op)) {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == ipEnd) {
+            // the last sequence has no match
+            break;
+        }
+
+        if (ipEnd - ip < 2) {
+            return -1;
+        }
+        unsigned offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        unsigned matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, ipEnd, matchLength)) {
+            return -1;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - (unsigned char *) dest) || matchLength > (size_t) (opEnd - op)) {
+            return -1;
+        }
+
+        // a match closer than its length repeats the bytes it is copying
+        const unsigned char *match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            for (unsigned i = 0; i < matchLength; i++) {
+                *op++ = *match++;
+            }
+        }
+    }
+    return op - (unsigned char *) dest;
+}
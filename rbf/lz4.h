@@ -0,0 +1,18 @@
+#ifndef _lz4_h_
+#define _lz4_h_
+
+#include <stddef.h>
+
+// Compression in the LZ4 block format: a token with the literal and match
+// lengths, the literals, then a 2 byte offset back to the match. It is meant
+// for pages, a greedy single pass with a small hash table, and decompresses
+// at memory speed.
+
+// Compress length bytes into at most capacity bytes, 0 if they do not fit
+int lz4Compress(const void *source, int length, void *dest, int capacity);
+
+// Decompress a block into at most capacity bytes, -1 if it is damaged
+// or does not fit. Returns the number of bytes written
+int lz4Decompress(const void *source, int sourceLength, void *dest, int capacity);
+
+#endif
@@ -0,0 +1,279 @@
+#include "pagemap.h"
+#include "crc32c.h"
+
+#include <algorithm>
+
+PageMapManager* PageMapManager::_map_manager = 0;
+
+PageMapManager* PageMapManager::instance()
+{
+    if(!_map_manager)
+        _map_manager = new PageMapManager();
+
+    return _map_manager;
+}
+
+
+PageMapManager::PageMapManager()
+{
+}
+
+
+PageMapManager::~PageMapManager()
+{
+}
+
+
+RC PageMapManager::openMap(const string &fileName, FileHandle &fileHandle, PageMap *&pageMap)
+{
+    lock_guard<mutex> guard(mapsLock);
+    auto it = maps.find(fileName);
+    if (it != maps.end()) {
+        it->second.users++;
+        pageMap = it->second.pageMap;
+        return 0;
+    }
+
+    pageMap = new PageMap();
+    if (pageMap->load(fileHandle) == -1) {
+        delete pageMap;
+        pageMap = NULL;
+        return -1;
+    }
+    OpenMap openMap;
+    openMap.pageMap = pageMap;
+    openMap.users = 1;
+    maps[fileName] = openMap;
+    return 0;
+}
+
+
+RC PageMapManager::closeMap(PageMap *pageMap)
+{
+    lock_guard<mutex> guard(mapsLock);
+    for (auto it = maps.begin(); it != maps.end(); ++it) {
+        if (it->second.pageMap != pageMap) {
+            continue;
+        }
+        if (--it->second.users == 0) {
+            delete pageMap;
+            maps.erase(it);
+        }
+        return 0;
+    }
+    return -1;
+}
+
+
+PageMap::PageMap()
+{
+    savedMap.unit = 0;
+    savedMap.length = 0;
+    savingMap.unit = 0;
+    savingMap.length = 0;
+    savedChecksum = 0;
+    savingChecksum = 0;
+    endUnit = 0;
+    changed = false;
+}
+
+
+PageMap::~PageMap()
+{
+}
+
+
+RC PageMap::load(FileHandle &fileHandle)
+{
+    lock_guard<mutex> guard(mapLock);
+    const FileHeader &header = fileHandle.header;
+    savedMap.unit = header.pageMapUnit;
+    savedMap.length = header.pageMapLength;
+    savedChecksum = header.pageMapChecksum;
+    if (savedMap.length % sizeof(PageMapEntry) != 0) {
+        return -1;
+    }
+    entries.resize(savedMap.length / sizeof(PageMapEntry));
+    if (savedMap.length != 0) {
+        if (fileHandle.readBlock(unitOffset(savedMap.unit), &entries[0], savedMap.length) == -1
+            || crc32c(0, &entries[0], savedMap.length) != savedChecksum) {
+            return -1;
+        }
+    }
+
+    // the free runs are the gaps between the ones in use
+    vector<pair<uint32_t, uint32_t> > used;
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->length > PAGE_SIZE) {
+            return -1;
+        }
+        if (it->length != 0) {
+            used.push_back(make_pair(it->unit, unitsFor(it->length)));
+        }
+    }
+    if (savedMap.length != 0) {
+        used.push_back(make_pair(savedMap.unit, unitsFor(savedMap.length)));
+    }
+    sort(used.begin(), used.end());
+    for (auto it = used.begin(); it != used.end(); ++it) {
+        if (it->first > endUnit) {
+            freeRuns[endUnit] = it->first - endUnit;
+        }
+        endUnit = max(endUnit, it->first + it->second);
+    }
+    return 0;
+}
+
+
+RC PageMap::lookup(PageNum pageNum, PageMapEntry &entry)
+{
+    lock_guard<mutex> guard(mapLock);
+    if (pageNum < entries.size()) {
+        entry = entries[pageNum];
+    } else {
+        entry.unit = 0;
+        entry.length = 0;
+    }
+    return 0;
+}
+
+
+RC PageMap::place(PageNum pageNum, unsigned length, PageMapEntry &entry)
+{
+    if (length == 0 || length > PAGE_SIZE) {
+        return -1;
+    }
+    lock_guard<mutex> guard(mapLock);
+    if (pageNum >= entries.size()) {
+        PageMapEntry none = { 0, 0 };
+        entries.resize(pageNum + 1, none);
+    }
+    PageMapEntry &current = entries[pageNum];
+    if (current.length != 0) {
+        pendingRuns.push_back(make_pair(current.unit, unitsFor(current.length)));
+    }
+    current.unit = allocate(unitsFor(length));
+    current.length = length;
+    changed = true;
+    entry = current;
+    return 0;
+}
+
+
+void PageMap::truncate(unsigned pages)
+{
+    lock_guard<mutex> guard(mapLock);
+    for (unsigned i = pages; i < entries.size(); i++) {
+        if (entries[i].length != 0) {
+            pendingRuns.push_back(make_pair(entries[i].unit, unitsFor(entries[i].length)));
+        }
+    }
+    if (pages < entries.size()) {
+        entries.resize(pages);
+        changed = true;
+    }
+}
+
+
+RC PageMap::save(FileHandle &fileHandle, FileHeader &header)
+{
+    vector<PageMapEntry> snapshot;
+    {
+        lock_guard<mutex> guard(mapLock);
+        if (!changed) {
+            // the map on disk is still right
+            header.pageMapUnit = savedMap.unit;
+            header.pageMapLength = savedMap.length;
+            header.pageMapChecksum = savedChecksum;
+            return 0;
+        }
+        // pages placed from here on are in the next save
+        snapshot = entries;
+        savingRuns.swap(pendingRuns);
+        savingMap.length = snapshot.size() * sizeof(PageMapEntry);
+        savingMap.unit = allocate(unitsFor(savingMap.length));
+        changed = false;
+    }
+
+    savingChecksum = crc32c(0, &snapshot[0], savingMap.length);
+    if (fileHandle.writeBlock(unitOffset(savingMap.unit), &snapshot[0], savingMap.length) == -1) {
+        return -1;
+    }
+    header.pageMapUnit = savingMap.unit;
+    header.pageMapLength = savingMap.length;
+    header.pageMapChecksum = savingChecksum;
+    return 0;
+}
+
+
+void PageMap::endSave(bool written)
+{
+    lock_guard<mutex> guard(mapLock);
+    if (savingMap.length == 0) {
+        return;
+    }
+    if (written) {
+        // nothing on disk points at the old map or the images it had any more
+        if (savedMap.length != 0) {
+            release(savedMap.unit, unitsFor(savedMap.length));
+        }
+        for (auto it = savingRuns.begin(); it != savingRuns.end(); ++it) {
+            release(it->first, it->second);
+        }
+        savedMap = savingMap;
+        savedChecksum = savingChecksum;
+    } else {
+        // the old map is still the one on disk, try again with the next save
+        release(savingMap.unit, unitsFor(savingMap.length));
+        pendingRuns.insert(pendingRuns.end(), savingRuns.begin(), savingRuns.end());
+        changed = true;
+    }
+    savingRuns.clear();
+    savingMap.unit = 0;
+    savingMap.length = 0;
+}
+
+
+uint32_t PageMap::allocate(unsigned units)
+{
+    // first fit, then the end of the file
+    for (auto it = freeRuns.begin(); it != freeRuns.end(); ++it) {
+        if (it->second < units) {
+            continue;
+        }
+        uint32_t unit = it->first;
+        uint32_t rest = it->second - units;
+        freeRuns.erase(it);
+        if (rest != 0) {
+            freeRuns[unit + units] = rest;
+        }
+        return unit;
+    }
+    uint32_t unit = endUnit;
+    endUnit += units;
+    return unit;
+}
+
+
+void PageMap::release(uint32_t unit, unsigned units)
+{
+    // merge with the free runs on either side
+    auto next = freeRuns.lower_bound(unit);
+    if (next != freeRuns.end() && unit + units == next->first) {
+        units += next->second;
+        next = freeRuns.erase(next);
+    }
+    if (next != freeRuns.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == unit) {
+            unit = prev->first;
+            units += prev->second;
+            freeRuns.erase(prev);
+        }
+    }
+    if (unit + units == endUnit) {
+        endUnit = unit;
+        return;
+    }
+    freeRuns[unit] = units;
+}
@@ -0,0 +1,95 @@
+#ifndef _pagemap_h_
+#define _pagemap_h_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <stdint.h>
+
+#include "pfm.h"
+
+using namespace std;
+
+// Compressed pages are stored in runs of these, after the header page
+const unsigned COMPRESS_UNIT = 128;
+
+inline unsigned unitsFor(unsigned length) { return (length + COMPRESS_UNIT - 1) / COMPRESS_UNIT; }
+inline off_t unitOffset(uint32_t unit) { return (off_t) HEADER_PAGES * PAGE_SIZE + (off_t) unit * COMPRESS_UNIT; }
+
+// Where the image of a page is
+typedef struct
+{
+    uint32_t unit;               // first unit of its run
+    uint32_t length;             // bytes in the image, 0 if the page was never written, PAGE_SIZE if it is stored as is
+} PageMapEntry;
+
+
+// Page map of one FILE_COMPRESSED file, shared by every handle open on the
+// file. Pages are stored compressed where they fit, a page number is looked up
+// in the map to find its image. The map is saved into the file along with the
+// header, which points at it.
+//
+// A page is never rewritten in place, every image goes to a fresh run and the
+// old one is freed. Runs the map on disk still points at are only reused once
+// a newer map is saved, so after a crash the saved map finds whole images and
+// the log brings them up to date.
+class PageMap
+{
+public:
+    PageMap();
+    ~PageMap();
+
+    RC load(FileHandle &fileHandle);                                        // Read the map the header of the file points at
+    RC lookup(PageNum pageNum, PageMapEntry &entry);                        // Image of a page, length 0 if it has none
+    RC place(PageNum pageNum, unsigned length, PageMapEntry &entry);        // Run for a new image of a page, the old one is freed later
+    void truncate(unsigned pages);                                          // Forget the pages from this one on, their runs are freed later
+    RC save(FileHandle &fileHandle, FileHeader &header);                    // Write the map into a new run and point the header at it
+    void endSave(bool written);                                             // The header went out, or not, after save
+    mutex saveLock;                                                         // held from save to endSave, so headers go out in order
+
+private:
+    vector<PageMapEntry> entries;
+    map<uint32_t, uint32_t> freeRuns;              // first unit to units, no two of them touch
+    vector<pair<uint32_t, uint32_t> > pendingRuns; // freed since the last save, the map on disk may point at them
+    vector<pair<uint32_t, uint32_t> > savingRuns;  // pending at the save under way, free once its header is written
+    PageMapEntry savedMap;                         // run holding the map on disk
+    PageMapEntry savingMap;
+    uint32_t savedChecksum;
+    uint32_t savingChecksum;
+    uint32_t endUnit;                              // units past it are unused
+    bool changed;                                  // a page was placed since the last save
+    mutex mapLock;
+
+    uint32_t allocate(unsigned units);
+    void release(uint32_t unit, unsigned units);
+};
+
+
+// Maps are shared by the handles of a file, the first one to open it loads it
+class PageMapManager
+{
+public:
+    static PageMapManager* instance();                                      // Access to the _map_manager instance
+
+    RC openMap(const string &fileName, FileHandle &fileHandle, PageMap *&pageMap); // Get the map of a file, loading it for its first user
+    RC closeMap(PageMap *pageMap);                                          // Release a map, the last user frees it
+
+protected:
+    PageMapManager();                                                       // Constructor
+    ~PageMapManager();                                                      // Destructor
+
+private:
+    static PageMapManager *_map_manager;
+
+    typedef struct
+    {
+        PageMap *pageMap;
+        unsigned users;
+    } OpenMap;
+    unordered_map<string, OpenMap> maps;
+    mutex mapsLock;
+};
+
+#endif
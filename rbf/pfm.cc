@@ -1,4 +1,14 @@
 #include "pfm.h"
+#include "bpm.h"
+#include "aio.h"
+#include "wal.h"
+#include "crc32c.h"
+#include "pagemap.h"
+#include "lz4.h"
+#include "iostats.h"
+
+#include <errno.h>
+#include <chrono>
 
 PagedFileManager* PagedFileManager::_pf_manager = 0;
 
@@ -13,6 +23,27 @@ PagedFileManager* PagedFileManager::instance()
     
 PagedFileManager::PagedFileManager()
 {
+    closeAtExit = false;
+}
+
+
+// shared handles are only closed when their last user lets go, whatever is
+// still open at exit gets flushed here
+static void closeSharedFilesAtExit()
+{
+    PagedFileManager::instance()->closeSharedFiles();
+}
+
+
+static void initHeader(FileHeader &header)
+{
+    memset(&header, 0, sizeof(FileHeader));
+    header.magic = FILE_MAGIC;
+    header.version = FILE_FORMAT_VERSION;
+    header.fsmRoot = NO_PAGE;
+    header.indexRoot = NO_PAGE;
+    header.pageSize = PAGE_SIZE;
+    header.freeListHead = NO_PAGE;
 }
 
 
@@ -22,50 +53,127 @@ PagedFileManager::~PagedFileManager()
 }
 
 
-RC PagedFileManager::createFile(const string &fileName)
+RC PagedFileManager::createFile(const string &fileName, unsigned flags)
 {
-    // we must first test to see if the file already exists
-    ifstream test_file(fileName.c_str());
-    if (test_file.good()) {
+    // O_EXCL makes the open fail if the file already exists
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+
+    // an empty file still has its header page
+    char page[PAGE_SIZE];
+    memset(page, 0, PAGE_SIZE);
+    FileHeader header;
+    initHeader(header);
+    header.flags = flags;
+    memcpy(page, &header, sizeof(FileHeader));
+    if (pwrite(fd, page, PAGE_SIZE, 0) != PAGE_SIZE) {
+        close(fd);
+        std::remove(fileName.c_str());
+        return -1;
+    }
+    close(fd);
+
+    // a log left by an earlier file of the same name would be replayed into this one
+    if (LogManager::instance()->destroyLog(fileName) == -1) {
+        std::remove(fileName.c_str());
         return -1;
-    } else {
-        ofstream new_file(fileName.c_str(), ios::binary);
-        if (new_file.is_open()) {
-            new_file.close();
-            return 0;
-        } else {
-            return -1;
-        }
     }
+
+    // pages of a file that was removed behind our back must not be served
+    BufferPoolManager::instance()->discardFile(fileName);
+    return 0;
 }
 
 
 RC PagedFileManager::destroyFile(const string &fileName)
 {
+    {
+        // a file made again under this name must not get the old handle
+        lock_guard<mutex> guard(sharedLock);
+        auto it = sharedNames.find(fileName);
+        if (it != sharedNames.end()) {
+            sharedFiles[it->second].named = false;
+            sharedNames.erase(it);
+        }
+    }
     if (!std::remove(fileName.c_str())) {
-        return 0;
+        BufferPoolManager::instance()->discardFile(fileName);
+        IOStatsManager::instance()->dropStats(fileName);
+        return LogManager::instance()->destroyLog(fileName);
     } else {
         return -1;
     }
 }
 
 
-RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
+RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle, IOMode ioMode)
 {
     // check if the file exists
     struct stat buffer;
     if (stat (fileName.c_str(), &buffer) == 0) {
-        if(fileHandle.infile != NULL) {
+        if(fileHandle.isOpen()) {
             // this means the handle is associated with another file
             return 0;
         }
         // link this new file handle to this opened file
-        fileHandle.outfile = new ofstream(fileName.c_str(), ios::binary | ios::in | ios::out);
-        fileHandle.infile = new ifstream(fileName.c_str(), ios::binary);
+        if (ioMode == IO_STREAM) {
+            fileHandle.outfile = new ofstream(fileName.c_str(), ios::binary | ios::in | ios::out);
+            fileHandle.infile = new ifstream(fileName.c_str(), ios::binary);
+        } else if (ioMode == IO_DIRECT) {
+            // the kernel page cache is skipped, so every buffer handed to it must be aligned
+            fileHandle.fd = open(fileName.c_str(), O_RDWR | O_DIRECT);
+            if (fileHandle.fd == -1) {
+                return -1;
+            }
+        } else {
+            fileHandle.fd = open(fileName.c_str(), O_RDWR);
+            if (fileHandle.fd == -1) {
+                return -1;
+            }
+        }
+        fileHandle.ioMode = ioMode;
+        fileHandle.ioStats = IOStatsManager::instance()->openStats(fileName);
+        fileHandle.numPages = 0;
+        fileHandle.corruptPage = NO_PAGE;
+        fileHandle.readAheadWindow = 0;
+        fileHandle.lastReadPage = NO_PAGE;
+        if (fileHandle.readHeader() == -1) {
+            // not a paged file, or one from an older format
+            fileHandle.closeStreams();
+            return -1;
+        }
+        // compressed pages have no fixed place to map or to read aligned
+        if (fileHandle.isCompressed() && (ioMode == IO_MMAP || ioMode == IO_DIRECT)) {
+            fileHandle.closeStreams();
+            return -1;
+        }
+        // the log is replayed through the page map
+        if (fileHandle.openPageMap(fileName) == -1) {
+            fileHandle.closeStreams();
+            return -1;
+        }
+        // changes a handle logged but never wrote to the file are redone first
+        if (fileHandle.openLog(fileName) == -1) {
+            fileHandle.closePageMap();
+            fileHandle.closeStreams();
+            return -1;
+        }
+        // the file may be longer than its page count, the rest is reserved space
+        off_t filePages = buffer.st_size / PAGE_SIZE;
+        fileHandle.allocatedPages = filePages > HEADER_PAGES ? filePages - HEADER_PAGES : 0;
+        fileHandle.allocatedPages = max(fileHandle.allocatedPages, fileHandle.numPages.load());
+        fileHandle.fileId = BufferPoolManager::instance()->getFileId(fileName);
 
-        fileHandle.infile->seekg(0, ios::end);
-        int length = fileHandle.infile->tellg();
-        fileHandle.numPages = length / PAGE_SIZE;
+        if (ioMode == IO_MMAP) {
+            // the mapping bypasses the pool, cached frames would go stale behind it
+            BufferPoolManager::instance()->discardFile(fileName);
+            if (fileHandle.growMapping(fileHandle.numPages) == -1) {
+                fileHandle.closeStreams();
+                return -1;
+            }
+        }
         return 0;
     } else {
         return -1;
@@ -76,115 +184,1574 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    if (fileHandle.infile == NULL) {
+    if (!fileHandle.isOpen()) {
         // file is not associated with a file (error)
         return -1;
     }
     // check to see if the file is open and close it
-    if (fileHandle.infile->is_open()) {
+    if (fileHandle.fd != -1 || fileHandle.infile->is_open()) {
         // the file exists and its open
         if (fileHandle.currentPage != NULL) {
             fileHandle.writePage(fileHandle.currentPageNum, fileHandle.currentPage); 
             fileHandle.currentPage = NULL;
             fileHandle.currentPageNum = -1;
         }
+        // reads still in flight land in pool frames and need the descriptor
+        if (fileHandle.closeAsyncIO() == -1) {
+            return -1;
+        }
+        // the cached pages outlive the handle but its dirty pages must reach the file
+        if (BufferPoolManager::instance()->flushFile(fileHandle) == -1) {
+            return -1;
+        }
+        // the header goes last so it never counts pages that are not in the file
+        if (fileHandle.writeHeader() == -1) {
+            return -1;
+        }
+        // the last handle on the file empties the log once the pages are synced
+        if (fileHandle.closeLog(true) == -1) {
+            return -1;
+        }
+        if (fileHandle.closePageMap() == -1) {
+            return -1;
+        }
         // clear the free space list
         fileHandle.freeSpace.clear();
+        fileHandle.freeSpaceTree.clear();
         fileHandle.numPages = 0;
+        fileHandle.allocatedPages = 0;
 
-        fileHandle.infile->close();
-        fileHandle.outfile->close();
-        delete fileHandle.infile;
-        delete fileHandle.outfile;
-        fileHandle.infile = NULL;
-        fileHandle.outfile = NULL;
+        fileHandle.unmapFile();
+        fileHandle.closeStreams();
         return 0;
     }
     return -1;
 }
 
 
+RC PagedFileManager::shareFile(const string &fileName, FileHandle *&fileHandle, IOMode ioMode)
+{
+    lock_guard<mutex> guard(sharedLock);
+    auto it = sharedNames.find(fileName);
+    if (it != sharedNames.end()) {
+        // the first user picked the backend
+        if (it->second->ioMode != ioMode) {
+            return -1;
+        }
+        sharedFiles[it->second].users++;
+        fileHandle = it->second;
+        return 0;
+    }
+
+    fileHandle = new FileHandle();
+    if (openFile(fileName, *fileHandle, ioMode) == -1) {
+        delete fileHandle;
+        fileHandle = NULL;
+        return -1;
+    }
+    SharedFile sharedFile;
+    sharedFile.fileName = fileName;
+    sharedFile.users = 1;
+    sharedFile.named = true;
+    sharedFiles[fileHandle] = sharedFile;
+    sharedNames[fileName] = fileHandle;
+    if (!closeAtExit) {
+        atexit(closeSharedFilesAtExit);
+        closeAtExit = true;
+    }
+    return 0;
+}
+
+
+RC PagedFileManager::releaseFile(FileHandle *fileHandle)
+{
+    lock_guard<mutex> guard(sharedLock);
+    auto it = sharedFiles.find(fileHandle);
+    if (it == sharedFiles.end()) {
+        return -1;
+    }
+    if (--it->second.users != 0) {
+        return 0;
+    }
+    // pages that could not be written still need the handle, it stays open
+    // for the next user and closeSharedFiles tries again at exit
+    if (closeFile(*fileHandle) == -1) {
+        return -1;
+    }
+    if (it->second.named) {
+        sharedNames.erase(it->second.fileName);
+    }
+    sharedFiles.erase(it);
+    delete fileHandle;
+    return 0;
+}
+
+
+RC PagedFileManager::closeSharedFiles()
+{
+    lock_guard<mutex> guard(sharedLock);
+    RC rc = 0;
+    for (auto it = sharedFiles.begin(); it != sharedFiles.end(); ++it) {
+        // a handle that failed to close may still own dirty pages of the pool
+        if (closeFile(*it->first) == -1) {
+            rc = -1;
+            continue;
+        }
+        delete it->first;
+    }
+    sharedFiles.clear();
+    sharedNames.clear();
+    return rc;
+}
+
+
 
 FileHandle::FileHandle()
 {
     readPageCounter = 0;
     writePageCounter = 0;
     appendPageCounter = 0;
+    hitPageCounter = 0;
+    missPageCounter = 0;
+    evictPageCounter = 0;
+    rawByteCounter = 0;
+    storedByteCounter = 0;
+    decodedByteCounter = 0;
+    decodeNanoCounter = 0;
+    fileId = 0;
     numPages = 0;
+    allocatedPages = 0;
+    extentPages = DEFAULT_EXTENT_PAGES;
+    readAheadPages = DEFAULT_READ_AHEAD_PAGES;
+    readAheadWindow = 0;
+    lastReadPage = NO_PAGE;
+    readAheadEnd = 0;
+    ioMode = IO_PREAD;
+    fd = -1;
     infile = NULL;
     outfile = NULL;
+    mapping = NULL;
+    mappedSize = 0;
+    asyncIO = NULL;
+    log = NULL;
+    pageMap = NULL;
+    ioStats = NULL;
+    readsInFlight = 0;
     currentPage = NULL;
     currentPageNum = -1;
+    initHeader(header);
+    corruptPage = NO_PAGE;
+    openFsmRoot = NO_PAGE;
+    openIndexRoot = NO_PAGE;
+    openFreeListHead = NO_PAGE;
+    openFreePageCount = 0;
+    truncated = false;
+    savedReadCount = 0;
+    savedWriteCount = 0;
+    savedAppendCount = 0;
+    pthread_rwlock_init(&mappingLatch, NULL);
+    pthread_rwlock_init(&fileLatch, NULL);
 }
 
 
 FileHandle::~FileHandle()
 {
+    closeAsyncIO();
+    // a handle that was never closed still owns dirty frames in the pool
+    if (isOpen()) {
+        bool flushed = BufferPoolManager::instance()->flushFile(*this) == 0;
+        writeHeader();
+        closeLog(flushed);
+        closePageMap();
+    }
+    IOStatsManager::instance()->closeStats(ioStats);
+    ioStats = NULL;
+    unmapFile();
+    pthread_rwlock_destroy(&mappingLatch);
+    pthread_rwlock_destroy(&fileLatch);
 }
 
 
 RC FileHandle::readPage(PageNum pageNum, void *data)
 {
-    /*infile->seekg(0, ios::end);
-    int length = infile->tellg();
-
-    // Added length guard to protect reading from outside of bounds
-    if ((pageNum * PAGE_SIZE) >= length) {
-        return -1;
-    }*/
-
     if (pageNum >= numPages) {
         return -1;
     }
+    noteRead(pageNum);
 
-    if (infile != NULL && infile->is_open()) {
-        infile->seekg(pageNum * PAGE_SIZE, ios::beg);
-        infile->read(((char *) data), PAGE_SIZE);
+    if (mapping != NULL) {
+        latchMapping(LATCH_SHARED);
+        memcpy((char *) data, mapping + pageOffset(pageNum), PAGE_SIZE);
+        unlatchMapping(LATCH_SHARED);
         readPageCounter++;
-        return 0;
-    } else {
+        return verifyPage(pageNum, data);
+    }
+
+    void *page;
+    if (BufferPoolManager::instance()->fetchPage(*this, pageNum, page, true, LATCH_SHARED) == -1) {
+        return -1;
+    }
+    memcpy((char *) data, (char *) page, PAGE_SIZE);
+    BufferPoolManager::instance()->unpinPage(*this, pageNum, false, LATCH_SHARED);
+    readPageCounter++;
+    return 0;
+}
+
+
+RC FileHandle::readPage(PageNum pageNum, const void *&page)
+{
+    // only a mapping can hand out a page that stays put without being pinned
+    if (mapping == NULL || pageNum >= numPages) {
+        return -1;
+    }
+    noteRead(pageNum);
+    if (verifyMappedPage(pageNum) == -1) {
         return -1;
     }
+    page = mapping + pageOffset(pageNum);
+    readPageCounter++;
+    return 0;
 }
 
 
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
-    if (outfile != NULL && outfile->is_open()) {
-        outfile->seekp(pageNum * PAGE_SIZE, ios::beg);
-        outfile->write(((char *) data), PAGE_SIZE);
+    if (pageNum >= numPages) {
+        return -1;
+    }
+
+    if (mapping != NULL) {
+        latchMapping(LATCH_EXCLUSIVE);
+        memcpy(mapping + pageOffset(pageNum), (char *) data, PAGE_SIZE);
+        stampPage(pageNum, mapping + pageOffset(pageNum));
+        unlatchMapping(LATCH_EXCLUSIVE);
         writePageCounter++;
         return 0;
-    } else {
+    }
+
+    // the whole page is replaced so a miss does not need to read it first,
+    // unless only the difference to the old page is logged
+    void *page;
+    if (BufferPoolManager::instance()->fetchPage(*this, pageNum, page, log != NULL, LATCH_EXCLUSIVE) == -1) {
+        return -1;
+    }
+    uint64_t lsn = 0;
+    if (log != NULL && log->logPage(pageNum, page, data, lsn) == -1) {
+        BufferPoolManager::instance()->unpinPage(*this, pageNum, false, LATCH_EXCLUSIVE);
         return -1;
     }
+    memcpy((char *) page, (char *) data, PAGE_SIZE);
+    BufferPoolManager::instance()->unpinPage(*this, pageNum, true, LATCH_EXCLUSIVE, lsn);
+    writePageCounter++;
+    return 0;
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-    if (outfile != NULL && outfile->is_open()) {
-        outfile->seekp(0, ios::end);
-        outfile->write(((char *) data), PAGE_SIZE);
+    // readers see the new page once numPages moves past it
+    lock_guard<mutex> guard(appendLock);
+    return appendPageLocked(data);
+}
+
+
+RC FileHandle::allocatePage(const void *data, PageNum &pageNum)
+{
+    lock_guard<mutex> guard(appendLock);
+    if (header.freeListHead != NO_PAGE) {
+        PageNum next;
+        if (isFreePage(header.freeListHead, next)) {
+            if (writePage(header.freeListHead, data) == -1) {
+                return -1;
+            }
+            pageNum = header.freeListHead;
+            header.freeListHead = next;
+            header.freePageCount--;
+            return 0;
+        }
+        // the list is older than the pages, what is left of it is lost
+        header.freeListHead = NO_PAGE;
+        header.freePageCount = 0;
+    }
+
+    pageNum = numPages;
+    return appendPageLocked(data);
+}
+
+
+RC FileHandle::reusePage(PageNum &pageNum)
+{
+    lock_guard<mutex> guard(appendLock);
+    PageNum next;
+    if (header.freeListHead == NO_PAGE) {
+        return -1;
+    }
+    if (!isFreePage(header.freeListHead, next)) {
+        // the list is older than the pages, what is left of it is lost
+        header.freeListHead = NO_PAGE;
+        header.freePageCount = 0;
+        return -1;
+    }
+    // the caller overwrites the marker, until then a crash leaves the page in the list
+    pageNum = header.freeListHead;
+    header.freeListHead = next;
+    header.freePageCount--;
+    return 0;
+}
+
+
+RC FileHandle::freePage(PageNum pageNum)
+{
+    lock_guard<mutex> guard(appendLock);
+    PageNum next;
+    // a page in the list twice would be handed out twice
+    if (pageNum >= numPages || isFreePage(pageNum, next)) {
+        return -1;
+    }
+    if (writeFreePage(pageNum, header.freeListHead) == -1) {
+        return -1;
+    }
+    header.freeListHead = pageNum;
+    header.freePageCount++;
+    return 0;
+}
+
+
+RC FileHandle::truncate()
+{
+    // the checkpoint below needs record writers held off like any other
+    pthread_rwlock_wrlock(&fileLatch);
+    RC rc;
+    {
+        lock_guard<mutex> guard(appendLock);
+        rc = truncateLocked();
+    }
+    pthread_rwlock_unlock(&fileLatch);
+    return rc;
+}
+
+
+RC FileHandle::truncateLocked()
+{
+    // a replay would write the cut pages back from their records, so only a
+    // file whose log this handle can empty is cut. Otherwise the pages stay free
+    if (log != NULL && LogManager::instance()->isShared(log)) {
+        return 0;
+    }
+    vector<PageNum> list;
+    vector<bool> isFree(numPages, false);
+    PageNum pageNum = header.freeListHead;
+    PageNum next;
+    while (pageNum != NO_PAGE && pageNum < numPages && !isFree[pageNum] && isFreePage(pageNum, next)) {
+        list.push_back(pageNum);
+        isFree[pageNum] = true;
+        pageNum = next;
+    }
+
+    unsigned pages = numPages;
+    while (pages > 0 && isFree[pages - 1]) {
+        pages--;
+    }
+
+    // link up the pages that stay, in the order they were freed
+    vector<PageNum> kept;
+    for (unsigned i = 0; i < list.size(); i++) {
+        if (list[i] < pages) {
+            kept.push_back(list[i]);
+        }
+    }
+    for (unsigned i = 0; i < kept.size(); i++) {
+        PageNum after = i + 1 < kept.size() ? kept[i + 1] : NO_PAGE;
+        if (isFreePage(kept[i], next) && next != after && writeFreePage(kept[i], after) == -1) {
+            return -1;
+        }
+    }
+    header.freeListHead = kept.empty() ? NO_PAGE : kept[0];
+    header.freePageCount = kept.size();
+    if (pages == numPages) {
+        return 0;
+    }
+
+    // cached copies of the cut pages must not be written back past the end
+    if (BufferPoolManager::instance()->discardPages(*this, pages) == -1) {
+        return -1;
+    }
+    numPages = pages;
+    truncated = true;
+    if (freeSpace.size() > pages) {
+        freeSpace.resize(pages);
+        freeSpaceTree.clear();
+    }
+
+    // the header goes first, a crash before the file shrinks only leaves
+    // unused space at its end. Compressed pages are not at the end, their
+    // runs are reused once the map without them is saved
+    if (pageMap != NULL) {
+        pageMap->truncate(pages);
+    }
+    if (log != NULL ? checkpointLocked() == -1 : writeHeader() == -1) {
+        return -1;
+    }
+    if (pageMap == NULL && fd != -1) {
+        if (ftruncate(fd, pageOffset(pages)) == -1) {
+            return -1;
+        }
+        allocatedPages = pages;
+    }
+    return 0;
+}
+
+
+RC FileHandle::appendPageLocked(const void *data)
+{
+    if (reservePages(numPages + 1) == -1) {
+        return -1;
+    }
+
+    // a logged page only has to reach the file after its image is in the log,
+    // so it waits in the pool like any other dirty page
+    if (log != NULL) {
+        uint64_t lsn = 0;
+        void *page;
+        if (log->logPage(numPages, NULL, data, lsn) == -1) {
+            return -1;
+        }
+        if (BufferPoolManager::instance()->fetchPage(*this, numPages, page, false) == 0) {
+            memcpy((char *) page, (char *) data, PAGE_SIZE);
+            BufferPoolManager::instance()->unpinPage(*this, numPages, true, LATCH_NONE, lsn);
+        } else if (log->force(lsn) == -1 || writePageToDisk(numPages, data) == -1) {
+            return -1;
+        }
         appendPageCounter++;
         numPages++;
         return 0;
-    } else {
+    }
+
+    // appends go straight to the file, into space reserved ahead of them
+    if (writePageToDisk(numPages, data) == -1) {
         return -1;
     }
+
+    if (ioMode == IO_MMAP) {
+        if (growMapping(numPages + 1) == -1) {
+            return -1;
+        }
+        appendPageCounter++;
+        numPages++;
+        return 0;
+    }
+
+    // keep the new page around, it is usually the next one to be touched
+    void *page;
+    if (BufferPoolManager::instance()->fetchPage(*this, numPages, page, false) == 0) {
+        memcpy((char *) page, (char *) data, PAGE_SIZE);
+        BufferPoolManager::instance()->unpinPage(*this, numPages, false);
+    }
+    appendPageCounter++;
+    numPages++;
+    return 0;
 }
 
 
-unsigned FileHandle::getNumberOfPages()
+RC FileHandle::readPages(PageNum pageNum, unsigned count, void *data)
 {
-    return numPages;
+    if (pageNum + count > numPages || pageNum + count < pageNum) {
+        return -1;
+    }
+
+    if (mapping != NULL) {
+        latchMapping(LATCH_SHARED);
+        memcpy((char *) data, mapping + pageOffset(pageNum), (size_t) count * PAGE_SIZE);
+        unlatchMapping(LATCH_SHARED);
+        for (unsigned i = 0; i < count; i++) {
+            if (verifyPage(pageNum + i, (char *) data + (size_t) i * PAGE_SIZE) == -1) {
+                return -1;
+            }
+        }
+    } else if (BufferPoolManager::instance()->readPages(*this, pageNum, count, data) == -1) {
+        return -1;
+    }
+    readPageCounter += count;
+    return 0;
 }
 
 
-RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+RC FileHandle::writePages(PageNum pageNum, unsigned count, const void *data)
 {
-    readPageCount = readPageCounter;
-    writePageCount = writePageCounter;
-    appendPageCount = appendPageCounter;
+    // logged pages are diffed one at a time, the run cannot bypass the pool
+    if (log != NULL) {
+        for (unsigned i = 0; i < count; i++) {
+            const void *page = (const char *) data + (size_t) i * PAGE_SIZE;
+            RC rc = pageNum + i < numPages ? writePage(pageNum + i, page) : appendPage(page);
+            if (rc == -1) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    lock_guard<mutex> guard(appendLock);
+
+    // the run may start at the end of the file but not leave a hole
+    if (pageNum > numPages || pageNum + count < pageNum) {
+        return -1;
+    }
+
+    if (reservePages(pageNum + count) == -1) {
+        return -1;
+    }
+    if (BufferPoolManager::instance()->writePages(*this, pageNum, count, data) == -1) {
+        return -1;
+    }
+    unsigned newPages = pageNum + count > numPages ? pageNum + count - numPages : 0;
+    if (ioMode == IO_MMAP && growMapping(pageNum + count) == -1) {
+        return -1;
+    }
+    writePageCounter += count - newPages;
+    appendPageCounter += newPages;
+    numPages += newPages;
+    return 0;
+}
+
+
+RC FileHandle::pinPage(PageNum pageNum, void *&page, LatchMode latch)
+{
+    if (pageNum >= numPages) {
+        return -1;
+    }
+    noteRead(pageNum);
+    if (mapping != NULL) {
+        // the mapping is the page, there is nothing to pin
+        latchMapping(latch);
+        if (verifyMappedPage(pageNum) == -1) {
+            unlatchMapping(latch);
+            return -1;
+        }
+        page = mapping + pageOffset(pageNum);
+        readPageCounter++;
+        return 0;
+    }
+    if (BufferPoolManager::instance()->fetchPage(*this, pageNum, page, true, latch) == -1) {
+        return -1;
+    }
+    readPageCounter++;
+    return 0;
+}
+
+
+RC FileHandle::unpinPage(PageNum pageNum, bool dirty, LatchMode latch)
+{
+    if (mapping != NULL) {
+        // pages changed in place get their checksum before anyone else can see them
+        if (dirty) {
+            stampPage(pageNum, mapping + pageOffset(pageNum));
+            writePageCounter++;
+        }
+        unlatchMapping(latch);
+        return 0;
+    }
+    if (BufferPoolManager::instance()->unpinPage(*this, pageNum, dirty, latch) == -1) {
+        return -1;
+    }
+    if (dirty) {
+        writePageCounter++;
+    }
+    return 0;
+}
+
+
+RC FileHandle::unpinLoggedPage(PageNum pageNum, const void *page, const void *before, LatchMode latch)
+{
+    if (log == NULL) {
+        return unpinPage(pageNum, true, latch);
+    }
+    uint64_t lsn = 0;
+    if (log->logPage(pageNum, before, page, lsn) == -1) {
+        // an image that is not in the log must not reach the file, so the
+        // frame goes back to what it was and is released clean
+        if (before != NULL) {
+            memcpy((char *) page, (char *) before, PAGE_SIZE);
+        }
+        BufferPoolManager::instance()->unpinPage(*this, pageNum, false, latch);
+        return -1;
+    }
+    if (BufferPoolManager::instance()->unpinPage(*this, pageNum, true, latch, lsn) == -1) {
+        return -1;
+    }
+    writePageCounter++;
     return 0;
 }
+
+
+RC FileHandle::readPageFromDisk(PageNum pageNum, void *data, bool verify)
+{
+    if (pageMap != NULL) {
+        if (readCompressedPage(pageNum, data) == -1) {
+            return -1;
+        }
+    } else if (readBlock(pageOffset(pageNum), data) == -1) {
+        return -1;
+    }
+    return verify ? verifyPage(pageNum, data) : 0;
+}
+
+
+RC FileHandle::writePageToDisk(PageNum pageNum, const void *data)
+{
+    if (pageMap != NULL) {
+        return writeCompressedPage(pageNum, data);
+    }
+    if (!hasChecksums()) {
+        return writeBlock(pageOffset(pageNum), data);
+    }
+    // the caller's page is left alone, the checksum goes on a copy
+    char page[PAGE_SIZE] __attribute__((aligned(PAGE_ALIGNMENT)));
+    memcpy(page, (char *) data, PAGE_SIZE);
+    stampPage(pageNum, page);
+    return writeBlock(pageOffset(pageNum), page);
+}
+
+
+void FileHandle::stampPage(PageNum pageNum, void *page)
+{
+    if (!hasChecksums()) {
+        return;
+    }
+    // seeding with the page number also catches a page written to the wrong place
+    uint32_t checksum = crc32c(pageNum, page, PAGE_DATA_SIZE);
+    memcpy((char *) page + PAGE_DATA_SIZE, &checksum, PAGE_CHECKSUM_SIZE);
+}
+
+
+RC FileHandle::verifyPage(PageNum pageNum, const void *page)
+{
+    if (!hasChecksums()) {
+        return 0;
+    }
+    uint32_t checksum;
+    memcpy(&checksum, (char *) page + PAGE_DATA_SIZE, PAGE_CHECKSUM_SIZE);
+    if (checksum != crc32c(pageNum, page, PAGE_DATA_SIZE)) {
+        corruptPage = pageNum;
+        return -1;
+    }
+    return 0;
+}
+
+
+RC FileHandle::verifyMappedPage(PageNum pageNum)
+{
+    if (!hasChecksums()) {
+        return 0;
+    }
+    // a page handed out in place never passes through readPageFromDisk, so
+    // it is checked here once. Only this handle writes the mapping afterwards
+    // and it stamps every page it writes
+    lock_guard<mutex> guard(verifiedLock);
+    if (pageNum < verifiedPages.size() && verifiedPages[pageNum]) {
+        return 0;
+    }
+    if (verifyPage(pageNum, mapping + pageOffset(pageNum)) == -1) {
+        return -1;
+    }
+    if (pageNum >= verifiedPages.size()) {
+        verifiedPages.resize(pageNum + 1, false);
+    }
+    verifiedPages[pageNum] = true;
+    return 0;
+}
+
+
+RC FileHandle::readBlock(off_t offset, void *data, size_t length)
+{
+    if (fd != -1) {
+        // O_DIRECT cannot read into an unaligned buffer, stage it instead. The
+        // staging page is the call's own, other threads transfer on the handle too
+        if (ioMode == IO_DIRECT && (uintptr_t) data % PAGE_ALIGNMENT != 0) {
+            void *staged;
+            if (posix_memalign(&staged, PAGE_ALIGNMENT, length) != 0) {
+                return -1;
+            }
+            RC rc = readBlock(offset, staged, length);
+            if (rc == 0) {
+                memcpy((char *) data, (char *) staged, length);
+            }
+            free(staged);
+            return rc;
+        }
+
+        // positional reads leave no shared file offset behind
+        uint64_t start = ioClock();
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pread(fd, (char *) data + done, length - done, offset + done);
+            if (n <= 0) {
+                return -1;
+            }
+            done += n;
+        }
+        ioStats->record(IO_OP_READ, offset, length, ioClock() - start);
+        return 0;
+    } else if (infile != NULL && infile->is_open()) {
+        lock_guard<mutex> guard(streamLock);
+        uint64_t start = ioClock();
+        infile->clear();
+        infile->seekg(offset, ios::beg);
+        infile->read(((char *) data), length);
+        if (infile->gcount() != (streamsize) length) {
+            return -1;
+        }
+        ioStats->record(IO_OP_READ, offset, length, ioClock() - start);
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+
+RC FileHandle::writeBlock(off_t offset, const void *data, size_t length)
+{
+    if (fd != -1) {
+        if (ioMode == IO_DIRECT && (uintptr_t) data % PAGE_ALIGNMENT != 0) {
+            void *staged;
+            if (posix_memalign(&staged, PAGE_ALIGNMENT, length) != 0) {
+                return -1;
+            }
+            memcpy((char *) staged, (char *) data, length);
+            RC rc = writeBlock(offset, staged, length);
+            free(staged);
+            return rc;
+        }
+
+        uint64_t start = ioClock();
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pwrite(fd, (char *) data + done, length - done, offset + done);
+            if (n <= 0) {
+                return -1;
+            }
+            done += n;
+        }
+        ioStats->record(IO_OP_WRITE, offset, length, ioClock() - start);
+        return 0;
+    } else if (outfile != NULL && outfile->is_open()) {
+        lock_guard<mutex> guard(streamLock);
+        uint64_t start = ioClock();
+        outfile->seekp(offset, ios::beg);
+        outfile->write(((char *) data), length);
+        // the pool may read the page back through infile at any time
+        outfile->flush();
+        ioStats->record(IO_OP_WRITE, offset, length, ioClock() - start);
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+
+RC FileHandle::submitRead(PageNum pageNum, void *data)
+{
+    vector<PageNum> pageNums(1, pageNum);
+    vector<void *> buffers(1, data);
+    return submitReadBatch(pageNums, buffers);
+}
+
+
+RC FileHandle::submitReadBatch(const vector<PageNum> &pageNums, const vector<void *> &data)
+{
+    lock_guard<recursive_mutex> guard(ioLock);
+    if (pageNums.size() != data.size() || getAsyncIO() == NULL) {
+        return -1;
+    }
+    for (unsigned i = 0; i < pageNums.size(); i++) {
+        if (pageNums[i] >= numPages) {
+            return -1;
+        }
+    }
+
+    // a batch bigger than the queue goes out in queue sized submissions
+    unsigned submitted = 0;
+    while (submitted < pageNums.size()) {
+        if (asyncIO->getFreeSlots() == 0 && reapReads(true) == -1) {
+            return -1;
+        }
+        unsigned count = min((unsigned) pageNums.size() - submitted, asyncIO->getFreeSlots());
+        if (asyncIO->submit(&pageNums[submitted], &data[submitted], count) == -1) {
+            return -1;
+        }
+        submitted += count;
+        readsInFlight += count;
+        readPageCounter += count;
+    }
+    return 0;
+}
+
+
+RC FileHandle::pollReads(vector<pair<PageNum, RC> > &completed, bool wait)
+{
+    lock_guard<recursive_mutex> guard(ioLock);
+    if (asyncIO == NULL) {
+        return 0;
+    }
+    if (readyReads.empty() && reapReads(false) == -1) {
+        return -1;
+    }
+    while (wait && readyReads.empty() && readsInFlight > 0) {
+        if (reapReads(true) == -1) {
+            return -1;
+        }
+    }
+    readsInFlight -= readyReads.size();
+    completed.insert(completed.end(), readyReads.begin(), readyReads.end());
+    readyReads.clear();
+    return 0;
+}
+
+
+RC FileHandle::prefetchPages(PageNum pageNum, unsigned count)
+{
+    if (pageNum >= numPages) {
+        return 0;
+    }
+    count = min(count, numPages - pageNum);
+
+    if (mapping != NULL) {
+        // let the kernel fault the range in ahead of us
+        return madvise(mapping + pageOffset(pageNum), (size_t) count * PAGE_SIZE, MADV_WILLNEED);
+    }
+    lock_guard<recursive_mutex> guard(ioLock);
+    return BufferPoolManager::instance()->prefetchPages(*this, pageNum, count);
+}
+
+
+void FileHandle::noteRead(PageNum pageNum)
+{
+    PageNum from;
+    unsigned count;
+    {
+        // threads sharing the handle do not wait for each other over a hint
+        unique_lock<mutex> guard(readAheadLock, try_to_lock);
+        if (!guard.owns_lock() || readAheadPages == 0 || pageNum == lastReadPage) {
+            return;
+        }
+        // skipping a page, like a map page a scan steps over, still counts as sequential
+        bool sequential = lastReadPage != NO_PAGE && pageNum > lastReadPage && pageNum - lastReadPage <= 2;
+        lastReadPage = pageNum;
+        if (!sequential) {
+            readAheadWindow = 0;
+            return;
+        }
+
+        // start small after the jump, then double the window each time the
+        // reader gets halfway through the pages already asked for
+        if (readAheadWindow == 0 || readAheadEnd <= pageNum) {
+            readAheadWindow = min(READ_AHEAD_MIN_PAGES, readAheadPages);
+            from = pageNum + 1;
+        } else if (pageNum + readAheadWindow / 2 >= readAheadEnd) {
+            readAheadWindow = min(readAheadWindow * 2, readAheadPages);
+            from = readAheadEnd;
+        } else {
+            return;
+        }
+        count = readAheadWindow;
+        readAheadEnd = from + count;
+    }
+    // the pool skips what it already has, streams cannot read ahead at all
+    prefetchPages(from, count);
+}
+
+
+AsyncIO* FileHandle::getAsyncIO()
+{
+    lock_guard<recursive_mutex> guard(ioLock);
+    // streams have no descriptor to read from, and compressed pages are not
+    // where the engine would look for them
+    if (asyncIO == NULL && fd != -1 && pageMap == NULL) {
+        asyncIO = AsyncIO::create(fd);
+    }
+    return asyncIO;
+}
+
+
+RC FileHandle::reapReads(bool wait)
+{
+    lock_guard<recursive_mutex> guard(ioLock);
+    if (asyncIO == NULL) {
+        return 0;
+    }
+    vector<AIOCompletion> completed;
+    if (asyncIO->poll(completed, wait) == -1) {
+        return -1;
+    }
+
+    // the engine is shared by the pool and by submitRead callers
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    for (auto it = completed.begin(); it != completed.end(); ++it) {
+        if (it->rc == 0) {
+            ioStats->record(IO_OP_ASYNC_READ, pageOffset(it->pageNum), (size_t) it->count * PAGE_SIZE, it->nanos);
+        }
+        if (bpm->isFrame(it->data)) {
+            bpm->completeLoad(*this, it->pageNum, it->count, it->rc);
+        } else {
+            // submitRead reads a page at a time
+            readyReads.push_back(make_pair(it->pageNum, it->rc == 0 ? verifyPage(it->pageNum, it->data) : it->rc));
+        }
+    }
+    return 0;
+}
+
+
+RC FileHandle::closeAsyncIO()
+{
+    lock_guard<recursive_mutex> guard(ioLock);
+    if (asyncIO == NULL) {
+        return 0;
+    }
+    RC rc = 0;
+    while (asyncIO->getInFlight() > 0) {
+        if (reapReads(true) == -1) {
+            rc = -1;
+            break;
+        }
+    }
+    delete asyncIO;
+    asyncIO = NULL;
+    readyReads.clear();
+    readsInFlight = 0;
+    return rc;
+}
+
+
+unsigned FileHandle::getNumberOfPages()
+{
+    return numPages;
+}
+
+
+RC FileHandle::readPagesFromDisk(PageNum pageNum, unsigned count, void * const *data)
+{
+    // O_DIRECT needs every buffer aligned, streams have no descriptor and
+    // compressed pages are not next to each other, all fall back to one page at a time
+    bool vectored = fd != -1 && pageMap == NULL;
+    for (unsigned i = 0; vectored && ioMode == IO_DIRECT && i < count; i++) {
+        vectored = (uintptr_t) data[i] % PAGE_ALIGNMENT == 0;
+    }
+    if (!vectored) {
+        for (unsigned i = 0; i < count; i++) {
+            if (readPageFromDisk(pageNum + i, data[i]) == -1) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    uint64_t start = ioClock();
+    if (readPagesAt(fd, pageNum, count, data) == -1) {
+        return -1;
+    }
+    ioStats->record(IO_OP_READ, pageOffset(pageNum), (size_t) count * PAGE_SIZE, ioClock() - start);
+    for (unsigned i = 0; i < count; i++) {
+        if (verifyPage(pageNum + i, data[i]) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+RC FileHandle::writePagesToDisk(PageNum pageNum, unsigned count, const void * const *data)
+{
+    bool vectored = fd != -1 && pageMap == NULL;
+    for (unsigned i = 0; vectored && ioMode == IO_DIRECT && i < count; i++) {
+        vectored = (uintptr_t) data[i] % PAGE_ALIGNMENT == 0;
+    }
+    if (!vectored) {
+        for (unsigned i = 0; i < count; i++) {
+            if (writePageToDisk(pageNum + i, data[i]) == -1) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if (!hasChecksums()) {
+        return timedWritePages(pageNum, count, data);
+    }
+
+    // the run is copied so the checksums can go on the pages
+    char *copy;
+    if (posix_memalign((void **) &copy, PAGE_ALIGNMENT, (size_t) count * PAGE_SIZE) != 0) {
+        return -1;
+    }
+    vector<const void *> pages(count);
+    for (unsigned i = 0; i < count; i++) {
+        pages[i] = copy + (size_t) i * PAGE_SIZE;
+        memcpy(copy + (size_t) i * PAGE_SIZE, (char *) data[i], PAGE_SIZE);
+        stampPage(pageNum + i, copy + (size_t) i * PAGE_SIZE);
+    }
+    RC rc = timedWritePages(pageNum, count, &pages[0]);
+    free(copy);
+    return rc;
+}
+
+
+RC FileHandle::timedWritePages(PageNum pageNum, unsigned count, const void * const *data)
+{
+    uint64_t start = ioClock();
+    if (writePagesAt(fd, pageNum, count, data) == -1) {
+        return -1;
+    }
+    ioStats->record(IO_OP_WRITE, pageOffset(pageNum), (size_t) count * PAGE_SIZE, ioClock() - start);
+    return 0;
+}
+
+
+RC FileHandle::flush()
+{
+    if (!isOpen()) {
+        return -1;
+    }
+    // a logged file is checkpointed, its log only keeps what comes after
+    if (log != NULL) {
+        return checkpoint();
+    }
+    // unlike closeFile the handle stays the owner of the frames it dirties later
+    if (BufferPoolManager::instance()->flushFile(*this, false) == -1) {
+        return -1;
+    }
+    return writeHeader();
+}
+
+
+RC FileHandle::checkpoint()
+{
+    if (!isOpen()) {
+        return -1;
+    }
+    pthread_rwlock_wrlock(&fileLatch);
+    RC rc;
+    {
+        lock_guard<mutex> guard(appendLock);
+        rc = checkpointLocked();
+    }
+    pthread_rwlock_unlock(&fileLatch);
+    return rc;
+}
+
+
+RC FileHandle::checkpointLocked()
+{
+    // record writers hold the file latch and appends the append lock, so every
+    // record logged so far has its frame marked dirty by now. Writers on other
+    // handles of the file cannot be held off, their log is emptied when the
+    // last of them closes
+    bool alone = log != NULL && !LogManager::instance()->isShared(log);
+    uint64_t lsn = alone ? log->getEndLSN() : 0;
+    if (BufferPoolManager::instance()->flushFile(*this, false) == -1 || writeHeader() == -1) {
+        return -1;
+    }
+    if (!alone) {
+        return 0;
+    }
+    // the log may only let go of the records once their pages are on stable storage
+    if (syncFile() == -1) {
+        return -1;
+    }
+    return LogManager::instance()->truncateLog(log, lsn);
+}
+
+
+RC FileHandle::sync()
+{
+    if (flush() == -1) {
+        return -1;
+    }
+    return syncFile();
+}
+
+
+RC FileHandle::syncFile()
+{
+    if (fd == -1) {
+        // streams have no descriptor to sync, handing the buffer to the kernel is all they can do
+        lock_guard<mutex> guard(streamLock);
+        outfile->flush();
+        return outfile->good() ? 0 : -1;
+    }
+    // pages written through an IO_MMAP mapping are in the page cache too
+    uint64_t start = ioClock();
+    if (fdatasync(fd) == -1) {
+        return -1;
+    }
+    ioStats->record(IO_OP_SYNC, -1, 0, ioClock() - start);
+    return 0;
+}
+
+
+RC FileHandle::commit()
+{
+    if (log == NULL) {
+        return sync();
+    }
+    // the pages stay in the pool, the log alone makes the changes durable
+    if (log->force(log->getEndLSN()) == -1) {
+        return -1;
+    }
+    // a long log is checkpointed so recovery does not replay all of its
+    // history. One that cannot finish now, with a page being changed, is
+    // left to a later commit
+    if (log->getSize() >= LOG_CHECKPOINT_SIZE) {
+        checkpoint();
+    }
+    return 0;
+}
+
+
+RC FileHandle::openLog(const string &fileName)
+{
+    if ((header.flags & FILE_LOGGED) == 0) {
+        return 0;
+    }
+    bool first;
+    if (LogManager::instance()->openLog(fileName, log, first) == -1) {
+        return -1;
+    }
+
+    // nobody has the file open, so whatever is in the log was left by a
+    // handle that never closed and its pages may lack some of it
+    if (first && !log->isEmpty()) {
+        unsigned pages = numPages;
+        if (log->replay(*this, pages) == -1 || syncFile() == -1) {
+            closeLog(false);
+            return -1;
+        }
+        numPages = pages;
+        if (writeHeader() == -1 || syncFile() == -1 || log->truncate(log->getEndLSN()) == -1) {
+            closeLog(false);
+            return -1;
+        }
+        // pages cached from before the crash are older than the replayed ones
+        BufferPoolManager::instance()->discardFile(fileName);
+    }
+
+    // nothing keeps the kernel from writing a mapped page ahead of its log
+    if (ioMode == IO_MMAP) {
+        return closeLog(true);
+    }
+    return 0;
+}
+
+
+RC FileHandle::closeLog(bool flushed)
+{
+    if (log == NULL) {
+        return 0;
+    }
+    // the log may only be emptied once the pages it describes are on stable
+    // storage. Without records since the last checkpoint there is nothing to
+    // empty and the checkpoint synced the pages already
+    if (flushed && !log->isEmpty() && syncFile() == -1) {
+        flushed = false;
+    }
+    RC rc = LogManager::instance()->closeLog(log, flushed);
+    log = NULL;
+    return rc;
+}
+
+
+RC FileHandle::forceLog(uint64_t lsn)
+{
+    if (log == NULL) {
+        return 0;
+    }
+    return log->force(lsn);
+}
+
+
+RC FileHandle::collectLogCounterValues(unsigned &recordCount, unsigned &syncCount)
+{
+    if (log == NULL) {
+        return -1;
+    }
+    return log->collectCounterValues(recordCount, syncCount);
+}
+
+
+RC FileHandle::collectCompressionCounterValues(uint64_t &rawBytes, uint64_t &storedBytes, uint64_t &decodedBytes, uint64_t &decodeNanos)
+{
+    if (pageMap == NULL) {
+        return -1;
+    }
+    rawBytes = rawByteCounter;
+    storedBytes = storedByteCounter;
+    decodedBytes = decodedByteCounter;
+    decodeNanos = decodeNanoCounter;
+    return 0;
+}
+
+
+RC FileHandle::openPageMap(const string &fileName)
+{
+    if (!isCompressed()) {
+        return 0;
+    }
+    return PageMapManager::instance()->openMap(fileName, *this, pageMap);
+}
+
+
+RC FileHandle::closePageMap()
+{
+    if (pageMap == NULL) {
+        return 0;
+    }
+    RC rc = PageMapManager::instance()->closeMap(pageMap);
+    pageMap = NULL;
+    return rc;
+}
+
+
+RC FileHandle::readCompressedPage(PageNum pageNum, void *data)
+{
+    PageMapEntry entry;
+    pageMap->lookup(pageNum, entry);
+    if (entry.length == 0) {
+        // reserved but never written, the same zeros a plain file has there
+        memset(data, 0, PAGE_SIZE);
+        return 0;
+    }
+    if (entry.length == PAGE_SIZE) {
+        return readBlock(unitOffset(entry.unit), data);
+    }
+
+    char packed[PAGE_SIZE];
+    if (readBlock(unitOffset(entry.unit), packed, entry.length) == -1) {
+        return -1;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int length = lz4Decompress(packed, entry.length, data, PAGE_SIZE);
+    decodeNanoCounter += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    if (length != PAGE_SIZE) {
+        // only a damaged image fails to decompress
+        corruptPage = pageNum;
+        return -1;
+    }
+    decodedByteCounter += PAGE_SIZE;
+    return 0;
+}
+
+
+RC FileHandle::writeCompressedPage(PageNum pageNum, const void *data)
+{
+    // the checksum covers the page the way the layers above see it
+    char page[PAGE_SIZE];
+    memcpy(page, (char *) data, PAGE_SIZE);
+    stampPage(pageNum, page);
+
+    // an image that does not save a unit is stored as is
+    char packed[PAGE_SIZE];
+    const char *image = packed;
+    int length = lz4Compress(page, PAGE_SIZE, packed, PAGE_SIZE - COMPRESS_UNIT);
+    if (length == 0) {
+        image = page;
+        length = PAGE_SIZE;
+    }
+    PageMapEntry entry;
+    if (pageMap->place(pageNum, length, entry) == -1 || writeBlock(unitOffset(entry.unit), image, length) == -1) {
+        return -1;
+    }
+    rawByteCounter += PAGE_SIZE;
+    storedByteCounter += length;
+    return 0;
+}
+
+
+RC FileHandle::setExtentPages(unsigned pages)
+{
+    if (pages == 0 || pages > MAX_EXTENT_PAGES) {
+        return -1;
+    }
+    extentPages = pages;
+    return 0;
+}
+
+
+RC FileHandle::setReadAheadPages(unsigned pages)
+{
+    if (pages > MAX_READ_AHEAD_PAGES) {
+        return -1;
+    }
+    lock_guard<mutex> guard(readAheadLock);
+    readAheadPages = pages;
+    readAheadWindow = 0;
+    return 0;
+}
+
+
+RC FileHandle::reservePages(unsigned pages)
+{
+    if (pages <= allocatedPages) {
+        return 0;
+    }
+    // streams grow the file themselves, one page per write, and compressed
+    // pages go wherever the page map finds room
+    if (fd == -1 || pageMap != NULL) {
+        allocatedPages = pages;
+        return 0;
+    }
+
+    // one extent of real blocks instead of a metadata update for every page
+    unsigned target = max(pages, allocatedPages + extentPages);
+    off_t offset = pageOffset(allocatedPages);
+    off_t length = pageOffset(target) - offset;
+    if (fallocate(fd, 0, offset, length) == -1) {
+        // file systems without fallocate still get the file length
+        if (errno != EOPNOTSUPP || ftruncate(fd, offset + length) == -1) {
+            return -1;
+        }
+    }
+    allocatedPages = target;
+    return 0;
+}
+
+
+bool FileHandle::isOpen()
+{
+    return fd != -1 || infile != NULL;
+}
+
+
+RC FileHandle::growMapping(unsigned pages)
+{
+    // the mapping starts at the header so page offsets are the same as in the file
+    size_t needed = pageOffset(pages);
+    if (needed <= mappedSize) {
+        return 0;
+    }
+
+    // over-allocate so appends only remap now and then, the tail past the end
+    // of the file is never touched
+    size_t size = mappedSize == 0 ? (size_t) MMAP_MIN_PAGES * PAGE_SIZE : mappedSize;
+    while (size < needed) {
+        size *= 2;
+    }
+    void *newMapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (newMapping == MAP_FAILED) {
+        return -1;
+    }
+
+    // callers may still hold pointers into the old mapping, so keep it until close
+    if (mapping != NULL) {
+        retiredMappings.push_back(make_pair((void *) mapping, mappedSize));
+    }
+    mapping = (char *) newMapping;
+    mappedSize = size;
+    return 0;
+}
+
+
+void FileHandle::latchMapping(LatchMode latch)
+{
+    if (latch == LATCH_SHARED) {
+        pthread_rwlock_rdlock(&mappingLatch);
+    } else if (latch == LATCH_EXCLUSIVE) {
+        pthread_rwlock_wrlock(&mappingLatch);
+    }
+}
+
+
+void FileHandle::unlatchMapping(LatchMode latch)
+{
+    if (latch != LATCH_NONE) {
+        pthread_rwlock_unlock(&mappingLatch);
+    }
+}
+
+
+void FileHandle::unmapFile()
+{
+    for (auto it = retiredMappings.begin(); it != retiredMappings.end(); ++it) {
+        munmap(it->first, it->second);
+    }
+    retiredMappings.clear();
+    verifiedPages.clear();
+    if (mapping != NULL) {
+        munmap(mapping, mappedSize);
+        mapping = NULL;
+        mappedSize = 0;
+    }
+}
+
+
+RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+{
+    readPageCount = readPageCounter;
+    writePageCount = writePageCounter;
+    appendPageCount = appendPageCounter;
+    return 0;
+}
+
+
+RC FileHandle::collectBufferCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictCount)
+{
+    hitCount = hitPageCounter;
+    missCount = missPageCounter;
+    evictCount = evictPageCounter;
+    return 0;
+}
+
+
+
+RC FileHandle::collectTotalCounterValues(uint64_t &readPageCount, uint64_t &writePageCount, uint64_t &appendPageCount)
+{
+    readPageCount = header.readPageCount + readPageCounter - savedReadCount;
+    writePageCount = header.writePageCount + writePageCounter - savedWriteCount;
+    appendPageCount = header.appendPageCount + appendPageCounter - savedAppendCount;
+    return 0;
+}
+
+
+RC FileHandle::readHeader()
+{
+    // aligned so IO_DIRECT reads it without staging
+    void *page;
+    if (posix_memalign(&page, PAGE_ALIGNMENT, PAGE_SIZE) != 0) {
+        initHeader(header);
+        return -1;
+    }
+    RC rc = readBlock(0, page);
+    memcpy(&header, page, sizeof(FileHeader));
+    free(page);
+    // a file made with another page size cannot be read a page at a time
+    if (rc == -1 || header.magic != FILE_MAGIC || header.version != FILE_FORMAT_VERSION || header.pageSize != PAGE_SIZE) {
+        initHeader(header);
+        return -1;
+    }
+    numPages = header.numPages;
+    openFsmRoot = header.fsmRoot;
+    openIndexRoot = header.indexRoot;
+    openFreeListHead = header.freeListHead;
+    openFreePageCount = header.freePageCount;
+    savedReadCount = readPageCounter;
+    savedWriteCount = writePageCounter;
+    savedAppendCount = appendPageCounter;
+    return 0;
+}
+
+
+RC FileHandle::writeHeader()
+{
+    lock_guard<mutex> guard(headerLock);
+    // other handles on the same file may have saved the header since we read it,
+    // so merge into the one on disk instead of overwriting it
+    void *page;
+    if (posix_memalign(&page, PAGE_ALIGNMENT, PAGE_SIZE) != 0) {
+        return -1;
+    }
+    if (readBlock(0, page) == -1) {
+        free(page);
+        return -1;
+    }
+    FileHeader saved;
+    memcpy(&saved, page, sizeof(FileHeader));
+    if (saved.magic == FILE_MAGIC) {
+        header.numPages = truncated ? numPages.load() : max(saved.numPages, numPages.load());
+        header.readPageCount = saved.readPageCount;
+        header.writePageCount = saved.writePageCount;
+        header.appendPageCount = saved.appendPageCount;
+        // a root only replaces the saved one if this handle moved it
+        if (header.fsmRoot == openFsmRoot) {
+            header.fsmRoot = saved.fsmRoot;
+        }
+        if (header.indexRoot == openIndexRoot) {
+            header.indexRoot = saved.indexRoot;
+        }
+        if (header.freeListHead == openFreeListHead && header.freePageCount == openFreePageCount) {
+            header.freeListHead = saved.freeListHead;
+            header.freePageCount = saved.freePageCount;
+        }
+    } else {
+        header.numPages = numPages;
+    }
+    header.readPageCount += readPageCounter - savedReadCount;
+    header.writePageCount += writePageCounter - savedWriteCount;
+    header.appendPageCount += appendPageCounter - savedAppendCount;
+
+    // the page map goes out first, then the header that points at it. Handles
+    // sharing the map take turns so the last header written has the last map
+    unique_lock<mutex> mapGuard;
+    if (pageMap != NULL) {
+        mapGuard = unique_lock<mutex>(pageMap->saveLock);
+        if (pageMap->save(*this, header) == -1) {
+            pageMap->endSave(false);
+            free(page);
+            return -1;
+        }
+    }
+
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, &header, sizeof(FileHeader));
+    RC rc = writeBlock(0, page);
+    free(page);
+    if (pageMap != NULL) {
+        pageMap->endSave(rc == 0);
+    }
+    if (rc == -1) {
+        return -1;
+    }
+    openFsmRoot = header.fsmRoot;
+    openIndexRoot = header.indexRoot;
+    openFreeListHead = header.freeListHead;
+    openFreePageCount = header.freePageCount;
+    truncated = false;
+    savedReadCount = readPageCounter;
+    savedWriteCount = writePageCounter;
+    savedAppendCount = appendPageCounter;
+    return 0;
+}
+
+
+bool FileHandle::isFreePage(PageNum pageNum, PageNum &next)
+{
+    void *page;
+    if (pageNum >= numPages || pinPage(pageNum, page, LATCH_SHARED) == -1) {
+        return false;
+    }
+    FreePageMarker marker;
+    memcpy(&marker, page, sizeof(FreePageMarker));
+    unpinPage(pageNum, false, LATCH_SHARED);
+    next = marker.next;
+    return marker.magic == FREE_PAGE_MAGIC && marker.pageNum == pageNum;
+}
+
+
+RC FileHandle::writeFreePage(PageNum pageNum, PageNum next)
+{
+    void *page = malloc(PAGE_SIZE);
+    if (readPage(pageNum, page) == -1) {
+        free(page);
+        return -1;
+    }
+    FreePageMarker marker;
+    marker.magic = FREE_PAGE_MAGIC;
+    marker.pageNum = pageNum;
+    marker.next = next;
+    memcpy(page, &marker, sizeof(FreePageMarker));
+    RC rc = writePage(pageNum, page);
+    free(page);
+    return rc;
+}
+
+
+void FileHandle::closeStreams()
+{
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    } else if (infile != NULL) {
+        infile->close();
+        outfile->close();
+        delete infile;
+        delete outfile;
+        infile = NULL;
+        outfile = NULL;
+    }
+    IOStatsManager::instance()->closeStats(ioStats);
+    ioStats = NULL;
+}
\ No newline at end of file
@@ -5,7 +5,11 @@ typedef int RC;
 typedef char byte;
 typedef unsigned PageNum;
 
+// Bytes in a page, chosen when building (4, 8, 16, 32 or 64 KB) and saved in
+// the header of every file, see makefile.inc
+#ifndef PAGE_SIZE
 #define PAGE_SIZE 4096
+#endif
 #include <iostream>
 #include <cstdlib>
 #include <string>
@@ -13,25 +17,113 @@ typedef unsigned PageNum;
 #include <fstream>
 #include <cstdio>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <stdint.h>
 #include <utility>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <cstring>
+#include <atomic>
+#include <mutex>
+#include <pthread.h>
 
 using namespace std;
 
 class FileHandle;
+class AsyncIO;
+class WriteAheadLog;
+class PageMap;
+class IOStats;
+
+// I/O backends a FileHandle can be opened with
+typedef enum { IO_PREAD = 0,    // one descriptor, positional pread/pwrite (default)
+               IO_STREAM,       // separate ifstream/ofstream pair
+               IO_MMAP,         // shared mapping of the file, pages are used in place
+               IO_DIRECT        // O_DIRECT descriptor, the buffer pool is the only cache
+} IOMode;
+
+// Latch taken on a pinned page, many readers or one writer
+typedef enum { LATCH_NONE = 0,  // pin only, the caller keeps other threads away itself
+               LATCH_SHARED,    // read the page
+               LATCH_EXCLUSIVE  // modify the page
+} LatchMode;
 
 // Typedefs for record data sizes
 typedef short f_data;   // field data size
+typedef unsigned short f_offset;   // field offset inside a record, a record may fill a 64 KB page
 typedef int m_data;     // meta data size, include slots and stuff
 
+static_assert(PAGE_SIZE >= 4096 && PAGE_SIZE <= 65536 && (PAGE_SIZE & (PAGE_SIZE - 1)) == 0,
+              "PAGE_SIZE must be a power of two from 4 KB to 64 KB");
+
+
+// Files created with FILE_CHECKSUM end every page with a CRC32C of the rest
+// of it, the record and index layers only use the PAGE_DATA_SIZE bytes before it
+const int PAGE_CHECKSUM_SIZE = sizeof(uint32_t);
+const int PAGE_DATA_SIZE = PAGE_SIZE - PAGE_CHECKSUM_SIZE;
 
 // Constants
-const int F_OFFSET = PAGE_SIZE - sizeof(m_data);
-const int N_OFFSET = PAGE_SIZE - (2 * sizeof(m_data));
+const int F_OFFSET = PAGE_DATA_SIZE - sizeof(m_data);
+const int N_OFFSET = PAGE_DATA_SIZE - (2 * sizeof(m_data));
+const int S_OFFSET = PAGE_DATA_SIZE - (3 * sizeof(m_data));    // slots in the directory, live or not
+const int C_OFFSET = PAGE_DATA_SIZE - (4 * sizeof(m_data));    // first free slot + 1, 0 when there is none
 const int SLOT_SIZE  = 2 * sizeof(m_data);
-const int META_INFO = 2 * sizeof(m_data);
+const int META_INFO = 4 * sizeof(m_data);
 const int FIELD_OFFSET = sizeof(f_data);
+const unsigned MMAP_MIN_PAGES = 64;     // smallest mapping, it doubles as the file grows
+const unsigned PAGE_ALIGNMENT = 4096;   // buffer alignment required by IO_DIRECT
+const PageNum NO_PAGE = UINT_MAX;       // unset page reference in the file header
+const unsigned DEFAULT_EXTENT_PAGES = 256;  // appends grow the file 1 MB at a time
+const unsigned MAX_EXTENT_PAGES = 16384;    // largest growth step (64 MB)
+const unsigned READ_AHEAD_MIN_PAGES = 8;    // first read ahead once reads turn sequential, it doubles from there
+const unsigned DEFAULT_READ_AHEAD_PAGES = 64;   // largest read ahead window
+const unsigned MAX_READ_AHEAD_PAGES = 256;
+
+// Every file starts with a header page that is not counted as a page of the
+// file, page n of a FileHandle lives at physical page n + HEADER_PAGES
+const unsigned HEADER_PAGES = 1;
+const unsigned FILE_MAGIC = 0x31464252; // "RBF1"
+const unsigned FILE_FORMAT_VERSION = 3;
+const unsigned FILE_LOGGED = 1;         // changes to the pages go through a write ahead log
+const unsigned FILE_CHECKSUM = 2;       // pages carry a checksum, checked whenever one is read from disk
+const unsigned FILE_COMPRESSED = 4;     // pages are stored compressed and found through a page map, see pagemap.h
+
+inline off_t pageOffset(PageNum pageNum) { return (off_t) (pageNum + HEADER_PAGES) * PAGE_SIZE; }
+
+// Contents of the header page, written back when the file is closed
+typedef struct
+{
+    unsigned magic;
+    unsigned version;
+    unsigned numPages;
+    PageNum fsmRoot;             // first free space map page of a record based file
+    PageNum indexRoot;           // root node of an index file
+    uint64_t readPageCount;      // counters summed over every handle ever opened on the file
+    uint64_t writePageCount;
+    uint64_t appendPageCount;
+    unsigned flags;              // FILE_LOGGED, FILE_CHECKSUM, FILE_COMPRESSED
+    unsigned pageSize;           // PAGE_SIZE of the build that created the file
+    uint32_t pageMapUnit;        // run holding the page map of a FILE_COMPRESSED file
+    uint32_t pageMapLength;      // bytes in the map, 0 while no page has been written
+    uint32_t pageMapChecksum;    // CRC32C of the map
+    PageNum freeListHead;        // last page given back with freePage, NO_PAGE if there is none
+    unsigned freePageCount;      // pages in the free list
+} FileHeader;
+
+// A page given back with freePage starts with this, the rest of it is left
+// as the caller had it so reusePage can hand it back unchanged. The list
+// runs through the pages themselves, a page is only taken off it while its
+// marker still names it, since after a crash the header may be older than them
+const unsigned FREE_PAGE_MAGIC = 0x45455246; // "FREE"
+typedef struct
+{
+    unsigned magic;
+    PageNum pageNum;             // the page itself
+    PageNum next;                // page freed before it, NO_PAGE at the end of the list
+} FreePageMarker;
 
 
 class PagedFileManager
@@ -39,10 +131,13 @@ class PagedFileManager
 public:
     static PagedFileManager* instance();                     // Access to the _pf_manager instance
 
-    RC createFile    (const string &fileName);                         // Create a new file
+    RC createFile    (const string &fileName, unsigned flags = 0);     // Create a new file, FILE_LOGGED ones keep a redo log
     RC destroyFile   (const string &fileName);                         // Destroy a file
-    RC openFile      (const string &fileName, FileHandle &fileHandle); // Open a file
+    RC openFile      (const string &fileName, FileHandle &fileHandle, IOMode ioMode = IO_PREAD); // Open a file
     RC closeFile     (FileHandle &fileHandle);                         // Close a file
+    RC shareFile     (const string &fileName, FileHandle *&fileHandle, IOMode ioMode = IO_PREAD); // Open a file, or take another reference to its open handle
+    RC releaseFile   (FileHandle *fileHandle);                         // Drop a reference, the last one closes the file
+    RC closeSharedFiles();                                             // Close every shared file whatever its references, done at exit
 
 
 protected:
@@ -51,31 +146,183 @@ protected:
 
 private:
     static PagedFileManager *_pf_manager;
+
+    // Files opened with shareFile, every user of one gets the same handle. A
+    // destroyed file leaves the table by name but its handle stays valid
+    // until the references still out are released
+    typedef struct
+    {
+        string fileName;
+        unsigned users;
+        bool named;                                       // still found by its name
+    } SharedFile;
+    unordered_map<FileHandle *, SharedFile> sharedFiles;
+    unordered_map<string, FileHandle *> sharedNames;
+    mutex sharedLock;
+    bool closeAtExit;                                     // closeSharedFiles is registered with atexit
 };
 
 
+// A handle may be shared by several threads. Page reads and writes are
+// positional and latched, counters are atomic and appends are serialized.
+// currentPage and freeSpace belong to the layer above, which guards them.
 class FileHandle
 {
 public:
     // variables to keep counter for each operation
-	unsigned readPageCounter;
-	unsigned writePageCounter;
-	unsigned appendPageCounter;
-    unsigned numPages; 
+	atomic<unsigned> readPageCounter;
+	atomic<unsigned> writePageCounter;
+	atomic<unsigned> appendPageCounter;
+    // buffer pool counters for the pages of this handle
+    atomic<unsigned> hitPageCounter;
+    atomic<unsigned> missPageCounter;
+    atomic<unsigned> evictPageCounter;
+    // compression counters, bytes of the pages written before and after
+    // compressing them, and bytes decompressed with the time it took
+    atomic<uint64_t> rawByteCounter;
+    atomic<uint64_t> storedByteCounter;
+    atomic<uint64_t> decodedByteCounter;
+    atomic<uint64_t> decodeNanoCounter;
+    unsigned fileId;
+    atomic<unsigned> numPages; 
+    unsigned allocatedPages;                          // pages the file has room for, the first numPages are in use
+    unsigned extentPages;                             // pages reserved at a time when an append runs out of room
+    unsigned readAheadPages;                          // largest read ahead window, 0 turns read ahead off
+    unsigned readAheadWindow;                         // pages asked for by the last read ahead, 0 while reads are not sequential
+    PageNum lastReadPage;                             // page of the last readPage or pinPage
+    PageNum readAheadEnd;                             // first page past the last read ahead
     unsigned currentPageNum;
     void *currentPage;
     vector<unsigned int> freeSpace;
+    vector<unsigned int> freeSpaceTree;               // max of freeSpace over halves, quarters... of the pages, leaves at size() / 2
+    IOMode ioMode;
+    int fd;
     ifstream *infile;
     ofstream *outfile;
+    atomic<char *> mapping;
+    size_t mappedSize;
+    vector<pair<void *, size_t> > retiredMappings;   // outgrown mappings, pointers into them stay valid until close
+    vector<bool> verifiedPages;                       // mapped pages whose checksum was checked when first handed out
+    AsyncIO *asyncIO;                                 // asynchronous read engine, created on first use
+    WriteAheadLog *log;                               // redo log of a logged file, NULL otherwise and for IO_MMAP
+    PageMap *pageMap;                                 // where the pages of a compressed file are, NULL otherwise
+    IOStats *ioStats;                                 // latencies and bytes of the transfers on the file, see iostats.h
+    deque<pair<PageNum, RC> > readyReads;             // finished submitRead calls not yet handed out by pollReads
+    unsigned readsInFlight;                           // submitRead calls not yet handed out by pollReads
+    FileHeader header;                                // header page as last read or written by this handle
+    atomic<PageNum> corruptPage;                      // last page read from disk with a wrong checksum, NO_PAGE if none
+    PageNum openFsmRoot;                              // roots in the header when the file was opened
+    PageNum openIndexRoot;
+    PageNum openFreeListHead;                         // free list in the header when the file was opened
+    unsigned openFreePageCount;
+    bool truncated;                                   // numPages went down, the header must not keep the old count
+    unsigned savedReadCount;                          // part of the counters already added to the header
+    unsigned savedWriteCount;
+    unsigned savedAppendCount;
+    mutex appendLock;                                 // appends, the free list, the reserved space and the mapping size, taken before the pool's flushLock
+    mutex streamLock;                                 // IO_STREAM has a single file position
+    mutex headerLock;                                 // merging the header into the one on disk
+    mutex readAheadLock;                              // sequential read tracking, skipped by readers that find it taken
+    mutex verifiedLock;                               // verifiedPages
+    recursive_mutex ioLock;                           // asynchronous engine and its completions, taken before the pool's
+    pthread_rwlock_t mappingLatch;                    // IO_MMAP pages have no frames, one latch covers the mapping so hold one page at a time
+    pthread_rwlock_t fileLatch;                       // record level readers share it, writers hold it alone
 
     FileHandle();                                                    // Default constructor
     ~FileHandle();                                                   // Destructor
 
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
+    RC readPage(PageNum pageNum, const void *&page);                    // Point at a page inside the mapping (IO_MMAP only)
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    RC allocatePage(const void *data, PageNum &pageNum);                // Write a new page into a freed one, or append it
+    RC freePage(PageNum pageNum);                                       // Give a page back, allocatePage hands it out again
+    RC reusePage(PageNum &pageNum);                                     // Take the last page freed off the list as it is, its marker still in it
+    RC truncate();                                                      // Cut the free pages off the end of the file
+    RC readPages(PageNum pageNum, unsigned count, void *data);          // Get count consecutive pages into one buffer
+    RC writePages(PageNum pageNum, unsigned count, const void *data);   // Write count consecutive pages, appending past the end
+    RC pinPage(PageNum pageNum, void *&page, LatchMode latch = LATCH_NONE); // Pin a page in the buffer pool and get its frame
+    RC unpinPage(PageNum pageNum, bool dirty, LatchMode latch = LATCH_NONE); // Release a pinned page, dirty if it was modified
+    RC unpinLoggedPage(PageNum pageNum, const void *page, const void *before, LatchMode latch = LATCH_NONE); // Release a page modified since before was copied from it, logging the change, or put back before if it cannot be logged
+    RC submitRead(PageNum pageNum, void *data);                         // Queue an asynchronous read of a page
+    RC submitReadBatch(const vector<PageNum> &pageNums, const vector<void *> &data); // Queue many reads with one submission
+    RC pollReads(vector<pair<PageNum, RC> > &completed, bool wait);     // Collect finished reads, wait for at least one if asked
+    RC prefetchPages(PageNum pageNum, unsigned count);                  // Start loading pages into the buffer pool
+    RC flush();                                                         // Write back the dirty pages of the file and its header, checkpointing a logged file
+    RC checkpoint();                                                    // Flush, sync and empty the log of the records whose pages are now in the file
+    RC sync();                                                          // Flush and wait until the file is on stable storage
+    RC commit();                                                        // Make every change so far durable, through the log if the file has one
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
+    unsigned getFreePageCount() { return header.freePageCount; };      // Pages freed and not handed out again
+    RC setExtentPages(unsigned pages);                                  // Grow the file this many pages at a time (1 to MAX_EXTENT_PAGES)
+    RC setReadAheadPages(unsigned pages);                               // Largest read ahead window (up to MAX_READ_AHEAD_PAGES), 0 turns it off
+    bool isOpen();                                                      // Is the handle associated with a file
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // put the current counter values into variables
+    RC collectBufferCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictCount);         // put the buffer pool counter values into variables
+    RC collectTotalCounterValues(uint64_t &readPageCount, uint64_t &writePageCount, uint64_t &appendPageCount); // counters of every session on the file, this one included
+    RC collectLogCounterValues(unsigned &recordCount, unsigned &syncCount);   // records logged and log fsyncs of the file
+    RC collectCompressionCounterValues(uint64_t &rawBytes, uint64_t &storedBytes, uint64_t &decodedBytes, uint64_t &decodeNanos); // bytes written before and after compression, bytes and nanoseconds decompressed
+    IOStats* getIOStats() { return ioStats; };                         // Transfers timed on the file by every handle, NULL while closed
+    PageNum getCorruptPage() { return corruptPage; };                  // Last page that failed its checksum, NO_PAGE if none did
+    PageNum getFreeSpaceMapRoot() { return header.fsmRoot; };          // Root page kept in the header for the record based file manager
+    void setFreeSpaceMapRoot(PageNum pageNum) { header.fsmRoot = pageNum; };
+    PageNum getIndexRoot() { return header.indexRoot; };               // Root page kept in the header for the index manager
+    void setIndexRoot(PageNum pageNum) { header.indexRoot = pageNum; };
+
+    // used by the paged file manager to load and save the header page
+    RC readHeader();
+    RC writeHeader();
+
+    // used by the paged file manager to recover the file and to drop its log
+    RC openLog(const string &fileName);
+    RC closeLog(bool flushed);
+    RC forceLog(uint64_t lsn);                                          // used by the buffer pool before writing a logged frame
+    RC syncFile();                                                      // fdatasync the descriptor, streams can only be flushed
+
+    // used by the paged file manager to find the pages of a compressed file
+    RC openPageMap(const string &fileName);
+    RC closePageMap();
+    RC readCompressedPage(PageNum pageNum, void *data);                 // decompress the image of a page, unchecked
+    RC writeCompressedPage(PageNum pageNum, const void *data);          // compress a page into a new run
+
+    // used by the buffer pool to move pages between its frames and the file
+    RC readPageFromDisk(PageNum pageNum, void *data, bool verify = true);
+    RC writePageToDisk(PageNum pageNum, const void *data);
+    RC readPagesFromDisk(PageNum pageNum, unsigned count, void * const *data);
+    RC writePagesToDisk(PageNum pageNum, unsigned count, const void * const *data);
+    RC timedWritePages(PageNum pageNum, unsigned count, const void * const *data); // one pwritev per IOV_MAX pages, timed into ioStats
+    bool hasChecksums() { return header.flags & FILE_CHECKSUM; };
+    bool isCompressed() { return header.flags & FILE_COMPRESSED; };
+    void stampPage(PageNum pageNum, void *page);                        // put the checksum of a page in its last bytes
+    RC verifyPage(PageNum pageNum, const void *page);                   // -1 and corruptPage set if the checksum does not match
+    RC verifyMappedPage(PageNum pageNum);                               // verifyPage a mapped page the first time it is handed out
+    void latchMapping(LatchMode latch);
+    void unlatchMapping(LatchMode latch);
+    RC readBlock(off_t offset, void *data, size_t length = PAGE_SIZE);  // one transfer at a physical offset, never checked
+    RC writeBlock(off_t offset, const void *data, size_t length = PAGE_SIZE);
+
+    // used by the paged file manager to manage the IO_MMAP mapping
+    RC growMapping(unsigned pages);
+    void unmapFile();
+    void closeStreams();                                                // close the descriptor or the streams
+    RC reservePages(unsigned pages);                                    // make room in the file for the first pages pages
+
+    // used by allocatePage, freePage and truncate, under appendLock
+    RC appendPageLocked(const void *data);
+    bool isFreePage(PageNum pageNum, PageNum &next);                    // does the page carry its free page marker
+    RC writeFreePage(PageNum pageNum, PageNum next);
+    RC truncateLocked();
+
+    // used by checkpoint and truncate, under the file latch and appendLock
+    RC checkpointLocked();
+
+    // used by readPage and pinPage to prefetch ahead of sequential reads
+    void noteRead(PageNum pageNum);
+
+    // used by the buffer pool to load frames asynchronously
+    AsyncIO* getAsyncIO();
+    RC reapReads(bool wait);
+    RC closeAsyncIO();
 }; 
 
 #endif
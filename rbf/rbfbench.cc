@@ -0,0 +1,159 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+
+using namespace std;
+
+// Compares the buffered and the O_DIRECT backends on a file larger than the
+// buffer pool: a full sequential scan and uniformly random readRecord calls.
+// The file is loaded twice first, growing it a page and an extent at a time.
+//
+//   ./rbfbench [numRecords] [numReads]
+
+const int NAME_LENGTH = 1000;
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+void createDescriptor(vector<Attribute> &recordDescriptor)
+{
+    Attribute attr;
+    attr.name = "Id";
+    attr.type = TypeInt;
+    attr.length = (AttrLength)4;
+    recordDescriptor.push_back(attr);
+
+    attr.name = "Payload";
+    attr.type = TypeVarChar;
+    attr.length = (AttrLength)NAME_LENGTH;
+    recordDescriptor.push_back(attr);
+}
+
+
+void loadFile(RecordBasedFileManager *rbfm, const string &fileName, const vector<Attribute> &recordDescriptor,
+        int numRecords, unsigned extentPages, vector<RID> &rids)
+{
+    remove(fileName.c_str());
+    RC rc = rbfm->createFile(fileName);
+    assert(rc == 0 && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == 0 && "Opening the file should not fail.");
+    rc = fileHandle.setExtentPages(extentPages);
+    assert(rc == 0 && "Setting the extent size should not fail.");
+
+    void *record = malloc(PAGE_SIZE);
+    int length = NAME_LENGTH;
+    RID rid;
+    double start = now();
+    for (int i = 0; i < numRecords; i++) {
+        int offset = 0;
+        *((char *) record) = 0;
+        offset += 1;
+        memcpy((char *) record + offset, &i, sizeof(int));
+        offset += sizeof(int);
+        memcpy((char *) record + offset, &length, sizeof(int));
+        offset += sizeof(int);
+        memset((char *) record + offset, 'a' + i % 26, length);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == 0 && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    free(record);
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == 0 && "Closing the file should not fail.");
+    double insertTime = now() - start;
+
+    printf("insert, extent of %5u pages: %9.0f records/s\n", extentPages, numRecords / insertTime);
+}
+
+
+void runMode(RecordBasedFileManager *rbfm, const string &fileName, const vector<Attribute> &recordDescriptor,
+        const vector<RID> &rids, int numReads, IOMode ioMode, const char *label)
+{
+    // start from a pool that holds none of the pages of the file
+    BufferPoolManager::instance()->discardFile(fileName);
+
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(fileName, fileHandle, ioMode);
+    if (rc != 0) {
+        cout << label << ": openFile failed, the file system may not support this mode" << endl;
+        return;
+    }
+
+    // sequential scan
+    vector<string> attributes;
+    attributes.push_back("Id");
+    RBFM_ScanIterator rbfm_ScanIterator;
+    void *data = malloc(PAGE_SIZE);
+    RID rid;
+    int count = 0;
+
+    double start = now();
+    rc = rbfm->scan(fileHandle, recordDescriptor, "Id", NO_OP, NULL, attributes, rbfm_ScanIterator);
+    assert(rc == 0 && "Scanning the file should not fail.");
+    while (rbfm_ScanIterator.getNextRecord(rid, data) != RBFM_EOF) {
+        count++;
+    }
+    rbfm_ScanIterator.close();
+    double scanTime = now() - start;
+    double scanMB = (double) fileHandle.getNumberOfPages() * PAGE_SIZE / (1024 * 1024);
+
+    // random point reads, the same sequence for every mode
+    srand(42);
+    start = now();
+    for (int i = 0; i < numReads; i++) {
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[rand() % rids.size()], data);
+        assert(rc == 0 && "Reading a record should not fail.");
+    }
+    double readTime = now() - start;
+
+    unsigned readCount, writeCount, appendCount, hitCount, missCount, evictCount;
+    fileHandle.collectCounterValues(readCount, writeCount, appendCount);
+    fileHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+
+    printf("%-9s scan: %6d records %8.1f MB/s   readRecord: %9.0f ops/s   reads=%u misses=%u evictions=%u\n",
+            label, count, scanMB / scanTime, numReads / readTime, readCount, missCount, evictCount);
+
+    rbfm->closeFile(fileHandle);
+    free(data);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int numRecords = argc > 1 ? atoi(argv[1]) : 20000;
+    int numReads = argc > 2 ? atoi(argv[2]) : 50000;
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    string fileName = "rbfbench_data";
+    vector<Attribute> recordDescriptor;
+    vector<RID> rids;
+
+    createDescriptor(recordDescriptor);
+    loadFile(rbfm, fileName, recordDescriptor, numRecords, 1, rids);
+    rids.clear();
+    loadFile(rbfm, fileName, recordDescriptor, numRecords, DEFAULT_EXTENT_PAGES, rids);
+
+    runMode(rbfm, fileName, recordDescriptor, rids, numReads, IO_PREAD, "buffered");
+    runMode(rbfm, fileName, recordDescriptor, rids, numReads, IO_DIRECT, "direct");
+
+    rbfm->destroyFile(fileName);
+    return 0;
+}
@@ -1,8 +1,48 @@
 
 #include "rbfm.h"
+#include "bpm.h"
+#include <algorithm>
 
 RecordBasedFileManager* RecordBasedFileManager::_rbf_manager = 0;
 
+// handle whose file latch this thread holds exclusively, see FileLatchGuard
+static thread_local FileHandle *writingHandle = NULL;
+
+// Holds the file latch of a handle for one record operation: readers share
+// it, a writer has the file to itself. Writers nest (updateRecord calls
+// deleteRecord and insertRecord), so a thread that already writes the file
+// does not take the latch again.
+class FileLatchGuard
+{
+public:
+    FileLatchGuard(FileHandle &handle, bool exclusive) : handle(handle), held(writingHandle != &handle) {
+        if (!held) {
+            return;
+        }
+        if (exclusive) {
+            pthread_rwlock_wrlock(&handle.fileLatch);
+            writingHandle = &handle;
+        } else {
+            pthread_rwlock_rdlock(&handle.fileLatch);
+        }
+        this->exclusive = exclusive;
+    };
+    ~FileLatchGuard() {
+        if (!held) {
+            return;
+        }
+        if (exclusive) {
+            writingHandle = NULL;
+        }
+        pthread_rwlock_unlock(&handle.fileLatch);
+    };
+
+private:
+    FileHandle &handle;
+    bool held;
+    bool exclusive;
+};
+
 RecordBasedFileManager* RecordBasedFileManager::instance()
 {
     if(!_rbf_manager)
@@ -13,7 +53,6 @@ RecordBasedFileManager* RecordBasedFileManager::instance()
 RecordBasedFileManager::RecordBasedFileManager()
 {
     pfm = PagedFileManager::instance();
-    readingPage = NULL;
 }
 
 RecordBasedFileManager::~RecordBasedFileManager()
@@ -21,55 +60,54 @@ RecordBasedFileManager::~RecordBasedFileManager()
     delete _rbf_manager;
 }
 
-RC RecordBasedFileManager::createFile(const string &fileName) {
-    return pfm->createFile(fileName);
+RC RecordBasedFileManager::createFile(const string &fileName, bool compressed) {
+    // record changes are logged instead of forcing their pages out
+    return pfm->createFile(fileName, FILE_LOGGED | FILE_CHECKSUM | (compressed ? FILE_COMPRESSED : 0));
 }
 
 RC RecordBasedFileManager::destroyFile(const string &fileName) {
     return pfm->destroyFile(fileName);
 }
 
-RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle) {
-    if(pfm->openFile(fileName, fileHandle) == -1) {
+RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle, IOMode ioMode) {
+    if(pfm->openFile(fileName, fileHandle, ioMode) == -1) {
         return -1;
     }
 
-    // if the file is not empty then we need to scan it
-    if (fileHandle.numPages > 0) {
-        fileHandle.currentPageNum = fileHandle.numPages - 1;
-
-        void *page = malloc(PAGE_SIZE);
-        for (int i = 0; i <fileHandle.numPages; i++) {
-            // read the page and extract the free space
-            fileHandle.readPage(i, page);
-
-            // we need the number of records and freeSpaceOffset to calculate the freeSpace
-            int numRecords;
-            memcpy(&numRecords, (char *) page + N_OFFSET, sizeof(int));
+    // the free space of every page is kept in the map pages, no need to visit the data pages
+    if (loadFreeSpaceMap(fileHandle) == -1) {
+        pfm->closeFile(fileHandle);
+        return -1;
+    }
+    return 0;
+}
 
-            int freeSpaceOffset;
-            memcpy(&freeSpaceOffset, (char *) page + F_OFFSET, sizeof(int));
+RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
+    return pfm->closeFile(fileHandle);
+}
 
-            // Now we can derive the freeSpace
-            int freeSpace = PAGE_SIZE - (freeSpaceOffset + (numRecords * SLOT_SIZE) + META_INFO);
+RC RecordBasedFileManager::shareFile(const string &fileName, FileHandle *&fileHandle) {
+    if (pfm->shareFile(fileName, fileHandle) == -1) {
+        return -1;
+    }
 
-            // if the free space isn't in range then the page isn't formated right
-            if (freeSpace < 0 || freeSpace > PAGE_SIZE) {
-                free(page);
-                return 0;
-            }
-            fileHandle.freeSpace.push_back(freeSpace); 
-        }
-        fileHandle.currentPage = page;
+    // the first user loads the free space map, the others find it on the handle
+    FileLatchGuard latch(*fileHandle, true);
+    if (fileHandle->freeSpace.size() != fileHandle->getNumberOfPages() && loadFreeSpaceMap(*fileHandle) == -1) {
+        pfm->releaseFile(fileHandle);
+        fileHandle = NULL;
+        return -1;
     }
     return 0;
 }
 
-RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
-    return pfm->closeFile(fileHandle);
+RC RecordBasedFileManager::releaseFile(FileHandle *fileHandle) {
+    return pfm->releaseFile(fileHandle);
 }
 
 RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid) {
+    FileLatchGuard latch(fileHandle, true);
+
     // lets determine if we need to append a new page or just write to a page
     short numFields = recordDescriptor.size();
     int numNullBytes = ceil((double) numFields / CHAR_BIT);
@@ -81,106 +119,111 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Att
     void *metaData = malloc(metaNumBytes);
     int length = buildMetaData(data, recordDescriptor, metaData);
 
-    // findOpenSlot() will search for an open slot in the slot directory
-    // if it finds one it will update the rid and return the new offset for the record
-    int newOffset = findOpenSlot(fileHandle, length, rid);
-    if (newOffset == -1) {
-        // first thing we need to do is write the current page to file and free up the memory
-        // only if there is 1 or more pages in the file Handle
-        if (fileHandle.getNumberOfPages() != 0 && fileHandle.currentPage != NULL) {
-            if (fileHandle.writePage(fileHandle.getNumberOfPages() - 1, fileHandle.currentPage)) {
-                // error writing to file
-                return -1;
-            }
-            free(fileHandle.currentPage);
-            fileHandle.currentPage = NULL;
+    // findPageWithRoom() picks a page the record fits in, if there is one, and
+    // otherwise a page a delete gave back is taken before the file grows
+    PageNum pageNum;
+    bool reused = false;
+    if (findPageWithRoom(fileHandle, length, pageNum) == -1 && !(reused = fileHandle.reusePage(pageNum) == 0)) {
+        // the page we may be about to append could be due to be a free space map page
+        if (isFreeSpaceMapPage(fileHandle.getNumberOfPages()) && appendFreeSpaceMapPage(fileHandle) == -1) {
+            free(metaData);
+            return -1;
         }
 
         // we need to append a new page
-        fileHandle.currentPage = malloc(PAGE_SIZE);
-        void *newPage = fileHandle.currentPage;
+        void *newPage = malloc(PAGE_SIZE);
         memset(newPage, 0, PAGE_SIZE);
 
-        // update the RID
-        fileHandle.currentPageNum = fileHandle.getNumberOfPages();
-        updateSlotDirectory(rid, fileHandle.getNumberOfPages(), 0);
-
         // Now let's add the new record
-        setUpNewPage(newPage, data, length, fileHandle, metaData, metaNumBytes, recordDescriptor.size());
-        fileHandle.appendPage(newPage);
+        int freeSpace = setUpNewPage(newPage, data, length, metaData, metaNumBytes, recordDescriptor.size());
+        RC rc = fileHandle.allocatePage(newPage, pageNum);
+        if (rc == 0) {
+            // update the RID
+            updateSlotDirectory(rid, pageNum, 0);
+            rc = setFreeSpace(fileHandle, pageNum, freeSpace);
+        }
 
-        return 0;
+        free(newPage);
+        free(metaData);
+        return rc;
     } else {
-
-        // Determine if we will use the current page or a previous page
+        // pin the page findPageWithRoom() picked for us and take a slot on it
+        rid.pageNum = pageNum;
         void *page = determinePageToUse(rid, fileHandle);
+        if (page == NULL) {
+            free(metaData);
+            return -1;
+        }
+        // the log gets what the insert changed on the page, the slot taken included
+        void *before = malloc(PAGE_SIZE);
+        memcpy(before, page, PAGE_SIZE);
+        if (reused) {
+            // a freed page kept the tombstones of its records, so their RIDs are
+            // handed out again as after a delete in place. Only a directory that
+            // leaves the record no room is started over
+            memset(page, 0, sizeof(FreePageMarker));
+            if (getStartOfDirectoryOffset(page) < length + SLOT_SIZE) {
+                memset(page, 0, PAGE_DATA_SIZE);
+            }
+        }
+        updateSlotDirectory(rid, pageNum, getSlot(page));
+        int newOffset = getFreeSpaceOffset(page);
 
         transferRecordToPage(page, data, metaData, newOffset, metaNumBytes, recordDescriptor.size(), length);
 
         // update the number of records and freeSpaceOffset
-        int numRecords = incrementNumRecords(page);
+        incrementNumRecords(page);
         int freeSpaceOffset = incrementFreeSpaceOffset(page, length);
 
         // finally update freespace list
-        updateFreeSpace(numRecords, freeSpaceOffset, rid.pageNum, fileHandle);
+        updateFreeSpace(extractNumSlots(page), freeSpaceOffset, rid.pageNum, fileHandle);
 
         // now we need to enter in the slot directory entry
-        int slotEntryOffset = N_OFFSET - ((rid.slotNum + 1) * SLOT_SIZE);
+        int slotEntryOffset = PAGE_DATA_SIZE - (((rid.slotNum + 1) * SLOT_SIZE) + META_INFO);
         memcpy((char *) page + slotEntryOffset, &newOffset, sizeof(int));
         memcpy((char *) page + slotEntryOffset + sizeof(int), &length, sizeof(int));
 
-        fileHandle.writePage(rid.pageNum, page);
-        // if we opened a page that was not the header page then free that memory
-        if (fileHandle.currentPageNum != (unsigned) rid.pageNum) {
-            free(page);
-        }
-        return 0;
+        free(metaData);
+        RC rc = fileHandle.unpinLoggedPage(rid.pageNum, page, before);
+        free(before);
+        return rc;
     }
     return -1;
 }
 
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data) {
-        // Determine which page to use using the rid
-    if (readingPage == NULL) {
-        readingPage = determinePageToUse(rid, fileHandle);
-        readingRID.pageNum = rid.pageNum;
-        readingRID.slotNum = rid.slotNum;
-    }
+    FileLatchGuard latch(fileHandle, false);
 
-    if (readingRID.pageNum != rid.pageNum) {
-        readingPage = determinePageToUse(rid, fileHandle);
-        readingRID.pageNum = rid.pageNum;
-        readingRID.slotNum = rid.slotNum;
+    // Determine which page to use using the rid
+    void *page = determinePageToUse(rid, fileHandle);
+    if (page == NULL) {
+        return -1;
     }
-    void *page = readingPage;
 
     int offset, length;
     getSlotFile(rid.slotNum, page, &offset, &length);
 
-    if (offset == 0 && length == 0) {
+    if (length == 0) {
         // we have a tombstone here and we need to return an error
+        fileHandle.unpinPage(rid.pageNum, false);
         return -1;
     }
 
     // we need to check for a pointer to another record here
     if (length < 0) {
+        fileHandle.unpinPage(rid.pageNum, false);
         RID newRid;
         newRid.pageNum = (offset * -1) - 1;
         newRid.slotNum = (length * -1) - 1;
         return readRecord(fileHandle, recordDescriptor, newRid, data);
     }
 
-    // Now copy the entire contents into data
-    void *tempData = malloc(length);
-    memcpy((char *) tempData, (char *) page + offset, length);
+    // the null bytes and the field data come straight from the record in the page
+    RecordView record((char *) page + offset, length);
+    memcpy((char *) data, record.getNullBytes(), record.getNumNullBytes());
+    memcpy((char *) data + record.getNumNullBytes(), record.getRecord() + record.getDataOffset(), length - record.getDataOffset());
 
-    // we now need to extract the field data from the record
-    extractFieldData(recordDescriptor.size(), length, data, tempData);
-
-    // free up the tempData
-    free(tempData);
-
-    return 0;
+    return fileHandle.unpinPage(rid.pageNum, false);
 }
 
 RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor, const void *data) {
@@ -200,8 +243,11 @@ RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor
 }
 
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid) {
-    /****** TODO: we need to consider deleting a pointer *********/
+    FileLatchGuard latch(fileHandle, true);
+    return removeRecord(fileHandle, rid, NO_PAGE);
+}
 
+RC RecordBasedFileManager::removeRecord(FileHandle &fileHandle, const RID &rid, PageNum keepPage) {
     // Determine if we will use the current page or a previous page
     void *page = determinePageToUse(rid, fileHandle);
 
@@ -213,56 +259,121 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 
     // Test if the slot id is a pointer, and if so collect the RID and return deleteRecord with the new RID.
     if (length < 0) {
+        fileHandle.unpinPage(rid.pageNum, false);
         RID newRid;
         newRid.pageNum = (offset * -1) - 1;
         newRid.slotNum = (length * -1) - 1;
-        return deleteRecord(fileHandle, recordDescriptor, newRid);
+        if (removeRecord(fileHandle, newRid, keepPage) == -1) {
+            return -1;
+        }
+        // updateRecord writes the slot over itself, a delete leaves a tombstone
+        // so the pointer never leads into the page the record was on once it is reused
+        if ((PageNum) rid.pageNum == keepPage) {
+            return 0;
+        }
+        return removePointer(fileHandle, rid);
     }
     // Cannot delete a tombstone, therefore error.
     if (length == 0) {
+        fileHandle.unpinPage(rid.pageNum, false);
         return -1;
     }
 
+    void *before = malloc(PAGE_SIZE);
+    memcpy(before, page, PAGE_SIZE);
+
     // Write uninitialized data into the page where the record currently lies
     //void *newData = malloc(length);
     //memcpy(page, (char*) newData, length);
     // memset?
     memset((char *) page + offset, 0, length);
 
-    // Clear out the slot in the meta data
-    int zero = 0;
-    int location = PAGE_SIZE - (((rid.slotNum + 1) * SLOT_SIZE) + META_INFO);
-    memcpy((char *) page + location, &zero, sizeof(int));
-    memcpy((char *) page + location + sizeof(int), &zero, sizeof(int));
+    // Turn the slot into a tombstone for the next insert on the page to reuse
+    freeSlot(page, rid.slotNum);
 
     // maybe update number of records and freespace offset here?
 
-    // update freeSpace vector
-    fileHandle.freeSpace[rid.pageNum] += length;
+    // update freeSpace vector and map
+    setFreeSpace(fileHandle, rid.pageNum, fileHandle.freeSpace[rid.pageNum] + length);
 
     // Shifts the data appropriately
     compactMemory(offset, length, page, fileHandle.freeSpace[rid.pageNum]);
     
-    // we must write the page back to file
-    fileHandle.writePage(rid.pageNum, page);
+    // the page has been modified in place, let the buffer pool write it back
+    bool empty = isEmptyPage(page);
+    RC rc = fileHandle.unpinLoggedPage(rid.pageNum, page, before);
+    free(before);
+    if (rc == -1 || !empty || (PageNum) rid.pageNum == keepPage) {
+        return rc;
+    }
+    return releasePage(fileHandle, rid.pageNum);
+}
 
-    // update the currentPage if it was deleted from there 
-    if ((unsigned) rid.pageNum == fileHandle.currentPageNum) {
-        fileHandle.readPage(fileHandle.currentPageNum, fileHandle.currentPage);
+RC RecordBasedFileManager::removePointer(FileHandle &fileHandle, const RID &rid) {
+    void *page = determinePageToUse(rid, fileHandle);
+    if (page == NULL) return -1;
+    void *before = malloc(PAGE_SIZE);
+    memcpy(before, page, PAGE_SIZE);
+
+    // the pointer holds no bytes of the page, it only counted as a record
+    freeSlot(page, rid.slotNum);
+    decrementNumRecords(page);
+
+    bool empty = isEmptyPage(page);
+    RC rc = fileHandle.unpinLoggedPage(rid.pageNum, page, before);
+    free(before);
+    if (rc == -1 || !empty) {
+        return rc;
     }
-    // free up memory
-    if (fileHandle.currentPageNum != (unsigned) rid.pageNum) {
-        free(page);
+    return releasePage(fileHandle, rid.pageNum);
+}
+
+RC RecordBasedFileManager::releasePage(FileHandle &fileHandle, PageNum pageNum) {
+    // a page left with nothing but tombstones goes back to the file, it has no
+    // room until insertRecord gets it from reusePage again
+    if (fileHandle.freePage(pageNum) == -1) {
+        return -1;
     }
-    return 0;
+    return setFreeSpace(fileHandle, pageNum, 0);
+}
+
+bool RecordBasedFileManager::isEmptyPage(const void *page) {
+    int offset, length;
+    for (int i = 0; i < extractNumSlots(page); i++) {
+        getSlotFile(i, page, &offset, &length);
+        if (length != 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
 RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid) {
+    FileLatchGuard latch(fileHandle, true);
+
     void *page = determinePageToUse(rid, fileHandle);
+    if (page == NULL) return -1;
     RID tempRid;
 
-    // Delete the old record
-    if (RecordBasedFileManager::deleteRecord(fileHandle, recordDescriptor, rid) == -1) return -1;
+    // a forwarded record is deleted where it lives, its pointer here stays counted
+    int homeOffset, homeLength;
+    getSlotFile(rid.slotNum, page, &homeOffset, &homeLength);
+    bool forwarded = homeLength < 0;
+
+    // Delete the old record, keeping its page even if that empties it
+    if (removeRecord(fileHandle, rid, rid.pageNum) == -1) {
+        fileHandle.unpinPage(rid.pageNum, false);
+        return -1;
+    }
+
+    // deleteRecord logged its own part of the change
+    void *before = malloc(PAGE_SIZE);
+    memcpy(before, page, PAGE_SIZE);
+
+    // a record deleted in place left its slot at the head of the free chain, take it back
+    if (!forwarded) {
+        getSlot(page);
+    }
 
     // Get new offset and (potentially) new RID. RID could be new if the updated record is now too large for page.
     short numFields = recordDescriptor.size();
@@ -279,51 +390,54 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     // If the new RID slot is on a different page, update the slot record with the negated version of these values
     if (length > freeSpace) {
         // because the first open slot is on a new page, just insert record as usual
-        if (RecordBasedFileManager::insertRecord(fileHandle, recordDescriptor, data, tempRid) == -1)
+        if (RecordBasedFileManager::insertRecord(fileHandle, recordDescriptor, data, tempRid) == -1) {
+            fileHandle.unpinPage(rid.pageNum, false);
+            free(metaData);
+            free(before);
             return -1;
+        }
 
         //update slot directory with negative values to reflect tombstone
         tempRid.pageNum = (tempRid.pageNum + 1) * -1;
         tempRid.slotNum = (tempRid.slotNum + 1) * -1;
         
-        int slotEntryOffset = N_OFFSET - ((rid.slotNum + 1) * SLOT_SIZE);
+        int slotEntryOffset = PAGE_DATA_SIZE - (((rid.slotNum + 1) * SLOT_SIZE) + META_INFO);
         memcpy((char *)page + slotEntryOffset, &tempRid.pageNum, sizeof(int));
         memcpy((char *)page + slotEntryOffset + sizeof(int), &tempRid.slotNum, sizeof(int));
 
-        fileHandle.writePage(rid.pageNum, page);
-        // if we opened a page that was not the header page then free that memory
-        if (fileHandle.currentPageNum != (unsigned) rid.pageNum) {
-            free(page);
+        // the forwarding slot is counted as a record again, like any live slot
+        if (!forwarded) {
+            incrementNumRecords(page);
         }
 
         free(metaData);
-        return 0;
+        RC rc = fileHandle.unpinLoggedPage(rid.pageNum, page, before);
+        free(before);
+        return rc;
     }
     else {
-        page = determinePageToUse(rid, fileHandle);
         // get the new offset from the page
         int newOffset = getFreeSpaceOffset(page);
         transferRecordToPage(page, data, metaData, newOffset, metaNumBytes, recordDescriptor.size(), length);
 
         // update the number of records and freeSpaceOffset
-        int numRecords = incrementNumRecords(page);
+        if (!forwarded) {
+            incrementNumRecords(page);
+        }
         int freeSpaceOffset = incrementFreeSpaceOffset(page, length);
 
         // finally update freespace list
-        updateFreeSpace(numRecords, freeSpaceOffset, rid.pageNum, fileHandle);
+        updateFreeSpace(extractNumSlots(page), freeSpaceOffset, rid.pageNum, fileHandle);
 
         // now we need to enter in the slot directory entry
-        int slotEntryOffset = N_OFFSET - ((rid.slotNum + 1) * SLOT_SIZE);
+        int slotEntryOffset = PAGE_DATA_SIZE - (((rid.slotNum + 1) * SLOT_SIZE) + META_INFO);
         memcpy((char *) page + slotEntryOffset, &newOffset, sizeof(int));
         memcpy((char *) page + slotEntryOffset + sizeof(int), &length, sizeof(int));
 
-        fileHandle.writePage(rid.pageNum, page);
-        // if we opened a page that was not the header page then free that memory
-        if (fileHandle.currentPageNum != (unsigned) rid.pageNum) {
-            free(page);
-        }
         free(metaData);
-        return 0;
+        RC rc = fileHandle.unpinLoggedPage(rid.pageNum, page, before);
+        free(before);
+        return rc;
     }
 
     return -1;
@@ -348,78 +462,35 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle
         // the attribute name was not found
         return -1;
     }
-    // get the page, record and number of fields in the record
+    // get the page and the record in it
+    FileLatchGuard latch(fileHandle, false);
     void *page = determinePageToUse(rid, fileHandle);
-    void *record = extractRecord(rid.slotNum, page);
-    int numFields = getNumberOfFields(record);
-
-    // we can now test and see if the field is null
-    int numNullBytes = ceil((double)recordDescriptor.size() / CHAR_BIT);
-    void *nullBytes = malloc(numNullBytes);
-    memcpy((char *) nullBytes, (char *) record + FIELD_OFFSET, numNullBytes);
-
-    // if the field is null just return a nullbyte indicator
-    if (isFieldNull(nullBytes, fieldPlacement)) {
-        void *newNull = malloc(1);
-        memset((char *) newNull, 0, 1);
-        memcpy((char *) data,  (char *) newNull, 1);
-        free(page);
-        free(record);
-        free(nullBytes);
-        free(newNull);
-        return 0;
+    if (page == NULL) {
+        return -1;
     }
-
-    // Also not sure if void *data is already allocated or not
-    int fieldOffset = getFieldOffset(fieldPlacement, numNullBytes, record);
-    int nextFieldOffset;
-
-    // in order to get the next field offset we need to check if this is the last field
-    if ((fieldPlacement + 1) == numFields) {
-        int offset, length;
-        getSlotFile(rid.slotNum, page, &offset, &length);
-        nextFieldOffset = length;
-    } else {
-        nextFieldOffset = getFieldOffset(fieldPlacement + 1, numNullBytes, record);
+    int offset, length;
+    getSlotFile(rid.slotNum, page, &offset, &length);
+    if (length == 0) {
+        fileHandle.unpinPage(rid.pageNum, false);
+        return -1;
     }
 
-    // let's get the length of the field
-    int fieldLength = nextFieldOffset - fieldOffset;
-
-    // TODO: do I need to add a nullField to this one attribute?
-    void *newNullByte = malloc(1);
-    memset((char *) newNullByte, 0, 1);
-    memcpy((char *) data, (char *) newNullByte, 1);
-    // extract the field into data and free up memory used
-    memcpy((char *) data + 1, (char *) record + fieldOffset, fieldLength);
-
-    free(page);
-    free(record);
-    free(nullBytes);
-    free(newNullByte);
-    return 0;
-}
-
-int RecordBasedFileManager::getFieldOffset(int location, int numNullBytes, const void *record) {
-    int fieldDataOffset = FIELD_OFFSET + numNullBytes + (location * FIELD_OFFSET);
-    short fieldOffset;
-    memcpy(&fieldOffset, (char *) record + fieldDataOffset, FIELD_OFFSET);
-    return (int)fieldOffset;
-}
+    // follow a record that was moved to another page
+    if (length < 0) {
+        fileHandle.unpinPage(rid.pageNum, false);
+        RID newRid;
+        newRid.pageNum = (offset * -1) - 1;
+        newRid.slotNum = (length * -1) - 1;
+        return readAttribute(fileHandle, recordDescriptor, newRid, attributeName, data);
+    }
+    RecordView record((char *) page + offset, length);
 
-f_data RecordBasedFileManager::getNumberOfFields(const void *record) {
-    f_data numRecords;
-    memcpy(&numRecords, (char *) record, FIELD_OFFSET);
-    return numRecords;
-}
+    // a null field comes back as just the null indicator
+    unsigned char nullByte = record.isNull(fieldPlacement) ? 0x80 : 0;
+    memcpy((char *) data, &nullByte, 1);
+    memcpy((char *) data + 1, record.getField(fieldPlacement), record.getFieldLength(fieldPlacement));
 
-void* RecordBasedFileManager::extractRecord(int slotNum, const void *page) {
-    // TODO: make a guard against asking for an invalid slotNum
-    int offset, length;
-    getSlotFile(slotNum, page, &offset, &length);
-    void *record = malloc(length);
-    memcpy((char *) record, (char *) page + offset, length);
-    return record;
+    return fileHandle.unpinPage(rid.pageNum, false);
 }
 
 int RecordBasedFileManager::incrementFreeSpaceOffset(void *page, int length) {
@@ -452,10 +523,158 @@ int RecordBasedFileManager::decrementNumRecords(void *page) {
     return numRecords;
 }
 
-void RecordBasedFileManager::updateFreeSpace(int numRecords, int freeSpaceOffset,int pageNum, FileHandle &handle) {
-    // we can change this to just extract the current freeSpace and increment by numBytes
-    int freeSpace = PAGE_SIZE - (freeSpaceOffset + (numRecords * SLOT_SIZE) + META_INFO);
+void RecordBasedFileManager::updateFreeSpace(int numSlots, int freeSpaceOffset,int pageNum, FileHandle &handle) {
+    // tombstones keep their slot, so the whole directory is counted
+    int freeSpace = PAGE_DATA_SIZE - (freeSpaceOffset + (numSlots * SLOT_SIZE) + META_INFO);
+    setFreeSpace(handle, pageNum, freeSpace);
+}
+
+RC RecordBasedFileManager::setFreeSpace(FileHandle &handle, PageNum pageNum, int freeSpace) {
+    if (pageNum >= handle.freeSpace.size()) {
+        handle.freeSpace.resize(pageNum + 1, 0);
+    }
     handle.freeSpace[pageNum] = freeSpace;
+    updateFreeSpaceTree(handle, pageNum);
+
+    // write the entry through to the map page that covers this page
+    void *mapPage;
+    PageNum mapPageNum = pageNum - pageNum % FSM_INTERVAL;
+    if (handle.pinPage(mapPageNum, mapPage) == -1) {
+        return -1;
+    }
+    void *before = malloc(PAGE_SIZE);
+    memcpy(before, mapPage, PAGE_SIZE);
+    fsm_entry entry = freeSpace;
+    memcpy((char *) mapPage + (pageNum % FSM_INTERVAL) * sizeof(fsm_entry), &entry, sizeof(fsm_entry));
+    RC rc = handle.unpinLoggedPage(mapPageNum, mapPage, before);
+    free(before);
+    return rc;
+}
+
+RC RecordBasedFileManager::appendFreeSpaceMapPage(FileHandle &handle) {
+    void *mapPage = malloc(PAGE_SIZE);
+    memset(mapPage, 0, PAGE_SIZE);
+    fsm_entry magic = FSM_MAGIC;
+    memcpy(mapPage, &magic, sizeof(fsm_entry));
+
+    RC rc = handle.appendPage(mapPage);
+    free(mapPage);
+    if (rc == -1) {
+        return -1;
+    }
+    if (handle.getFreeSpaceMapRoot() == NO_PAGE) {
+        handle.setFreeSpaceMapRoot(handle.getNumberOfPages() - 1);
+    }
+
+    // a map page has no room for records
+    handle.freeSpace.push_back(0);
+    updateFreeSpaceTree(handle, handle.freeSpace.size() - 1);
+    return 0;
+}
+
+RC RecordBasedFileManager::loadFreeSpaceMap(FileHandle &handle) {
+    unsigned numPages = handle.getNumberOfPages();
+    handle.freeSpace.assign(numPages, 0);
+    if (numPages == 0) {
+        return 0;
+    }
+
+    // the header knows where the map starts, a file without one was not written by us.
+    // the header of a crashed handle may predate the first map page, which is page 0
+    PageNum root = handle.getFreeSpaceMapRoot();
+    if (root == NO_PAGE) {
+        root = 0;
+        handle.setFreeSpaceMapRoot(root);
+    }
+    if (root != 0) {
+        return -1;
+    }
+    for (PageNum mapPageNum = root; mapPageNum < numPages; mapPageNum += FSM_INTERVAL) {
+        void *mapPage;
+        if (handle.pinPage(mapPageNum, mapPage) == -1) {
+            return -1;
+        }
+
+        fsm_entry entry;
+        memcpy(&entry, mapPage, sizeof(fsm_entry));
+        if (entry != FSM_MAGIC) {
+            // not a record based file, or one written before the map existed
+            handle.unpinPage(mapPageNum, false);
+            return -1;
+        }
+        for (unsigned i = 1; i < FSM_INTERVAL && mapPageNum + i < numPages; i++) {
+            memcpy(&entry, (char *) mapPage + i * sizeof(fsm_entry), sizeof(fsm_entry));
+            handle.freeSpace[mapPageNum + i] = entry;
+        }
+        handle.unpinPage(mapPageNum, false);
+    }
+    buildFreeSpaceTree(handle);
+    return 0;
+}
+
+void RecordBasedFileManager::buildFreeSpaceTree(FileHandle &handle) {
+    // a complete binary tree over a power of two of pages, node n covers
+    // nodes 2n and 2n + 1 and holds the most free space under it
+    unsigned leaves = 1;
+    while (leaves < handle.freeSpace.size()) {
+        leaves *= 2;
+    }
+    vector<unsigned> &tree = handle.freeSpaceTree;
+    tree.assign(2 * leaves, 0);
+    copy(handle.freeSpace.begin(), handle.freeSpace.end(), tree.begin() + leaves);
+    for (unsigned node = leaves - 1; node > 0; node--) {
+        tree[node] = max(tree[2 * node], tree[2 * node + 1]);
+    }
+}
+
+void RecordBasedFileManager::updateFreeSpaceTree(FileHandle &handle, PageNum pageNum) {
+    vector<unsigned> &tree = handle.freeSpaceTree;
+    unsigned leaves = tree.size() / 2;
+    if (pageNum >= leaves) {
+        // the file outgrew the tree, or truncate dropped it
+        buildFreeSpaceTree(handle);
+        return;
+    }
+    unsigned node = leaves + pageNum;
+    tree[node] = handle.freeSpace[pageNum];
+    for (node /= 2; node > 0; node /= 2) {
+        unsigned most = max(tree[2 * node], tree[2 * node + 1]);
+        if (tree[node] == most) {
+            break;
+        }
+        tree[node] = most;
+    }
+}
+
+PageNum RecordBasedFileManager::firstFit(FileHandle &handle, unsigned room, PageNum from) {
+    vector<unsigned> &tree = handle.freeSpaceTree;
+    unsigned leaves = tree.size() / 2;
+    if (from >= leaves || tree[1] < room) {
+        return NO_PAGE;
+    }
+
+    // climb from the leaf of from until a subtree to its right has room
+    unsigned node = leaves + from;
+    if (tree[node] < room) {
+        while (true) {
+            // a left child's sibling holds the pages right after it
+            if (node % 2 == 0 && tree[node + 1] >= room) {
+                node++;
+                break;
+            }
+            node /= 2;
+            if (node <= 1) {
+                return NO_PAGE;
+            }
+        }
+    }
+
+    // then go down to its leftmost page with room
+    while (node < leaves) {
+        node = tree[2 * node] >= room ? 2 * node : 2 * node + 1;
+    }
+    PageNum pageNum = node - leaves;
+    return pageNum < handle.freeSpace.size() ? pageNum : NO_PAGE;
 }
 
 void RecordBasedFileManager::transferRecordToPage(void *page
@@ -478,41 +697,18 @@ void RecordBasedFileManager::transferRecordToPage(void *page
 }
 
 void* RecordBasedFileManager::determinePageToUse(const RID &rid, FileHandle &handle) {
+    // the page stays pinned in the buffer pool until the caller unpins it
     void *page = NULL;
-    if (handle.currentPageNum == (unsigned) rid.pageNum) {
-        page = handle.currentPage;
-    } else {
-        page = malloc(PAGE_SIZE);
-        handle.readPage(rid.pageNum, page);
+    if (handle.pinPage(rid.pageNum, page) == -1) {
+        return NULL;
     }
     return page;
 }
 
-void RecordBasedFileManager::extractFieldData(int numFields, int length, void *data, void *tempData) {
-    int offset = 0;
-    int numNullBytes = ceil((double)numFields / CHAR_BIT);
-    memcpy((char *) data, (char *) tempData + sizeof(short), numNullBytes);
-
-    // skip over the field offset data a
-    offset += numNullBytes + ((numFields + 1) * sizeof(short));
-    length -= offset;
-    memcpy((char *) data + numNullBytes, (char *) tempData + offset, length);
-}
-
 bool RecordBasedFileManager::isFieldNull(const void *data, int i) {
-    // create an bitmask to test if the field is null
-    unsigned char *bitmask = (unsigned char*) malloc(1);
-    memset(bitmask, 0, 1);
-    *bitmask = 1 << 7;
-    *bitmask >>= i % CHAR_BIT;
-
-    // extract the NULL fields indicator from the data
-    unsigned char *nullField = (unsigned char*) malloc(1);
-    memcpy(nullField, (char *) data + (i / CHAR_BIT), 1);
-    bool retVal = (*bitmask & *nullField) ? true : false;
-    free(bitmask);
-    free(nullField);
-    return retVal;
+    // the first field is the high bit of the first byte
+    unsigned char bitmask = 0x80 >> (i % CHAR_BIT);
+    return (((const unsigned char *) data)[i / CHAR_BIT] & bitmask) != 0;
 }
 
 std::string RecordBasedFileManager::extractType(const void *data, int *offset, AttrType t, AttrLength l) {
@@ -552,7 +748,7 @@ std::string RecordBasedFileManager::extractType(const void *data, int *offset, A
 }
 
 int RecordBasedFileManager::buildMetaData(const void *data, const vector<Attribute> &descriptor, void *field) {
-    short dataOffset = 0;
+    f_offset dataOffset = 0;
 
     // enter the number of fields as the first param in the field data
     short numFields = descriptor.size();
@@ -598,90 +794,85 @@ int RecordBasedFileManager::buildMetaData(const void *data, const vector<Attribu
 }
 
 void RecordBasedFileManager::getSlotFile(int slotNum, const void *page, int *offset, int *length) {
+    // a slot past the directory, as in a RID from before the page was freed, reads as a tombstone
+    if (slotNum < 0 || slotNum >= extractNumSlots(page)) {
+        *offset = 0;
+        *length = 0;
+        return;
+    }
     // first lets get the slot offset
-    int location = PAGE_SIZE - (((slotNum + 1) * SLOT_SIZE) + META_INFO);
+    int location = PAGE_DATA_SIZE - (((slotNum + 1) * SLOT_SIZE) + META_INFO);
     memcpy(offset, (char *) page + location, sizeof(int));
     memcpy(length, (char *) page + location + sizeof(int), sizeof(int));
 }
 
-int RecordBasedFileManager::findOpenSlot(FileHandle &handle, int size, RID &rid) {
+RC RecordBasedFileManager::findPageWithRoom(FileHandle &handle, int size, PageNum &pageNum) {
     // first we need to check and see if the current page has available space
-    int pageNum = handle.getNumberOfPages() - 1;
-    if (pageNum < 0) {
+    int lastPage = handle.getNumberOfPages() - 1;
+    if (lastPage < 0) {
         // this means we have no pages in a file and must generate a page
         return -1;
     }
-    // if we get here we have a page current page and we need to get its freespace
-    void *page = handle.currentPage;
-
-    int freeSpace = handle.freeSpace[pageNum];
-    int newSlotNum;
-    if (freeSpace > (size + SLOT_SIZE)) {
-        // the current page has enough space to fit a new record
-        newSlotNum = getSlot(handle.currentPage, freeSpace);
-        updateSlotDirectory(rid, pageNum, newSlotNum);
-        return getFreeSpaceOffset(page);
-    }
-
-    int sizeOfFile = handle.currentPageNum;
-    int retVal = -1;
-
-    // we only need to test the pages upto the current one, since we already tested it.
-    for (int pageNum = 0; pageNum < sizeOfFile; pageNum++) {
-        freeSpace = handle.freeSpace[pageNum];
-        // if the free space is big enough to accomodate the new record then stick it in.
-        if (freeSpace > (size + SLOT_SIZE)) {
-            // open a temp page and scan it for a new offset
-            void *_tempPage = malloc(PAGE_SIZE);
-            handle.readPage(pageNum, _tempPage);
-
-            // update slot directory and get the freeSpaceOffset
-            newSlotNum = getSlot(_tempPage, freeSpace);
-            updateSlotDirectory(rid, pageNum, newSlotNum);
-            retVal = getFreeSpaceOffset(_tempPage);
-            free(_tempPage);
-            break;
-        }
+    // the tree only holds pages the file has
+    if (handle.freeSpaceTree.size() / 2 < handle.freeSpace.size()) {
+        buildFreeSpaceTree(handle);
+    }
+    // pages count as fitting when they have more room than the record and a slot
+    unsigned room = size + SLOT_SIZE + 1;
+    if ((unsigned) lastPage < handle.freeSpace.size() && handle.freeSpace[lastPage] >= room) {
+        // the last page has enough space to fit a new record
+        pageNum = lastPage;
+        return 0;
     }
-    // if we get here than no space was available and we need to append
-    return retVal;
-}
 
-int RecordBasedFileManager::getSlot(const void *page, int freeSpace) {
-    int numRecords = extractNumRecords(page);
-    int startOfSlotDirectoryOffset = getStartOfDirectoryOffset(numRecords, page);
-
-    // we need to test and see if the number of slots directories is equal to the
-    // start of the Slot direcotry offset. If its not then we have tombstones
-    int numSlotsOffset = PAGE_SIZE - ((numRecords * SLOT_SIZE) + META_INFO);
-
-    // if start of the Slot Direcotry is smaller than number of Slots offset
-    // than we know we have tombstones
-    if (startOfSlotDirectoryOffset < numSlotsOffset) {
-        // we need to loop through all the slot directories until an empyt slot is found
-        int slotCounter = 0;
-        int slotsOffset = PAGE_SIZE - (SLOT_SIZE + META_INFO);
-        while (slotsOffset >= startOfSlotDirectoryOffset) {
-            int offset, length;
-            memcpy(&offset, (char *) page + slotsOffset, sizeof(int));
-            memcpy(&length, (char *) page + slotsOffset + sizeof(int), sizeof(int));
-
-            // check and see if this slot is empty
-            if (length == 0 && offset == 0)
-                return slotCounter;
-
-            // keep moving along the slot directory
-            slotsOffset -= SLOT_SIZE;
-            slotCounter++;
+    // otherwise the lowest pages with room, the first one in the buffer pool saves a read
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    PageNum first = firstFit(handle, room, 0);
+    PageNum candidate = first;
+    for (unsigned i = 0; i < FIT_CANDIDATES && candidate != NO_PAGE; i++) {
+        if (bpm->isCached(handle, candidate)) {
+            pageNum = candidate;
+            return 0;
         }
+        candidate = firstFit(handle, room, candidate + 1);
+    }
+    if (first == NO_PAGE) {
+        // if we get here than no space was available and we need to append
+        return -1;
+    }
+    pageNum = first;
+    return 0;
+}
 
-    } else {
-        // if they are the same then just return the number of records since
-        // that will be the next slot number
-        return numRecords;
+int RecordBasedFileManager::getSlot(void *page) {
+    // a slot freed by a delete is reused before the directory grows
+    int head;
+    memcpy(&head, (char *) page + C_OFFSET, sizeof(int));
+    if (head != 0) {
+        int slotNum = head - 1;
+        int next, length;
+        getSlotFile(slotNum, page, &next, &length);
+        memcpy((char *) page + C_OFFSET, &next, sizeof(int));
+        return slotNum;
     }
-    // if we get here then something went wrong
-    return -1;
+
+    // otherwise the next slot past the end of the directory
+    int numSlots = extractNumSlots(page);
+    int newNumSlots = numSlots + 1;
+    memcpy((char *) page + S_OFFSET, &newNumSlots, sizeof(int));
+    return numSlots;
+}
+
+void RecordBasedFileManager::freeSlot(void *page, int slotNum) {
+    // the tombstone keeps a length of 0 and links the next free slot + 1 in its offset
+    int head;
+    memcpy(&head, (char *) page + C_OFFSET, sizeof(int));
+    int zero = 0;
+    int location = PAGE_DATA_SIZE - (((slotNum + 1) * SLOT_SIZE) + META_INFO);
+    memcpy((char *) page + location, &head, sizeof(int));
+    memcpy((char *) page + location + sizeof(int), &zero, sizeof(int));
+    head = slotNum + 1;
+    memcpy((char *) page + C_OFFSET, &head, sizeof(int));
 }
 
 int RecordBasedFileManager::extractNumRecords(const void *page) {
@@ -690,6 +881,12 @@ int RecordBasedFileManager::extractNumRecords(const void *page) {
     return numRecords;
 }
 
+int RecordBasedFileManager::extractNumSlots(const void *page) {
+    int numSlots;
+    memcpy(&numSlots, (char *) page + S_OFFSET, sizeof(int));
+    return numSlots;
+}
+
 void RecordBasedFileManager::updateSlotDirectory(RID &rid, int pageNum, int slotNum) {
     rid.pageNum = pageNum;
     rid.slotNum = slotNum;
@@ -701,10 +898,9 @@ int RecordBasedFileManager::getFreeSpaceOffset(const void *data) {
     return freeSpaceOffset;
 }
 
-void RecordBasedFileManager::setUpNewPage(void *newPage
+int RecordBasedFileManager::setUpNewPage(void *newPage
         , const void *data
         , int length
-        , FileHandle &handle
         , void *metaData
         , int fieldNumBytes
         , int recSize) {
@@ -712,12 +908,15 @@ void RecordBasedFileManager::setUpNewPage(void *newPage
     // for the next part we only want to know the length of the record and then copy all it's contents over
     transferRecordToPage(newPage, data, metaData, 0, fieldNumBytes, recSize, length);
 
-    // we need put 1 page in the slot directory meta data
+    // we need put 1 page in the slot directory meta data, in a directory of 1 slot with none free
     int numRecords = 1;
     memcpy((char *) newPage + N_OFFSET, &numRecords, sizeof(int));
+    memcpy((char *) newPage + S_OFFSET, &numRecords, sizeof(int));
+    int noFreeSlot = 0;
+    memcpy((char *) newPage + C_OFFSET, &noFreeSlot, sizeof(int));
 
     // next we need to add slot 1 meta data, each slot is 2 ints (8 bytes) in length to fit the offset and length
-    int slotOneOffset = N_OFFSET - (2 * sizeof(int));;
+    int slotOneOffset = PAGE_DATA_SIZE - (SLOT_SIZE + META_INFO);
 
     // enter the offset first which is zero because its the first record in a page
     int offset = 0;
@@ -730,10 +929,8 @@ void RecordBasedFileManager::setUpNewPage(void *newPage
     memcpy((char *) newPage + F_OFFSET, &freeSpaceOffset, sizeof(int));
 
 
-    // lets setup the freeSpace list in th fileHandle, we don't need a page number
-    // because we are making a new page and we just append the end of the list
-    int freeSpace = PAGE_SIZE - (freeSpaceOffset + SLOT_SIZE + META_INFO);
-    handle.freeSpace.push_back(freeSpace);
+    // the caller puts it in the freeSpace list once it knows where the page went
+    return PAGE_DATA_SIZE - (freeSpaceOffset + SLOT_SIZE + META_INFO);
 }
 
 int RecordBasedFileManager::extractFreeSpaceOffset(const void *page) {
@@ -758,15 +955,16 @@ void RecordBasedFileManager::compactMemory(int offset, int deletedLength, void *
     memset((char *) data + newFreeSpaceOffset, 0, deletedLength);
 
     // reduce the number of records by 1
-    int numRecords = decrementNumRecords(data);
+    decrementNumRecords(data);
 
-    // now we need to update all slots with their new offsets
-    signed int recordOffset;
-    int startOfSlotDirectoryOffset = getStartOfDirectoryOffset(numRecords, data);
-    int endOfSlotDirectoryOffset = PAGE_SIZE - META_INFO;
+    // now we need to update all slots with their new offsets, tombstones and pointers have none
+    signed int recordOffset, recordLength;
+    int startOfSlotDirectoryOffset = getStartOfDirectoryOffset(data);
+    int endOfSlotDirectoryOffset = PAGE_DATA_SIZE - META_INFO;
     while (startOfSlotDirectoryOffset < endOfSlotDirectoryOffset) {
         memcpy(&recordOffset, (char *) data + startOfSlotDirectoryOffset, sizeof(int));
-        if (recordOffset >= startOfCompaction) {
+        memcpy(&recordLength, (char *) data + startOfSlotDirectoryOffset + sizeof(int), sizeof(int));
+        if (recordLength > 0 && recordOffset >= startOfCompaction) {
             recordOffset -= deletedLength;
             memcpy((char *) data + startOfSlotDirectoryOffset, &recordOffset, sizeof(int));
         }
@@ -777,31 +975,181 @@ void RecordBasedFileManager::compactMemory(int offset, int deletedLength, void *
     free(dataBeingShifted);
 }
 
-int RecordBasedFileManager::getStartOfDirectoryOffset(int numRecords, const void* page) {
-    int currentOffset = N_OFFSET;
-    int slotNum = 0;
+int RecordBasedFileManager::getStartOfDirectoryOffset(const void* page) {
+    // the directory grows down from the header one slot at a time
+    return PAGE_DATA_SIZE - ((extractNumSlots(page) * SLOT_SIZE) + META_INFO);
+}
 
-    while (numRecords > 0) {
-        // Pull out the slot information
-        int offset, length;
-        RecordBasedFileManager::getSlotFile(slotNum, page, &offset, &length);
+// Scan conditions, one type for each attribute type and operator. The
+// operator is a constant of the type, so the switch in compareTo folds away
+// and the whole test inlines into the scan loop that nextMatch makes for it
+template <CompOp op, class T>
+static inline bool compareTo(T left, T right) {
+    switch(op) {
+        case EQ_OP:     return left == right;
+        case LT_OP:     return left < right;
+        case GT_OP:     return left > right;
+        case LE_OP:     return left <= right;
+        case GE_OP:     return left >= right;
+        case NE_OP:     return left != right;
+        default:        return true;
+    }
+}
 
-        // test if it is a record
-        if (length != 0) {
-            numRecords--;
+// NO_OP takes every record without looking at the condition attribute
+struct NoCondition {
+    NoCondition(const ScanCondition &condition) {}
+    bool operator()(const RecordView &record) const { return true; }
+};
+
+// a record whose condition attribute is null meets no condition
+template <CompOp op>
+struct IntCondition {
+    int field;
+    int value;
+    IntCondition(const ScanCondition &condition) : field(condition.field), value(condition.intValue) {}
+    bool operator()(const RecordView &record) const {
+        return !record.isNull(field) && compareTo<op>(record.getInt(field), value);
+    }
+};
+
+template <CompOp op>
+struct RealCondition {
+    int field;
+    float value;
+    RealCondition(const ScanCondition &condition) : field(condition.field), value(condition.realValue) {}
+    bool operator()(const RecordView &record) const {
+        return !record.isNull(field) && compareTo<op>(record.getReal(field), value);
+    }
+};
+
+// strings compare in place, a string before any longer one it starts
+template <CompOp op>
+struct VarCharCondition {
+    int field;
+    const char *value;
+    int length;
+    VarCharCondition(const ScanCondition &condition)
+        : field(condition.field), value(condition.varCharValue.data()), length(condition.varCharValue.size()) {}
+    bool operator()(const RecordView &record) const {
+        if (record.isNull(field)) {
+            return false;
         }
-        currentOffset -= SLOT_SIZE;
-        slotNum++;
+        int recordLength = record.getVarCharLength(field);
+        int cmp = memcmp(record.getVarChar(field), value, min(recordLength, length));
+        return compareTo<op>(cmp == 0 ? recordLength - length : cmp, 0);
     }
+};
+
+// a scan on several conditions tests its terms one after the other. A group
+// gives up at its first term that fails, the record is taken at the first
+// group whose terms all hold
+struct ConditionGroups {
+    const ScanCondition *terms;
+    int numTerms;
+    ConditionGroups(const ScanCondition &condition)
+        : terms(condition.terms->data()), numTerms(condition.terms->size()) {}
+    bool operator()(const RecordView &record) const {
+        for (int i = 0; i < numTerms; ) {
+            const ScanCondition &term = terms[i];
+            if (!term.holds(term, record)) {
+                i = term.nextGroup;
+            } else if (++i == term.nextGroup) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// the test of one term of a scan on several conditions
+template <class Predicate>
+static bool holds(const ScanCondition &condition, const RecordView &record) {
+    return Predicate(condition)(record);
+}
 
-    return currentOffset;
+typedef bool (*TermTest)(const ScanCondition &condition, const RecordView &record);
+
+template <template <CompOp> class Predicate>
+static TermTest holdsFor(CompOp op) {
+    switch(op) {
+        case EQ_OP:     return &holds<Predicate<EQ_OP> >;
+        case LT_OP:     return &holds<Predicate<LT_OP> >;
+        case GT_OP:     return &holds<Predicate<GT_OP> >;
+        case LE_OP:     return &holds<Predicate<LE_OP> >;
+        case GE_OP:     return &holds<Predicate<GE_OP> >;
+        case NE_OP:     return &holds<Predicate<NE_OP> >;
+        default:        return NULL;
+    }
+}
+
+// Nothing is known of the data, so these are the usual guesses: an equality
+// takes a tenth of the records, a range a third, an inequality nearly all.
+// A string costs more to test than a number, and more the longer it is
+static float estimateSelectivity(const ScanCondition &condition) {
+    switch(condition.op) {
+        case EQ_OP:     return 0.1;
+        case NE_OP:     return 0.9;
+        default:        return 1.0 / 3;
+    }
+}
+
+static float estimateCost(const ScanCondition &condition) {
+    return condition.type == TypeVarChar ? 2 + condition.varCharValue.size() / 16.0 : 1;
+}
+
+// in a group the term that fails most often for the least work goes first
+static bool rejectsSooner(const ScanCondition &left, const ScanCondition &right) {
+    return estimateCost(left) / (1 - estimateSelectivity(left)) < estimateCost(right) / (1 - estimateSelectivity(right));
+}
+
+// decode a condition on an attribute of the record, the value is copied so
+// the caller may reuse its buffer while we scan. NO_OP needs no attribute
+static RC decodeCondition(const vector<Attribute> &recordDescriptor, const ScanPredicate &predicate, ScanCondition &condition) {
+    condition.field = -1;
+    condition.type = TypeInt;
+    condition.op = predicate.op;
+    condition.terms = NULL;
+    condition.holds = NULL;
+    condition.nextGroup = 0;
+    if (predicate.op == NO_OP) {
+        return 0;
+    }
+    for (auto it = recordDescriptor.begin(); it != recordDescriptor.end(); ++it) {
+        if (it->name == predicate.attribute) {
+            condition.field = it - recordDescriptor.begin();
+            condition.type = it->type;
+            break;
+        }
+    }
+    if (condition.field == -1 || predicate.value == NULL) {
+        return -1;
+    }
+
+    if (condition.type == TypeInt) {
+        memcpy(&condition.intValue, predicate.value, sizeof(int));
+        condition.holds = holdsFor<IntCondition>(predicate.op);
+    } else if (condition.type == TypeReal) {
+        memcpy(&condition.realValue, predicate.value, sizeof(float));
+        condition.holds = holdsFor<RealCondition>(predicate.op);
+    } else if (condition.type == TypeVarChar) {
+        int length;
+        memcpy(&length, predicate.value, sizeof(int));
+        condition.varCharValue.assign((const char *) predicate.value + sizeof(int), length);
+        condition.holds = holdsFor<VarCharCondition>(predicate.op);
+    }
+    return condition.holds == NULL ? -1 : 0;
 }
 
 RBFM_ScanIterator::RBFM_ScanIterator() {
+    handle = NULL;
     pageNum = 0;
     slotNum = 0;
     scanPage = NULL;
-    value = NULL;
+    condition.field = -1;
+    condition.terms = NULL;
+    condition.holds = NULL;
+    nextRecord = &RBFM_ScanIterator::nextMatch<NoCondition>;
 }
 
 RBFM_ScanIterator::~RBFM_ScanIterator() {
@@ -813,39 +1161,53 @@ RC RecordBasedFileManager::scan(FileHandle &fileHandle, const vector<Attribute>
                                         const string &conditionAttribute, const CompOp compOp,
                                         const void *value, const vector<string> &attributeNames,
                                         RBFM_ScanIterator &rbfm_ScanIterator) {
+    ScanPredicate predicate = { conditionAttribute, compOp, value };
+    return scan(fileHandle, recordDescriptor, ScanConjunction(1, predicate), attributeNames, rbfm_ScanIterator);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                                        const ScanConjunction &conditions, const vector<string> &attributeNames,
+                                        RBFM_ScanIterator &rbfm_ScanIterator) {
+    return scan(fileHandle, recordDescriptor, vector<ScanConjunction>(1, conditions), attributeNames, rbfm_ScanIterator);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                                        const vector<ScanConjunction> &groups, const vector<string> &attributeNames,
+                                        RBFM_ScanIterator &rbfm_ScanIterator) {
     // first lets attach the fileHandle to the scanner iterater
     rbfm_ScanIterator.setHandle(fileHandle);
-    rbfm_ScanIterator.setCompOp(compOp);
-    rbfm_ScanIterator.setValue(value);
     rbfm_ScanIterator.setSlot(0);
-    rbfm_ScanIterator.setPage(0);
+    rbfm_ScanIterator.setPage(nextDataPage(0));
     rbfm_ScanIterator.emptyAttrPlacement();
     rbfm_ScanIterator.emptyAttrTypes();
+    rbfm_ScanIterator.setScanPage(NULL);
 
-    // add the the first page to scanPage and set pageNum and slotNUm
-    if ((int ) fileHandle.currentPageNum == rbfm_ScanIterator.getPageNum()) {
-        rbfm_ScanIterator.setScanPage(fileHandle.currentPage);
-    } else {
-        // need to create a temp page cause scanPage is private
-        void *_tempScan = malloc(PAGE_SIZE);
-        if (fileHandle.readPage(rbfm_ScanIterator.getPageNum(), _tempScan) == -1) {
-            free(_tempScan);
-            return RBFM_EOF;
+    // decode the conditions once
+    int i;
+    vector<vector<ScanCondition> > decoded(groups.size());
+    for (unsigned g = 0; g < groups.size(); g++) {
+        decoded[g].resize(groups[g].size());
+        for (unsigned p = 0; p < groups[g].size(); p++) {
+            if (decodeCondition(recordDescriptor, groups[g][p], decoded[g][p]) == -1) {
+                return -1;
+            }
         }
-        rbfm_ScanIterator.setScanPage(_tempScan);
+    }
+    if (rbfm_ScanIterator.setConditions(decoded) == -1) {
+        return -1;
     }
 
+    // pin the first page, the scan walks it in place instead of copying it
+    void *_tempScan = NULL;
+    if (fileHandle.pinPage(rbfm_ScanIterator.getPageNum(), _tempScan) == -1) {
+        return RBFM_EOF;
+    }
+    rbfm_ScanIterator.setScanPage(_tempScan);
+
     // collect the attribute placements for each record
-    int i;
-    bool foundCondition = false;
     for (auto itN = attributeNames.begin(); itN != attributeNames.end(); ++itN) {
         for (auto it = recordDescriptor.begin(); it != recordDescriptor.end(); ++it) {
             i = it - recordDescriptor.begin();
-            if (!foundCondition && it->name == conditionAttribute) {
-                rbfm_ScanIterator.setCondType(it->type);
-                rbfm_ScanIterator.setConditionAttr(i);
-                foundCondition = true;
-            }
             if (strcmp(it->name.c_str(), itN->c_str()) == 0) {
                 rbfm_ScanIterator.setAttrTypes(it->type);
                 rbfm_ScanIterator.setAttrPlacement(i);
@@ -855,264 +1217,239 @@ RC RecordBasedFileManager::scan(FileHandle &fileHandle, const vector<Attribute>
     return 0;
 }
 
-bool RBFM_ScanIterator::isEndOfPage(void *page, int numRecords, int slotNum, int pageNum) {
-    int startOfSlotDirectoryOffset = RecordBasedFileManager::getStartOfDirectoryOffset(numRecords, page);
-    int currentSlotOffset = PAGE_SIZE - (((slotNum + 1) * SLOT_SIZE) + META_INFO);
-    if (startOfSlotDirectoryOffset > currentSlotOffset)
-       return true;
-   return false;
+RC RBFM_ScanIterator::setConditions(vector<vector<ScanCondition> > &groups) {
+    terms.clear();
+    condition.field = -1;
+    condition.terms = NULL;
+    nextRecord = &RBFM_ScanIterator::nextMatch<NoCondition>;
+
+    // NO_OP holds for every record, a group left with no condition takes them all
+    vector<pair<float, int> > order;
+    for (unsigned g = 0; g < groups.size(); g++) {
+        vector<ScanCondition> &group = groups[g];
+        for (auto it = group.begin(); it != group.end(); ) {
+            it = it->op == NO_OP ? group.erase(it) : it + 1;
+        }
+        if (group.empty()) {
+            return 0;
+        }
+
+        // what testing the group costs and takes, the later terms are only tested
+        // on the records the earlier ones let through
+        stable_sort(group.begin(), group.end(), rejectsSooner);
+        float cost = 0;
+        float selectivity = 1;
+        for (auto it = group.begin(); it != group.end(); ++it) {
+            cost += selectivity * estimateCost(*it);
+            selectivity *= estimateSelectivity(*it);
+        }
+        order.push_back(make_pair(cost / selectivity, g));
+    }
+    if (groups.empty()) {
+        return 0;
+    }
+
+    // one condition runs in the loop made for its type and operator
+    if (groups.size() == 1 && groups[0].size() == 1) {
+        condition = groups[0][0];
+        if (condition.type == TypeInt) {
+            nextRecord = forOperator<IntCondition>(condition.op);
+        } else if (condition.type == TypeReal) {
+            nextRecord = forOperator<RealCondition>(condition.op);
+        } else {
+            nextRecord = forOperator<VarCharCondition>(condition.op);
+        }
+        return 0;
+    }
+
+    // the groups that take records most often for the least work go first
+    stable_sort(order.begin(), order.end());
+    for (auto it = order.begin(); it != order.end(); ++it) {
+        const vector<ScanCondition> &group = groups[it->second];
+        terms.insert(terms.end(), group.begin(), group.end());
+        for (unsigned t = terms.size() - group.size(); t < terms.size(); t++) {
+            terms[t].nextGroup = terms.size();
+        }
+    }
+    condition.terms = &terms;
+    nextRecord = &RBFM_ScanIterator::nextMatch<ConditionGroups>;
+    return 0;
+}
+
+template <template <CompOp> class Predicate>
+RBFM_ScanIterator::NextRecord RBFM_ScanIterator::forOperator(CompOp op) {
+    switch(op) {
+        case EQ_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<EQ_OP> >;
+        case LT_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<LT_OP> >;
+        case GT_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<GT_OP> >;
+        case LE_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<LE_OP> >;
+        case GE_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<GE_OP> >;
+        case NE_OP:     return &RBFM_ScanIterator::nextMatch<Predicate<NE_OP> >;
+        default:        return NULL;
+    }
+}
+
+bool RBFM_ScanIterator::isEndOfPage(void *page, int slotNum) {
+    return slotNum >= RecordBasedFileManager::extractNumSlots(page);
 }
 
 // get the next record
 RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
-    bool condNotMet = true;
-    int numRecords = RecordBasedFileManager::extractNumRecords(scanPage);
-    int rc = RBFM_EOF;
+    if (scanPage == NULL) {
+        return RBFM_EOF;
+    }
+    return (this->*nextRecord)(NULL, rid, data);
+}
 
-    // we have to check for empty slots
-    while (condNotMet) {
-        // if we on on the last page and at the end of the page end this search
-        if ((unsigned) pageNum == handle->currentPageNum && isEndOfPage(scanPage, numRecords, slotNum, pageNum)) {
-            condNotMet = false;
-            rc = RBFM_EOF;
-            continue;
-        }
+// get the next records, the latch and the page checks are paid once for all of them
+RC RBFM_ScanIterator::getNextBatch(RecordBatch &batch) {
+    batch.clear();
+    if (scanPage == NULL) {
+        return RBFM_EOF;
+    }
+    RID rid;
+    return (this->*nextRecord)(&batch, rid, NULL);
+}
+
+template <class Predicate>
+RC RBFM_ScanIterator::nextMatch(RecordBatch *batch, RID &rid, void *data) {
+    // the page stays pinned between calls but is only looked at under the file latch
+    FileLatchGuard latch(*handle, false);
+    const Predicate matches(condition);
 
+    // we have to check for empty slots
+    while (true) {
         // check for end of the page and load new page if needed
-        if (isEndOfPage(scanPage, numRecords, slotNum, pageNum)) {
-            handle->readPage(++pageNum, scanPage);
-            numRecords = RecordBasedFileManager::extractNumRecords(scanPage);
+        if (isEndOfPage(scanPage, slotNum)) {
+            // if we on on the last page this search is over
+            if (RecordBasedFileManager::nextDataPage(pageNum) >= handle->getNumberOfPages()) {
+                return batch != NULL && batch->size() > 0 ? 0 : RBFM_EOF;
+            }
+            handle->unpinPage(pageNum, false);
+            scanPage = NULL;
+            // free space map pages hold no records
+            pageNum = RecordBasedFileManager::nextDataPage(pageNum);
+            // the handle sees the pages come in order and reads ahead of us
+            if (handle->pinPage(pageNum, scanPage) == -1) {
+                return -1;
+            }
             slotNum = 0;
+            continue;
         }
-        // enter in the rid info
-        rid.pageNum = pageNum;
-        rid.slotNum = slotNum++;
 
-        // check for NULL Fields and make sure they are null
-        int offset, length;
-        RecordBasedFileManager::getSlotFile(rid.slotNum, scanPage, &offset, &length);
-
-        if (length <= 0) {
-            // this means the slot is a tombstone or its a pointer to another page
+        // look at the record where it lies in the page
+        RecordView record;
+        int currentSlot = slotNum++;
+        if (!record.fromSlot(scanPage, currentSlot) || !matches(record)) {
+            // a tombstone, a pointer to another page or a record that fails the condition
             continue;
         }
-        // extract the record in the slot
-        void *record = RecordBasedFileManager::extractRecord(rid.slotNum, scanPage);
-
-        short numFields = RecordBasedFileManager::getNumberOfFields(record);
-        int numNullBytes = ceil((double) numFields / CHAR_BIT);
-        void *nullField = malloc(numNullBytes);
-        memcpy((char *) nullField, (char *) record + FIELD_OFFSET, numNullBytes);
-
-        if(RecordBasedFileManager::isFieldNull(nullField, conditionAttribute)) {
-            // this means the field we are trying to COMP is NULL
-            /******* TODO: what if we have a NO-OP? ********/
-            free(record);
-            free(nullField);
-            continue;
+
+        // enter in the rid info and extract the attributes
+        if (batch == NULL) {
+            rid.pageNum = pageNum;
+            rid.slotNum = currentSlot;
+            extractScannedData(record, data);
+            return 0;
         }
 
-        // we need to determine the offset of condition attribute and extract where it starts
-        short startOfCondOffset;
-        int condFieldOffset;
-        condFieldOffset = FIELD_OFFSET + numNullBytes + (conditionAttribute * FIELD_OFFSET);
-        memcpy(&startOfCondOffset, (char *) record + condFieldOffset, FIELD_OFFSET);
-
-        // test the condition we need to extract
-        bool isCompTrue;
-
-        // here we need to run the comparison functions with the data
-        if (condType == TypeInt) {
-            isCompTrue = processIntComp(startOfCondOffset, compOp, value, record);
-        } else if (condType == TypeReal) {
-            isCompTrue = processFloatComp(startOfCondOffset, compOp, value, record);
-        } else if (condType == TypeVarChar) {
-            isCompTrue = processStringComp(startOfCondOffset, compOp, value, record);
-        } else {
-            // this is bad
+        // the projection is never longer than the record and its null bytes
+        char *out = batch->reserve(record.getLength() + (attrPlacement.size() + CHAR_BIT - 1) / CHAR_BIT);
+        if (out == NULL) {
             return -1;
         }
-        if (isCompTrue) {
-            // extract the attributes
-            extractScannedData(record, data, length, numFields, nullField);
-
-            condNotMet = false;
-            rc = 0;
+        batch->append(pageNum, currentSlot, extractScannedData(record, out));
+        if (batch->isFull()) {
+            return 0;
         }
-        free(record);
-        free(nullField);
     }
-    return rc;
 }
 
 RC RBFM_ScanIterator::close() {
+    if (scanPage != NULL && handle != NULL)
+        handle->unpinPage(pageNum, false);
+    scanPage = NULL;
+
     handle = NULL;
     attrPlacement.clear();
     attrTypes.clear();
+    terms.clear();
 
     pageNum = 0;
     slotNum = 0;
-    if (scanPage != NULL)
-        free(scanPage);
 
     return 0;
 }
 
-bool RBFM_ScanIterator::processIntComp(int condOffset, CompOp compOp, const void *value, const void *record) {
-    if (compOp == NO_OP) {
-        return true;
-    }
-    int intVal;
-    memcpy(&intVal, (char *) value, sizeof(int));
-
-    int recordVal;
-    memcpy(&recordVal, (char *) record + condOffset, sizeof(int));
+int RBFM_ScanIterator::extractScannedData(const RecordView &record, void *data) {
+    // the null bytes of the projected attributes go first
+    int sizeOfReturnAttrs = attrPlacement.size();
+    int newNumBytes = (sizeOfReturnAttrs + CHAR_BIT - 1) / CHAR_BIT;
+    unsigned char *newNullField = (unsigned char *) data;
+    memset(newNullField, 0, newNumBytes);
+    int dataOffset = newNumBytes;
 
-    switch(compOp) {
-        case EQ_OP:     return recordVal == intVal;
-        case LT_OP:     return recordVal < intVal;
-        case GT_OP:     return recordVal > intVal;
-        case LE_OP:     return recordVal <= intVal;
-        case GE_OP:     return recordVal >= intVal;
-        case NE_OP:     return recordVal != intVal;
-        default:        return false;
+    // then each attribute that is not null, straight out of the page. The
+    // field offsets give the length whatever the type
+    for (int i = 0; i < sizeOfReturnAttrs; ++i) {
+        int attrSpot = attrPlacement[i];
+        if (record.isNull(attrSpot)) {
+            newNullField[i / CHAR_BIT] |= 0x80 >> (i % CHAR_BIT);
+            continue;
+        }
+        int fieldLength = record.getFieldLength(attrSpot);
+        memcpy((char *) data + dataOffset, record.getField(attrSpot), fieldLength);
+        dataOffset += fieldLength;
     }
+    return dataOffset;
 }
 
 
-bool RBFM_ScanIterator::processFloatComp(int condOffset, CompOp compOp, const void *value, const void *record) {
-    if (compOp == NO_OP) {
-        return true;
-    }
-
-    float floatVal;
-    memcpy(&floatVal, (char *) value, sizeof(float));
-
-    float recordVal;
-    memcpy(&recordVal, (char *) record + condOffset, sizeof(float));
-
-    switch(compOp) {
-        case EQ_OP:     return recordVal == floatVal;
-        case LT_OP:     return recordVal < floatVal;
-        case GT_OP:     return recordVal > floatVal;
-        case LE_OP:     return recordVal <= floatVal;
-        case GE_OP:     return recordVal >= floatVal;
-        case NE_OP:     return recordVal != floatVal;
-        default:        return false;
+bool RecordView::fromSlot(const void *page, int slotNum) {
+    int offset, length;
+    RecordBasedFileManager::getSlotFile(slotNum, page, &offset, &length);
+    if (length <= 0) {
+        return false;
     }
+    *this = RecordView((char *) page + offset, length);
+    return true;
 }
 
 
-bool RBFM_ScanIterator::processStringComp(int condOffset, CompOp compOp, const void *value, const void *record) {
-    if (compOp == NO_OP) {
-        return true;
-    }
-
-    int valueLength;
-    memcpy(&valueLength, (char *) value, sizeof(int));
-
-    // now generate a C string with the same length plus 1
-    char* s = new char[valueLength + 1];
-    memcpy(s, (char *) value + sizeof(int), valueLength);
-    s[valueLength] = '\0';
-
-    int varCharLength;
-    memcpy(&varCharLength, (char *) record + condOffset, sizeof(int));
-    condOffset += sizeof(int);
-
-    char* sv = new char[varCharLength + 1];
-    memcpy(sv, (char *) record + condOffset, varCharLength);
-    sv[varCharLength] = '\0';
-
-    bool returnVal;
-    switch(compOp) {
-        case 0:     returnVal = true;
-                    break;
-        case 1:     returnVal = strcmp(s, sv) == 0 ? true : false;
-                    break;
-        case 2:     returnVal = strcmp(s, sv) < 0 ? true : false;
-                    break;
-        case 3:     returnVal = strcmp(s, sv) > 0 ? true : false;
-                    break;
-        case 4:     returnVal = strcmp(s, sv) < 0 || strcmp(s, sv) == 0 ? true : false;
-                    break;
-        case 5:     returnVal = strcmp(s, sv) > 0 || strcmp(s, sv) == 0 ? true : false;
-                    break;
-        case 6:     returnVal = strcmp(s, sv) != 0 ? true : false;
-                    break;
-        default:    returnVal = false;
-                    break;
-    }
-    delete []s;
-    delete []sv;
-    return returnVal;
+RecordBatch::RecordBatch(unsigned capacity) : capacity(capacity > 0 ? capacity : 1), data(NULL), dataSize(0) {
+    rids.reserve(this->capacity);
+    offsets.reserve(this->capacity + 1);
+    offsets.push_back(0);
 }
 
+RecordBatch::~RecordBatch() {
+    free(data);
+}
 
-void RBFM_ScanIterator::extractScannedData(void *record, void *data, int length, int numFields, void *nullField) {
-    // go through each placement and extract that data
-    int sizeOfReturnAttrs = attrPlacement.size();
-    AttrType currentType;
-    int attrSpot;
-
-    // lets create our nullFields
-    int newNumBytes = ceil((double) sizeOfReturnAttrs / CHAR_BIT);
-    char *newNullField = new char[newNumBytes];
-    memset(newNullField, 0, newNumBytes);
-
-    // make room for the data, we know the returned value will be at max the size of the record
-    void *tempData = malloc(length);
-    int tempDataOffset = 0;
-
-    // get the old offsets
-    int numNullBytes = ceil((double) numFields / CHAR_BIT);
-    short startOfFieldOffset = FIELD_OFFSET + numNullBytes;
-
-    for (int i = 0; i < sizeOfReturnAttrs; ++i) {
-        // lets extract the first
-        currentType = attrTypes[i];
-        attrSpot = attrPlacement[i];
-        short fieldOffset = startOfFieldOffset + (attrSpot * FIELD_OFFSET);
-        short dataOffset;
-        memset(&dataOffset, 0, sizeof(short));
-        memcpy(&dataOffset, (char *) record + fieldOffset, sizeof(short));
-
-        // lets extract the data we need to get the next attribute
-        if (RecordBasedFileManager::isFieldNull(nullField, attrSpot)) {
-            newNullField[0] = (1 << 7);
-            newNullField[0] >>= attrSpot;
-            continue;
-        }
-
-
-        // Here we begin putting the field data into a temp holder
-        if (currentType == TypeInt) {
-            memcpy((char *) tempData + tempDataOffset, (char *) record + dataOffset, sizeof(int));
-            tempDataOffset += sizeof(int);
-        } else if (currentType == TypeReal) {
-            memcpy((char *) tempData + tempDataOffset, (char *) record + dataOffset, sizeof(float));
-            tempDataOffset += sizeof(float);
-        } else if (currentType == TypeVarChar) {
-            int varCharLength;
-            memcpy(&varCharLength, (char *) record + dataOffset, sizeof(int));
-            memcpy((char *) tempData + tempDataOffset, &varCharLength, sizeof(int));
-            memcpy((char *) tempData + tempDataOffset + sizeof(int)
-                                        , (char *) record + dataOffset + sizeof(int), varCharLength);
+void RecordBatch::clear() {
+    rids.clear();
+    offsets.resize(1);
+}
 
-            tempDataOffset += sizeof(int) + varCharLength;
-        } else {
-            // should not get here
+char *RecordBatch::reserve(unsigned length) {
+    unsigned used = offsets.back();
+    if (used + length > dataSize) {
+        // grow by doubling, a batch of small records settles in a page or two
+        unsigned newSize = max(max(dataSize * 2, used + length), (unsigned) PAGE_SIZE);
+        char *grown = (char *) realloc(data, newSize);
+        if (grown == NULL) {
+            return NULL;
         }
-    } // end of for loop
-    // now we can piece together all the data, this will only work if RM layer
-    // initializes returnData with NULL
-    /********* NOT SURE IF I NEED TO ALLOCATE HERE *************/
-
-    memcpy((char *) data, newNullField, newNumBytes);
-    memcpy((char *) data + newNumBytes, (char *) tempData, tempDataOffset);
-
-    delete []newNullField;
-    free(tempData);
+        data = grown;
+        dataSize = newSize;
+    }
+    return data + used;
 }
 
-
+void RecordBatch::append(int pageNum, int slotNum, unsigned length) {
+    RID rid;
+    rid.pageNum = pageNum;
+    rid.slotNum = slotNum;
+    rids.push_back(rid);
+    offsets.push_back(offsets.back() + length);
+}
@@ -22,6 +22,22 @@ using namespace std;
 // Constants
 const int RECORD_ATTR_OFFSET_SIZE = 4;
 
+// Free space map: every FSM_INTERVAL pages, starting at page 0, the file holds a
+// page of 2 byte entries with the free bytes of the data pages that follow it.
+// Entry 0 is the map page itself and holds FSM_MAGIC. A page deleteRecord gave
+// back to the file with freePage has no room until reusePage hands it out, its
+// slot directory of tombstones still in it.
+typedef unsigned short fsm_entry;
+const unsigned FSM_INTERVAL = PAGE_DATA_SIZE / sizeof(fsm_entry);
+const fsm_entry FSM_MAGIC = 0xF5A1;
+
+// An insert that does not fit the last page looks at up to this many pages
+// with room, lowest first, and takes the first one the buffer pool holds
+const unsigned FIT_CANDIDATES = 8;
+
+// Records RBFM_ScanIterator::getNextBatch hands out at once by default
+const unsigned RECORD_BATCH_SIZE = 256;
+
 // Typedefs for record data sizes
 typedef short f_data;   // field data size
 typedef int s_data;;     // slot data size
@@ -75,6 +91,149 @@ The scan iterator is NOT required to be implemented for part 1 of the project
 // function helpers for scan Iterator
 
 
+// A record as it is kept on a page: the number of fields, the null bytes, the
+// offset of every field from the start of the record, then the field data in
+// the format insertRecord takes it. The view reads all of it in place and is
+// only good while the page stays pinned. Fields past the end of an older
+// record count as null
+class RecordView
+{
+public:
+    RecordView() : record(NULL), length(0), numFields(0), numNullBytes(0) {};
+    RecordView(const void *record, int length);
+
+    bool fromSlot(const void *page, int slotNum);                       // false for a tombstone or a pointer to another page
+
+    const char *getRecord() const { return record; };
+    int getLength() const { return length; };
+    int getNumFields() const { return numFields; };
+    int getNumNullBytes() const { return numNullBytes; };
+    const unsigned char *getNullBytes() const { return (const unsigned char *) record + FIELD_OFFSET; };
+    int getDataOffset() const { return FIELD_OFFSET + numNullBytes + numFields * FIELD_OFFSET; };    // Where the field data starts
+    bool isNull(int field) const;
+    int getFieldOffset(int field) const;                                // From the start of the record
+    int getFieldLength(int field) const;                                // 0 for a null field
+    const char *getField(int field) const { return record + getFieldOffset(field); };
+    int getInt(int field) const;
+    float getReal(int field) const;
+    int getVarCharLength(int field) const { return getInt(field); };
+    const char *getVarChar(int field) const { return getField(field) + sizeof(int); };     // Not terminated
+
+private:
+    const char *record;
+    int length;
+    int numFields;
+    int numNullBytes;
+};
+
+inline RecordView::RecordView(const void *record, int length) : record((const char *) record), length(length)
+{
+    f_data fields;
+    memcpy(&fields, record, FIELD_OFFSET);
+    numFields = fields;
+    numNullBytes = (numFields + CHAR_BIT - 1) / CHAR_BIT;
+}
+
+inline bool RecordView::isNull(int field) const
+{
+    return field >= numFields || (getNullBytes()[field / CHAR_BIT] & (0x80 >> (field % CHAR_BIT))) != 0;
+}
+
+inline int RecordView::getFieldOffset(int field) const
+{
+    f_offset offset;
+    memcpy(&offset, record + FIELD_OFFSET + numNullBytes + field * FIELD_OFFSET, FIELD_OFFSET);
+    return offset;
+}
+
+inline int RecordView::getFieldLength(int field) const
+{
+    if (field >= numFields) {
+        return 0;
+    }
+    int end = field + 1 == numFields ? length : getFieldOffset(field + 1);
+    return end - getFieldOffset(field);
+}
+
+inline int RecordView::getInt(int field) const
+{
+    int value;
+    memcpy(&value, getField(field), sizeof(int));
+    return value;
+}
+
+inline float RecordView::getReal(int field) const
+{
+    float value;
+    memcpy(&value, getField(field), sizeof(float));
+    return value;
+}
+
+
+// Records a scan hands out a batch at a time: their RIDs, and their projected
+// data in the format getNextRecord gives it, one after the other in a single
+// buffer. Record i lies from offsets[i] to offsets[i + 1]. The buffer grows
+// to fit and is kept from one batch to the next
+class RecordBatch
+{
+public:
+    RecordBatch(unsigned capacity = RECORD_BATCH_SIZE);
+    ~RecordBatch();
+
+    unsigned size() const { return rids.size(); };
+    unsigned getCapacity() const { return capacity; };
+    bool isFull() const { return rids.size() >= capacity; };
+    const RID &getRID(unsigned i) const { return rids[i]; };
+    const void *getData(unsigned i) const { return data + offsets[i]; };
+    unsigned getLength(unsigned i) const { return offsets[i + 1] - offsets[i]; };
+    void clear();
+
+private:
+    friend class RBFM_ScanIterator;
+    unsigned capacity;
+    vector<RID> rids;
+    vector<unsigned> offsets;           // one more than there are records
+    char *data;
+    unsigned dataSize;
+
+    char *reserve(unsigned length);     // Room for the next record, NULL if it cannot be had
+    void append(int pageNum, int slotNum, unsigned length);
+
+    RecordBatch(const RecordBatch &);
+    RecordBatch &operator=(const RecordBatch &);
+};
+
+
+// One condition of a scan on several, the value in the format insertRecord
+// takes it. NO_OP holds for every record and needs no attribute or value
+struct ScanPredicate
+{
+    string attribute;
+    CompOp op;
+    const void *value;
+};
+
+typedef vector<ScanPredicate> ScanConjunction;      // every predicate has to hold
+
+
+// The condition of a scan, decoded once by scan() from the value it was given
+struct ScanCondition
+{
+    int field;                  // placement of the condition attribute in the record
+    AttrType type;
+    CompOp op;
+    int intValue;
+    float realValue;
+    string varCharValue;        // the characters, without the length
+
+    // a scan on several conditions keeps them in terms, each with the test made
+    // for its type and operator and where the group after its own starts
+    const vector<ScanCondition> *terms;
+    bool (*holds)(const ScanCondition &condition, const RecordView &record);
+    int nextGroup;
+};
+
+
 class RBFM_ScanIterator {
 public:
 
@@ -83,16 +242,14 @@ public:
 
     // "data" follows the same format as RecordBasedFileManager::insertRecord()
     RC getNextRecord(RID &rid, void *data);
+    RC getNextBatch(RecordBatch &batch);                 // Up to its capacity, RBFM_EOF once no record is left
     RC close();
 
     // Getters and Setters
     void setHandle(FileHandle &fileHandle) { handle = &fileHandle; };
-    void setCompOp(const CompOp op) { compOp = op; };
-    void setValue(const void *val) { value = val; };
+    RC setConditions(vector<vector<ScanCondition> > &groups);     // tested cheapest and most selective first
     void setSlot(int i) { slotNum = i; };
     void setPage(int i) { pageNum = i; };
-    void setConditionAttr(int i) { conditionAttribute = i; };
-    void setCondType(AttrType type) { condType = type; };
     void setAttrPlacement(int i) { attrPlacement.push_back(i); };
     void emptyAttrPlacement() { attrPlacement.clear(); };
     void setAttrTypes(AttrType type) { attrTypes.push_back(type); };
@@ -106,20 +263,23 @@ private:
     FileHandle *handle;
     vector<int> attrPlacement;
     vector<AttrType> attrTypes;
-    const void *value;
     void *scanPage;
-    CompOp compOp;
-    AttrType condType;
-    int conditionAttribute;
     int pageNum;
     int slotNum;
 
-    int getCompOp(CompOp compOp);
-    bool processIntComp(int condOffset, CompOp compOp, const void *value, const void *record);
-    bool processFloatComp(int condOffset, CompOp compOp, const void *value, const void *record);
-    bool processStringComp(int condOffset, CompOp compOp, const void *value, const void *record);
-    void extractScannedData(void *record, void *data, int length, int numRecords, void *nullField);
-    bool isEndOfPage(void *page, int numRecords, int slotNum, int pageNum);
+    // getNextRecord and getNextBatch run the loop made for the type and
+    // operator of the condition, the test of each record is inlined into it.
+    // A scan on several conditions tests its terms in order in the loop.
+    // Without a batch the loop stops at the first record that matches
+    typedef RC (RBFM_ScanIterator::*NextRecord)(RecordBatch *batch, RID &rid, void *data);
+    ScanCondition condition;
+    vector<ScanCondition> terms;
+    NextRecord nextRecord;
+    template <class Predicate> RC nextMatch(RecordBatch *batch, RID &rid, void *data);
+    template <template <CompOp> class Predicate> static NextRecord forOperator(CompOp op);
+
+    int extractScannedData(const RecordView &record, void *data);
+    bool isEndOfPage(void *page, int slotNum);
 };
 
 
@@ -129,14 +289,18 @@ class RecordBasedFileManager
 public:
 	static RecordBasedFileManager* instance();
 
-	RC createFile(const string &fileName);
+	RC createFile(const string &fileName, bool compressed = false);   // compressed suits cold files that are mostly scanned
 
 	RC destroyFile(const string &fileName);
 
-	RC openFile(const string &fileName, FileHandle &fileHandle);
+	RC openFile(const string &fileName, FileHandle &fileHandle, IOMode ioMode = IO_PREAD);
 
 	RC closeFile(FileHandle &fileHandle);
 
+	RC shareFile(const string &fileName, FileHandle *&fileHandle);   // every user of a file gets its one open handle, see PagedFileManager
+
+	RC releaseFile(FileHandle *fileHandle);                           // the last user closes the file
+
     //  Format of the data passed into the function is the following:
     //  [n byte-null-indicators for y fields] [actual value for the first field] [actual value for the second field] ...
     //  1) For y fields, there is n-byte-null-indicators in the beginning of each record.
@@ -176,14 +340,29 @@ public:
         const vector<string> &attributeNames, // a list of projected attributes
         RBFM_ScanIterator &rbfm_ScanIterator);
 
+    // scan on several conditions tested on the record in the page before any of it
+    // is copied. A record comes back if every predicate of one of the groups holds,
+    // no group at all takes every record
+    RC scan(FileHandle &fileHandle,
+        const vector<Attribute> &recordDescriptor,
+        const vector<ScanConjunction> &groups,
+        const vector<string> &attributeNames,
+        RBFM_ScanIterator &rbfm_ScanIterator);
+
+    RC scan(FileHandle &fileHandle,
+        const vector<Attribute> &recordDescriptor,
+        const ScanConjunction &conditions,
+        const vector<string> &attributeNames,
+        RBFM_ScanIterator &rbfm_ScanIterator);
+
     static void getSlotFile(int slotNum, const void *page, int *offset, int *length);
     static bool isFieldNull(const void *data, int i);
     static int extractNumRecords(const void *page);
+    static int extractNumSlots(const void *page);
     static int extractFreeSpaceOffset(const void *page);
-    static void* extractRecord(int slotNum, const void *page);
-    static f_data getNumberOfFields(const void *record);
-    static int getFieldOffset(int location, int numNullBytes, const void *record);
-    static int getStartOfDirectoryOffset(int numRecords, const void* page);
+    static int getStartOfDirectoryOffset(const void* page);
+    static bool isFreeSpaceMapPage(PageNum pageNum) { return pageNum % FSM_INTERVAL == 0; };
+    static PageNum nextDataPage(PageNum pageNum) { return isFreeSpaceMapPage(pageNum + 1) ? pageNum + 2 : pageNum + 1; };
 
 public:
 
@@ -193,15 +372,17 @@ protected:
 
 private:
     static RecordBasedFileManager *_rbf_manager;
-    void *readingPage;
-    RID readingRID;
     PagedFileManager *pfm;
 
     void compactMemory(int offset, int deletedLength, void *data, int freeSpace);
     std::string extractType(const void *data, int *offset, AttrType t, AttrLength l);
-    int findOpenSlot(FileHandle &handle, int size, RID &rid);
+    RC findPageWithRoom(FileHandle &handle, int size, PageNum &pageNum);
+    RC removeRecord(FileHandle &handle, const RID &rid, PageNum keepPage);
+    RC removePointer(FileHandle &handle, const RID &rid);               // tombstone the slot of a forwarded record deleted on its page
+    RC releasePage(FileHandle &handle, PageNum pageNum);
+    static bool isEmptyPage(const void *page);                          // every slot of the directory is a tombstone
     int getFreeSpaceOffset(const void *data);
-    void setUpNewPage(void *newPage, const void *data, int length, FileHandle &handle, void *field, int fieldNumBytes, int recSize);
+    int setUpNewPage(void *newPage, const void *data, int length, void *field, int fieldNumBytes, int recSize);
     void updateSlotDirectory(RID &rid, int pageNum, int slotNum);
     int buildMetaData(const void *data, const vector<Attribute> &descriptor, void *field);
     void* determinePageToUse(const RID &rid, FileHandle &handle);
@@ -210,9 +391,15 @@ private:
     int decrementNumRecords(void *page);
     int incrementFreeSpaceOffset(void *page, int length);
     int decrementFreeSpaceOffset(void *page, int length);
-    void updateFreeSpace(int numRecords, int freeSpaceOffset, int pageNum, FileHandle &handle);
-    void extractFieldData(int numFields, int length, void *data, void *tempData);
-    int getSlot(const void *page, int freeSpace);
+    void updateFreeSpace(int numSlots, int freeSpaceOffset, int pageNum, FileHandle &handle);
+    RC setFreeSpace(FileHandle &handle, PageNum pageNum, int freeSpace);
+    RC appendFreeSpaceMapPage(FileHandle &handle);
+    RC loadFreeSpaceMap(FileHandle &handle);
+    void updateFreeSpaceTree(FileHandle &handle, PageNum pageNum);
+    void buildFreeSpaceTree(FileHandle &handle);
+    PageNum firstFit(FileHandle &handle, unsigned room, PageNum from);
+    int getSlot(void *page);
+    void freeSlot(void *page, int slotNum);
 };
 
 #endif
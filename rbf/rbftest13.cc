@@ -0,0 +1,123 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File
+   // 3. Append Page
+   // 4. Read Page (buffer pool hits and misses)
+   // 5. Pin / Unpin Page
+   // 6. Close File
+   cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+   RC rc;
+   string fileName = "test13";
+
+   unsigned hitCount = 0;
+   unsigned missCount = 0;
+   unsigned evictCount = 0;
+
+   // Create the file named "test13"
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   // Open the file "test13"
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   // Append 10 pages
+   void *data = malloc(PAGE_SIZE);
+   for(unsigned j = 0; j < 10; j++)
+   {
+       for(unsigned i = 0; i < PAGE_SIZE; i++)
+       {
+           *((char *)data+i) = i % (j+1) + 32;
+       }
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+
+   // Read every page twice, appended pages stay cached so all of these are hits
+   void *buffer = malloc(PAGE_SIZE);
+   for(unsigned k = 0; k < 2; k++)
+   {
+       for(unsigned j = 0; j < 10; j++)
+       {
+           rc = fileHandle.readPage(j, buffer);
+           assert(rc == success && "Reading a page should not fail.");
+       }
+   }
+   rc = fileHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+   assert(rc == success && "collectBufferCounterValues() should not fail.");
+   cout << "hits: " << hitCount << " misses: " << missCount << " evictions: " << evictCount << endl;
+   assert(hitCount >= 20 && "Reading cached pages should hit the buffer pool.");
+
+   // Modify page 3 in place through its frame
+   void *page = NULL;
+   rc = fileHandle.pinPage(3, page);
+   assert(rc == success && "Pinning a page should not fail.");
+   memset(page, 'x', PAGE_SIZE);
+   rc = fileHandle.unpinPage(3, true);
+   assert(rc == success && "Unpinning a page should not fail.");
+
+   // Close the file, the dirty frame has to reach the file
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Reopen the file and check page 3
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+
+   rc = fileHandle2.readPage(3, buffer);
+   assert(rc == success && "Reading a page should not fail.");
+   memset(data, 'x', PAGE_SIZE);
+   rc = memcmp(data, buffer, PAGE_SIZE);
+   assert(rc == success && "Checking the integrity of a page should not fail.");
+
+   // the pages are still in the pool after the first handle was closed
+   rc = fileHandle2.collectBufferCounterValues(hitCount, missCount, evictCount);
+   assert(rc == success && "collectBufferCounterValues() should not fail.");
+   assert(hitCount == 1 && missCount == 0 && "Pages should stay cached across open and close.");
+
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Destroy the file
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+   free(buffer);
+
+   cout << "[PASS] Test Case 13 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the functionality of the paged file manager
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test13");
+
+   RC rcmain = RBFTest_13(pfm);
+   return rcmain;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_14(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File (IO_MMAP)
+   // 3. Append Page past the initial mapping
+   // 4. Read Page (pointer into the mapping)
+   // 5. Write Page
+   // 6. Insert Record / Scan
+   // 7. Close File
+   cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+   RC rc;
+   string fileName = "test14";
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   // Create the file named "test14"
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   // Open the file "test14" with a mapping
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle, IO_MMAP);
+   assert(rc == success && "Opening the file should not fail.");
+
+   // Append enough pages to grow the mapping a few times
+   unsigned numPages = 4 * MMAP_MIN_PAGES + 1;
+   void *data = malloc(PAGE_SIZE);
+   const void *firstPage = NULL;
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       for(unsigned i = 0; i < PAGE_SIZE; i++)
+       {
+           *((char *)data+i) = i % (j+1) + 32;
+       }
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+
+       if (j == 0) {
+           rc = fileHandle.readPage(0, firstPage);
+           assert(rc == success && "Reading a mapped page should not fail.");
+       }
+   }
+   assert(fileHandle.getNumberOfPages() == numPages && "The file should have all appended pages.");
+
+   // A pointer taken before the mapping grew still sees the first page
+   for(unsigned i = 0; i < PAGE_SIZE; i++)
+   {
+       *((char *)data+i) = 32;
+   }
+   rc = memcmp(data, firstPage, PAGE_SIZE);
+   assert(rc == success && "A mapped page should stay valid while the file grows.");
+
+   // Every page is handed out in place
+   const void *page = NULL;
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       rc = fileHandle.readPage(j, page);
+       assert(rc == success && "Reading a mapped page should not fail.");
+       assert(*((char *)page + j) == (char) (j % (j+1) + 32) && "Checking the integrity of a page should not fail.");
+   }
+   rc = fileHandle.readPage(numPages, page);
+   assert(rc != success && "Reading past the end of the file should fail.");
+
+   // Write through the mapping
+   memset(data, 'm', PAGE_SIZE);
+   rc = fileHandle.writePage(numPages - 1, data);
+   assert(rc == success && "Writing a page should not fail.");
+
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // The written page is in the file for a regular handle
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+   void *buffer = malloc(PAGE_SIZE);
+   rc = fileHandle2.readPage(numPages - 1, buffer);
+   assert(rc == success && "Reading a page should not fail.");
+   rc = memcmp(data, buffer, PAGE_SIZE);
+   assert(rc == success && "Checking the integrity of a page should not fail.");
+   const void *unmapped = NULL;
+   rc = fileHandle2.readPage(0, unmapped);
+   assert(rc != success && "Only a mapped file can hand out pages in place.");
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Insert records into a mapped record file and scan them back
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle3;
+   rc = rbfm->openFile(fileName, fileHandle3, IO_MMAP);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   Attribute attr;
+   attr.name = "EmpName";
+   attr.type = TypeVarChar;
+   attr.length = (AttrLength)30;
+   recordDescriptor.push_back(attr);
+   attr.name = "Age";
+   attr.type = TypeInt;
+   attr.length = (AttrLength)4;
+   recordDescriptor.push_back(attr);
+
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+   int numRecords = 2000;
+   void *record = malloc(100);
+   RID rid;
+   for(int i = 0; i < numRecords; i++)
+   {
+       int offset = 0;
+       memcpy((char *)record + offset, nullsIndicator, nullFieldsIndicatorActualSize);
+       offset += nullFieldsIndicatorActualSize;
+       int nameLength = 8;
+       memcpy((char *)record + offset, &nameLength, sizeof(int));
+       offset += sizeof(int);
+       memcpy((char *)record + offset, "Employee", nameLength);
+       offset += nameLength;
+       memcpy((char *)record + offset, &i, sizeof(int));
+
+       rc = rbfm->insertRecord(fileHandle3, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+
+   vector<string> attributes;
+   attributes.push_back("Age");
+   int ageLimit = 1000;
+   RBFM_ScanIterator rbfm_ScanIterator;
+   rc = rbfm->scan(fileHandle3, recordDescriptor, "Age", GE_OP, &ageLimit, attributes, rbfm_ScanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+
+   int count = 0;
+   void *returnedData = malloc(100);
+   while(rbfm_ScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+   {
+       int age;
+       memcpy(&age, (char *)returnedData + 1, sizeof(int));
+       assert(age >= ageLimit && "Scanned records should meet the condition.");
+       count++;
+   }
+   rbfm_ScanIterator.close();
+   assert(count == numRecords - ageLimit && "The scan should return every matching record.");
+
+   rc = rbfm->closeFile(fileHandle3);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+   free(buffer);
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 14 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the memory mapped mode of the paged file manager
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test14");
+
+   RC rcmain = RBFTest_14(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "aio.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_15(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File
+   // 3. Append Page
+   // 4. Submit Read / Submit Read Batch / Poll Reads
+   // 5. Worker thread fallback
+   // 6. Prefetch Pages into the buffer pool
+   // 7. Close File
+   cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+   RC rc;
+   string fileName = "test15";
+   unsigned numPages = 200;
+
+   // Create the file named "test15"
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   // Append pages filled with their page number
+   void *data = malloc(PAGE_SIZE);
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       memset(data, j % 256, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+
+   // Read every page with one batch, bigger than the queue of the engine
+   char *buffers = (char *) malloc(numPages * PAGE_SIZE);
+   vector<PageNum> pageNums;
+   vector<void *> pageBuffers;
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       pageNums.push_back(numPages - 1 - j);
+       pageBuffers.push_back(buffers + (numPages - 1 - j) * PAGE_SIZE);
+   }
+   memset(buffers, 0xff, numPages * PAGE_SIZE);
+   rc = fileHandle.submitReadBatch(pageNums, pageBuffers);
+   assert(rc == success && "Submitting a batch of reads should not fail.");
+
+   vector<pair<PageNum, RC> > completed;
+   while(completed.size() < numPages)
+   {
+       rc = fileHandle.pollReads(completed, true);
+       assert(rc == success && "Polling for reads should not fail.");
+   }
+   assert(completed.size() == numPages && "Every submitted read should complete once.");
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       assert(completed[j].second == success && "An asynchronous read should not fail.");
+       memset(data, completed[j].first % 256, PAGE_SIZE);
+       rc = memcmp(data, buffers + completed[j].first * PAGE_SIZE, PAGE_SIZE);
+       assert(rc == success && "Checking the integrity of a page should not fail.");
+   }
+   cout << "read " << numPages << " pages through " << fileHandle.getAsyncIO()->getName() << endl;
+
+   // Reads past the end of the file are refused
+   rc = fileHandle.submitRead(numPages, buffers);
+   assert(rc != success && "Reading past the end of the file should fail.");
+
+   // The worker threads give the same results
+   ThreadPoolIO threads(fileHandle.fd);
+   PageNum pageNum = 7;
+   void *buffer = buffers;
+   rc = threads.submit(&pageNum, &buffer, 1);
+   assert(rc == success && "Submitting a read should not fail.");
+   vector<AIOCompletion> finished;
+   rc = threads.poll(finished, true);
+   assert(rc == success && finished.size() == 1 && finished[0].rc == success && "The worker read should complete.");
+   memset(data, 7, PAGE_SIZE);
+   rc = memcmp(data, buffers, PAGE_SIZE);
+   assert(rc == success && "Checking the integrity of a page should not fail.");
+
+   // Prefetched pages are hits when they are read
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   BufferPoolManager::instance()->discardFile(fileName);
+
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = fileHandle2.prefetchPages(0, 32);
+   assert(rc == success && "Prefetching pages should not fail.");
+   for(unsigned j = 0; j < 32; j++)
+   {
+       rc = fileHandle2.readPage(j, data);
+       assert(rc == success && "Reading a page should not fail.");
+       assert(*((unsigned char *) data + 100) == j && "Checking the integrity of a page should not fail.");
+   }
+   unsigned hitCount, missCount, evictCount;
+   fileHandle2.collectBufferCounterValues(hitCount, missCount, evictCount);
+   assert(hitCount == 32 && missCount == 0 && "Prefetched pages should be served by the buffer pool.");
+
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+   free(buffers);
+
+   cout << "[PASS] Test Case 15 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the asynchronous reads of the paged file manager
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test15");
+
+   RC rcmain = RBFTest_15(pfm);
+   return rcmain;
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_16(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File
+   // 3. Write Pages (appending)
+   // 4. Write Page / Write Pages over cached pages
+   // 5. Read Pages
+   // 6. Close File
+   cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+   RC rc;
+   string fileName = "test16";
+   unsigned numPages = 100;
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   // Fill the file with one call, every page holds its page number
+   char *data = (char *) malloc(numPages * PAGE_SIZE);
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       memset(data + j * PAGE_SIZE, j, PAGE_SIZE);
+   }
+   rc = fileHandle.writePages(0, numPages, data);
+   assert(rc == success && "Writing pages should not fail.");
+   assert(fileHandle.getNumberOfPages() == numPages && "Writing past the end should append.");
+
+   rc = fileHandle.writePages(numPages + 1, 1, data);
+   assert(rc != success && "Writing pages should not leave a hole.");
+
+   // Dirty a page in the buffer pool, then overwrite a range around another cached one
+   memset(data, 'd', PAGE_SIZE);
+   rc = fileHandle.writePage(10, data);
+   assert(rc == success && "Writing a page should not fail.");
+   rc = fileHandle.readPage(30, data);
+   assert(rc == success && "Reading a page should not fail.");
+   memset(data, 'w', 5 * PAGE_SIZE);
+   rc = fileHandle.writePages(28, 5, data);
+   assert(rc == success && "Writing pages should not fail.");
+
+   // Read everything back with one call
+   char *buffer = (char *) malloc(numPages * PAGE_SIZE);
+   rc = fileHandle.readPages(0, numPages, buffer);
+   assert(rc == success && "Reading pages should not fail.");
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       char expected = j;
+       if (j == 10) expected = 'd';
+       if (j >= 28 && j < 33) expected = 'w';
+       assert(buffer[j * PAGE_SIZE] == expected && buffer[j * PAGE_SIZE + PAGE_SIZE - 1] == expected
+               && "Checking the integrity of a page should not fail.");
+   }
+   rc = fileHandle.readPage(30, data);
+   assert(rc == success && data[0] == 'w' && "The cached copy should be refreshed.");
+
+   rc = fileHandle.readPages(numPages - 1, 2, buffer);
+   assert(rc != success && "Reading past the end of the file should fail.");
+
+   unsigned readCount, writeCount, appendCount;
+   fileHandle.collectCounterValues(readCount, writeCount, appendCount);
+   assert(readCount == numPages + 2 && writeCount == 6 && appendCount == numPages && "The counters should count every page.");
+
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // The dirty page reached the file
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2, IO_STREAM);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = fileHandle2.readPages(9, 3, buffer);
+   assert(rc == success && "Reading pages should not fail.");
+   assert(buffer[0] == 9 && buffer[PAGE_SIZE] == 'd' && buffer[2 * PAGE_SIZE] == 11 && "Checking the integrity of a page should not fail.");
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+   free(buffer);
+
+   cout << "[PASS] Test Case 16 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the multi page reads and writes of the paged file manager
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test16");
+
+   RC rcmain = RBFTest_16(pfm);
+   return rcmain;
+}
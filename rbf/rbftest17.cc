@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_17(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Insert Record across several free space map pages
+   // 3. Delete Record
+   // 4. Open File (free space map only)
+   // 5. Scan
+   // 6. Close File
+   cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+   RC rc;
+   string fileName = "test17";
+
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   Attribute attr;
+   attr.name = "Id";
+   attr.type = TypeInt;
+   attr.length = (AttrLength)4;
+   recordDescriptor.push_back(attr);
+   attr.name = "Payload";
+   attr.type = TypeVarChar;
+   attr.length = (AttrLength)2000;
+   recordDescriptor.push_back(attr);
+
+   // Two records fill a page, so this spans more than one map page
+   int payloadLength = 1800;
+   int numRecords = 2 * (FSM_INTERVAL + 100);
+   void *record = malloc(PAGE_SIZE);
+   vector<RID> rids;
+   RID rid;
+   for(int i = 0; i < numRecords; i++)
+   {
+       int offset = 0;
+       *((char *) record) = 0;
+       offset += 1;
+       memcpy((char *)record + offset, &i, sizeof(int));
+       offset += sizeof(int);
+       memcpy((char *)record + offset, &payloadLength, sizeof(int));
+       offset += sizeof(int);
+       memset((char *)record + offset, 'a' + i % 26, payloadLength);
+
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       assert(!RecordBasedFileManager::isFreeSpaceMapPage(rid.pageNum) && "Records never go to a map page.");
+       rids.push_back(rid);
+   }
+   assert(fileHandle.getNumberOfPages() > FSM_INTERVAL && "The file should need a second map page.");
+
+   // Free some room on a page covered by the second map page
+   RID freed = rids[rids.size() - 10];
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, freed);
+   assert(rc == success && "Deleting a record should not fail.");
+   vector<unsigned> expected = fileHandle.freeSpace;
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Reopening only reads the map pages
+   FileHandle fileHandle2;
+   rc = rbfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+   unsigned readCount, writeCount, appendCount;
+   fileHandle2.collectCounterValues(readCount, writeCount, appendCount);
+   cout << "pages: " << fileHandle2.getNumberOfPages() << " pages read by openFile: " << readCount << endl;
+   assert(readCount == 2 && "Opening the file should only read the map pages.");
+   assert(fileHandle2.freeSpace == expected && "The free space should survive close and open.");
+
+   // The next record that fits goes to the freed page
+   rc = rbfm->insertRecord(fileHandle2, recordDescriptor, record, rid);
+   assert(rc == success && "Inserting a record should not fail.");
+   assert(rid.pageNum == freed.pageNum && "The freed space should be reused.");
+
+   // A full scan skips the map pages
+   vector<string> attributes;
+   attributes.push_back("Id");
+   RBFM_ScanIterator rbfm_ScanIterator;
+   rc = rbfm->scan(fileHandle2, recordDescriptor, "Id", NO_OP, NULL, attributes, rbfm_ScanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   int count = 0;
+   void *returnedData = malloc(PAGE_SIZE);
+   while(rbfm_ScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+   {
+       assert(!RecordBasedFileManager::isFreeSpaceMapPage(rid.pageNum) && "The scan should skip map pages.");
+       count++;
+   }
+   rbfm_ScanIterator.close();
+   assert(count == numRecords && "The scan should return every record.");
+
+   rc = rbfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+
+   cout << "[PASS] Test Case 17 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the free space map of the record based file manager
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test17");
+
+   RC rcmain = RBFTest_17(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_18(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File
+   // 3. Append Page
+   // 4. Header roots and cumulative counters
+   // 5. Close File
+   cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+   RC rc;
+   string fileName = "test18";
+   unsigned numPages = 10;
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   struct stat info;
+   stat(fileName.c_str(), &info);
+   assert(info.st_size == PAGE_SIZE && "A new file should only hold its header page.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getNumberOfPages() == 0 && "The header page is not a page of the file.");
+   assert(fileHandle.getIndexRoot() == NO_PAGE && fileHandle.getFreeSpaceMapRoot() == NO_PAGE && "A new file has no roots.");
+
+   void *data = malloc(PAGE_SIZE);
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       memset(data, j, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   rc = fileHandle.readPage(3, data);
+   assert(rc == success && "Reading a page should not fail.");
+   fileHandle.setIndexRoot(7);
+
+   // A second handle closing with fewer pages must not shrink the file
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   FileHandle fileHandle3;
+   rc = pfm->openFile(fileName, fileHandle3, IO_STREAM);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle3.getNumberOfPages() == numPages && "The page count should survive close and open.");
+   assert(fileHandle3.getIndexRoot() == 7 && "The index root should survive close and open.");
+   rc = fileHandle3.readPage(numPages - 1, data);
+   assert(rc == success && *((unsigned char *) data) == numPages - 1 && "Checking the integrity of a page should not fail.");
+
+   // Session counters start over, the totals carry on
+   unsigned readCount, writeCount, appendCount;
+   fileHandle3.collectCounterValues(readCount, writeCount, appendCount);
+   assert(readCount == 1 && appendCount == 0 && "The counters of a new handle start at zero.");
+   uint64_t totalReads, totalWrites, totalAppends;
+   fileHandle3.collectTotalCounterValues(totalReads, totalWrites, totalAppends);
+   cout << "total reads: " << totalReads << " writes: " << totalWrites << " appends: " << totalAppends << endl;
+   assert(totalReads == 2 && totalWrites == 0 && totalAppends == numPages && "The totals should cover every session.");
+   rc = pfm->closeFile(fileHandle3);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // A file without a header is refused
+   FILE *file = fopen("test18raw", "w");
+   fwrite(data, 1, PAGE_SIZE, file);
+   fclose(file);
+   FileHandle fileHandle4;
+   rc = pfm->openFile("test18raw", fileHandle4);
+   assert(rc != success && "Opening a file without a header should fail.");
+   remove("test18raw");
+
+   // So is a file made with another page size
+   FileHeader header;
+   int fd = open(fileName.c_str(), O_RDWR);
+   assert(pread(fd, &header, sizeof(header), 0) == sizeof(header) && "Reading the header should not fail.");
+   assert(header.pageSize == PAGE_SIZE && "The header should record the page size.");
+   header.pageSize = PAGE_SIZE * 2;
+   assert(pwrite(fd, &header, sizeof(header), 0) == sizeof(header) && "Writing the header should not fail.");
+   close(fd);
+   FileHandle fileHandle5;
+   rc = pfm->openFile(fileName, fileHandle5);
+   assert(rc != success && "Opening a file with another page size should fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+
+   cout << "[PASS] Test Case 18 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the header page of the paged file manager
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test18");
+   remove("test18raw");
+
+   RC rcmain = RBFTest_18(pfm);
+   return rcmain;
+}
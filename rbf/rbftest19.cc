@@ -0,0 +1,114 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+off_t fileSize(const string &fileName)
+{
+   struct stat info;
+   stat(fileName.c_str(), &info);
+   return info.st_size;
+}
+
+int RBFTest_19(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Open File
+   // 3. Append Page into reserved extents
+   // 4. Write Pages past the end
+   // 5. Close File
+   cout << endl << "***** In RBF Test Case 19 *****" << endl;
+
+   RC rc;
+   string fileName = "test19";
+   unsigned extentPages = 16;
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = fileHandle.setExtentPages(0);
+   assert(rc != success && "An empty extent should be refused.");
+   rc = fileHandle.setExtentPages(MAX_EXTENT_PAGES + 1);
+   assert(rc != success && "An extent over the limit should be refused.");
+   rc = fileHandle.setExtentPages(extentPages);
+   assert(rc == success && "Setting the extent size should not fail.");
+
+   // The first append reserves a whole extent
+   void *data = malloc(PAGE_SIZE);
+   memset(data, 0, PAGE_SIZE);
+   rc = fileHandle.appendPage(data);
+   assert(rc == success && "Appending a page should not fail.");
+   assert(fileHandle.getNumberOfPages() == 1 && "Only the appended page is in use.");
+   assert(fileSize(fileName) == (off_t) (HEADER_PAGES + extentPages) * PAGE_SIZE && "The file should grow by an extent.");
+
+   // Appends inside the extent leave the file alone
+   for(unsigned j = 1; j < extentPages; j++)
+   {
+       memset(data, j, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   assert(fileSize(fileName) == (off_t) (HEADER_PAGES + extentPages) * PAGE_SIZE && "The extent should hold the appends.");
+
+   // A run bigger than an extent reserves what it needs
+   unsigned runPages = 3 * extentPages;
+   char *run = (char *) malloc(runPages * PAGE_SIZE);
+   memset(run, 'r', runPages * PAGE_SIZE);
+   rc = fileHandle.writePages(extentPages, runPages, run);
+   assert(rc == success && "Writing pages should not fail.");
+   unsigned numPages = extentPages + runPages;
+   assert(fileHandle.getNumberOfPages() == numPages && "Writing past the end should append.");
+   assert(fileSize(fileName) >= (off_t) (HEADER_PAGES + numPages) * PAGE_SIZE && "The file should hold every page.");
+
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // The reserved space is not part of the file
+   FileHandle fileHandle2;
+   rc = pfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle2.getNumberOfPages() == numPages && "The page count should not include reserved space.");
+   rc = fileHandle2.readPage(numPages, data);
+   assert(rc != success && "Reading reserved space should fail.");
+   rc = fileHandle2.readPage(extentPages - 1, data);
+   assert(rc == success && *((char *) data) == (char) (extentPages - 1) && "Checking the integrity of a page should not fail.");
+   rc = fileHandle2.readPage(numPages - 1, data);
+   assert(rc == success && *((char *) data) == 'r' && "Checking the integrity of a page should not fail.");
+   rc = pfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+   free(run);
+
+   cout << "[PASS] Test Case 19 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the preallocated extents of the paged file manager
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test19");
+
+   RC rcmain = RBFTest_19(pfm);
+   return rcmain;
+}
@@ -0,0 +1,279 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned NUM_PAGES = 1500;   // more than the buffer pool holds
+const unsigned NUM_READERS = 4;
+const unsigned READS_PER_THREAD = 3000;
+const int NUM_RECORDS = 3000;
+const int PAYLOAD_LENGTH = 100;
+
+atomic<int> tornPages(0);
+atomic<int> badRecords(0);
+
+bool isUniform(const char *page)
+{
+   for(unsigned i = 1; i < PAGE_SIZE; i++)
+   {
+       if(page[i] != page[0])
+       {
+           return false;
+       }
+   }
+   return true;
+}
+
+void readPages(FileHandle *fileHandle, unsigned seed)
+{
+   char *data = (char *) malloc(PAGE_SIZE);
+   for(unsigned i = 0; i < READS_PER_THREAD; i++)
+   {
+       PageNum pageNum = rand_r(&seed) % NUM_PAGES;
+       if(i % 2 == 0)
+       {
+           if(fileHandle->readPage(pageNum, data) != success || !isUniform(data))
+           {
+               tornPages++;
+           }
+       }
+       else
+       {
+           // look at the frame in place under a shared latch
+           void *page;
+           if(fileHandle->pinPage(pageNum, page, LATCH_SHARED) != success)
+           {
+               tornPages++;
+               continue;
+           }
+           if(!isUniform((char *) page))
+           {
+               tornPages++;
+           }
+           fileHandle->unpinPage(pageNum, false, LATCH_SHARED);
+       }
+   }
+   free(data);
+}
+
+void writePages(FileHandle *fileHandle)
+{
+   char *data = (char *) malloc(PAGE_SIZE);
+   for(unsigned i = 0; i < READS_PER_THREAD; i++)
+   {
+       PageNum pageNum = (i * 7) % NUM_PAGES;
+       memset(data, 'a' + i % 26, PAGE_SIZE);
+       if(fileHandle->writePage(pageNum, data) != success)
+       {
+           tornPages++;
+       }
+   }
+   free(data);
+}
+
+void prepareRecord(void *record, int id, char fill)
+{
+   int offset = 0;
+   *((char *) record) = 0;
+   offset += 1;
+   memcpy((char *) record + offset, &id, sizeof(int));
+   offset += sizeof(int);
+   memcpy((char *) record + offset, &PAYLOAD_LENGTH, sizeof(int));
+   offset += sizeof(int);
+   memset((char *) record + offset, fill, PAYLOAD_LENGTH);
+}
+
+void scanRecords(RecordBasedFileManager *rbfm, FileHandle *fileHandle, const vector<Attribute> *recordDescriptor)
+{
+   vector<string> attributes;
+   attributes.push_back("Id");
+   RBFM_ScanIterator rbfm_ScanIterator;
+   if(rbfm->scan(*fileHandle, *recordDescriptor, "Id", NO_OP, NULL, attributes, rbfm_ScanIterator) != success)
+   {
+       badRecords++;
+       return;
+   }
+   RID rid;
+   char data[PAGE_SIZE];
+   int count = 0;
+   while(rbfm_ScanIterator.getNextRecord(rid, data) != RBFM_EOF)
+   {
+       count++;
+   }
+   rbfm_ScanIterator.close();
+   if(count != NUM_RECORDS)
+   {
+       badRecords++;
+   }
+}
+
+void readRecords(RecordBasedFileManager *rbfm, FileHandle *fileHandle, const vector<Attribute> *recordDescriptor,
+        const vector<RID> *rids, unsigned seed)
+{
+   char data[PAGE_SIZE];
+   for(unsigned i = 0; i < READS_PER_THREAD; i++)
+   {
+       int id = rand_r(&seed) % NUM_RECORDS;
+       int readId;
+       if(rbfm->readRecord(*fileHandle, *recordDescriptor, (*rids)[id], data) != success)
+       {
+           badRecords++;
+           continue;
+       }
+       memcpy(&readId, data + 1, sizeof(int));
+       char fill = data[1 + 2 * sizeof(int)];
+       if(readId != id || data[PAYLOAD_LENGTH + 2 * sizeof(int)] != fill)
+       {
+           badRecords++;
+       }
+   }
+}
+
+void updateRecords(RecordBasedFileManager *rbfm, FileHandle *fileHandle, const vector<Attribute> *recordDescriptor,
+        const vector<RID> *rids)
+{
+   char record[PAGE_SIZE];
+   for(int id = 0; id < NUM_RECORDS; id += 3)
+   {
+       prepareRecord(record, id, 'A' + id % 26);
+       if(rbfm->updateRecord(*fileHandle, *recordDescriptor, record, (*rids)[id]) != success)
+       {
+           badRecords++;
+       }
+   }
+}
+
+int RBFTest_20(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Read Page / Pin Page from several threads
+   // 2. Write Page while other threads read
+   // 3. Scan / Read Record from several threads
+   // 4. Update Record while other threads read
+   cout << endl << "***** In RBF Test Case 20 *****" << endl;
+
+   RC rc;
+   string fileName = "test20";
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   // Every page holds one byte value, a torn page would mix two
+   char *data = (char *) malloc(PAGE_SIZE);
+   for(unsigned j = 0; j < NUM_PAGES; j++)
+   {
+       memset(data, j % 256, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+
+   vector<thread> threads;
+   for(unsigned i = 0; i < NUM_READERS; i++)
+   {
+       threads.push_back(thread(readPages, &fileHandle, i + 1));
+   }
+   threads.push_back(thread(writePages, &fileHandle));
+   for(unsigned i = 0; i < threads.size(); i++)
+   {
+       threads[i].join();
+   }
+   threads.clear();
+   assert(tornPages == 0 && "Pages read while others are written should never be torn.");
+
+   unsigned readCount, writeCount, appendCount;
+   fileHandle.collectCounterValues(readCount, writeCount, appendCount);
+   assert(readCount == NUM_READERS * READS_PER_THREAD && writeCount == READS_PER_THREAD && "No counted operation should be lost.");
+
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Records read from several threads, with and without a writer
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle2;
+   rc = rbfm->openFile(fileName, fileHandle2);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   Attribute attr;
+   attr.name = "Id";
+   attr.type = TypeInt;
+   attr.length = (AttrLength)4;
+   recordDescriptor.push_back(attr);
+   attr.name = "Payload";
+   attr.type = TypeVarChar;
+   attr.length = (AttrLength)PAYLOAD_LENGTH;
+   recordDescriptor.push_back(attr);
+
+   vector<RID> rids;
+   RID rid;
+   for(int id = 0; id < NUM_RECORDS; id++)
+   {
+       prepareRecord(data, id, 'a' + id % 26);
+       rc = rbfm->insertRecord(fileHandle2, recordDescriptor, data, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+
+   for(unsigned i = 0; i < NUM_READERS; i++)
+   {
+       threads.push_back(thread(scanRecords, rbfm, &fileHandle2, &recordDescriptor));
+   }
+   for(unsigned i = 0; i < threads.size(); i++)
+   {
+       threads[i].join();
+   }
+   threads.clear();
+   assert(badRecords == 0 && "Concurrent scans should each see every record.");
+
+   for(unsigned i = 0; i < NUM_READERS; i++)
+   {
+       threads.push_back(thread(readRecords, rbfm, &fileHandle2, &recordDescriptor, &rids, i + 1));
+   }
+   threads.push_back(thread(updateRecords, rbfm, &fileHandle2, &recordDescriptor, &rids));
+   for(unsigned i = 0; i < threads.size(); i++)
+   {
+       threads[i].join();
+   }
+   assert(badRecords == 0 && "Records read while others are updated should be whole.");
+
+   rc = rbfm->closeFile(fileHandle2);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+
+   cout << "[PASS] Test Case 20 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test several threads sharing one file handle
+   PagedFileManager *pfm = PagedFileManager::instance();
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test20");
+
+   RC rcmain = RBFTest_20(pfm, rbfm);
+   return rcmain;
+}
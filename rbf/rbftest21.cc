@@ -0,0 +1,236 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Is the page on disk filled with c, looked at through a descriptor of our own
+bool pageOnDiskIs(const string &fileName, PageNum pageNum, char c)
+{
+    char *page = (char *) malloc(PAGE_SIZE);
+    int fd = open(fileName.c_str(), O_RDONLY);
+    bool same = fd != -1 && pread(fd, page, PAGE_SIZE, pageOffset(pageNum)) == (ssize_t) PAGE_SIZE;
+    for (unsigned i = 0; same && i < PAGE_SIZE; i++) {
+        same = page[i] == c;
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    free(page);
+    return same;
+}
+
+// Dirty every page of the file numbered like the thread, far more than the pool holds
+void dirtyPages(FileHandle *fileHandle, unsigned thread, unsigned numThreads, RC *rc)
+{
+    for (PageNum j = thread; j < fileHandle->getNumberOfPages() && *rc == 0; j += numThreads) {
+        void *page = NULL;
+        *rc = fileHandle->pinPage(j, page);
+        if (*rc == 0) {
+            memset(page, 'f' + thread, PAGE_SIZE);
+            *rc = fileHandle->unpinPage(j, true);
+        }
+    }
+}
+
+// Change a page latched by another thread of the test a little later
+void finishPage(FileHandle *fileHandle, PageNum pageNum, void *page, RC *rc)
+{
+    this_thread::sleep_for(chrono::milliseconds(100));
+    memset(page, 'h', PAGE_SIZE);
+    *rc = fileHandle->unpinPage(pageNum, true, LATCH_EXCLUSIVE);
+}
+
+// Wait up to two seconds for the flusher to write the page
+bool waitForPage(const string &fileName, PageNum pageNum, char c)
+{
+    for (unsigned i = 0; i < 200; i++) {
+        if (pageOnDiskIs(fileName, pageNum, c)) {
+            return true;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int RBFTest_21(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Pin / Unpin Page (dirty frames)
+   // 3. Background write back by age and by dirty ratio
+   // 4. Flush / Sync
+   // 5. Write back on eviction from several threads
+   // 6. Close File, waiting for a page latched by another thread
+   cout << endl << "***** In RBF Test Case 21 *****" << endl;
+
+   RC rc;
+   string fileName = "test21";
+   BufferPoolManager *bpm = BufferPoolManager::instance();
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   void *data = malloc(PAGE_SIZE);
+   memset(data, 'a', PAGE_SIZE);
+   unsigned numPages = 300;
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+
+   // A page dirty for longer than the age limit is written in the background
+   rc = bpm->setFlushPolicy(50, 0);
+   assert(rc == success && "Setting the flush policy should not fail.");
+   void *page = NULL;
+   rc = fileHandle.pinPage(3, page);
+   assert(rc == success && "Pinning a page should not fail.");
+   memset(page, 'b', PAGE_SIZE);
+   rc = fileHandle.unpinPage(3, true);
+   assert(rc == success && "Unpinning a page should not fail.");
+   assert(waitForPage(fileName, 3, 'b') && "An old dirty page should reach the file.");
+
+   // Too many dirty frames wake the flusher even if none of them is old
+   rc = bpm->setFlushPolicy(3600 * 1000, 10);
+   assert(rc == success && "Setting the flush policy should not fail.");
+   for(unsigned j = 10; j < numPages; j++)
+   {
+       rc = fileHandle.pinPage(j, page);
+       assert(rc == success && "Pinning a page should not fail.");
+       memset(page, 'c', PAGE_SIZE);
+       rc = fileHandle.unpinPage(j, true);
+       assert(rc == success && "Unpinning a page should not fail.");
+   }
+   assert(waitForPage(fileName, 10, 'c') && "The oldest dirty pages should reach the file.");
+   assert(!pageOnDiskIs(fileName, numPages - 1, 'c') && "The newest dirty pages should stay in the pool.");
+
+   // Without the background flusher only flush writes the page
+   rc = bpm->setFlushPolicy(0, 0);
+   assert(rc == success && "Setting the flush policy should not fail.");
+   rc = fileHandle.pinPage(5, page);
+   assert(rc == success && "Pinning a page should not fail.");
+   memset(page, 'd', PAGE_SIZE);
+   rc = fileHandle.unpinPage(5, true);
+   assert(rc == success && "Unpinning a page should not fail.");
+   this_thread::sleep_for(chrono::milliseconds(2 * FLUSH_INTERVAL_MS));
+   assert(!pageOnDiskIs(fileName, 5, 'd') && "The page should not be written without a reason.");
+
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+   assert(pageOnDiskIs(fileName, 5, 'd') && "Flush should write the dirty page.");
+   assert(pageOnDiskIs(fileName, numPages - 1, 'c') && "Flush should write every dirty page.");
+
+   // The header is saved too, so the page count is durable before close
+   FileHeader header;
+   int fd = open(fileName.c_str(), O_RDONLY);
+   assert(fd != -1 && pread(fd, &header, sizeof(FileHeader), 0) == (ssize_t) sizeof(FileHeader));
+   close(fd);
+   assert(header.numPages == numPages && "Flush should save the page count.");
+
+   // The handle still writes back pages dirtied after a flush
+   rc = fileHandle.pinPage(6, page);
+   assert(rc == success && "Pinning a page should not fail.");
+   memset(page, 'e', PAGE_SIZE);
+   rc = fileHandle.unpinPage(6, true);
+   assert(rc == success && "Unpinning a page should not fail.");
+   rc = fileHandle.sync();
+   assert(rc == success && "Syncing the file should not fail.");
+   assert(pageOnDiskIs(fileName, 6, 'e') && "Sync should write the dirty page.");
+
+   // Still without the flusher, evictions write the pages back while other
+   // threads keep pinning theirs
+   memset(data, 'a', PAGE_SIZE);
+   for(unsigned j = 0; j < 2 * BUFFER_POOL_FRAMES; j++)
+   {
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   unsigned hitCount, missCount, evictCount, evictedBefore;
+   rc = bpm->collectCounterValues(hitCount, missCount, evictedBefore);
+   assert(rc == success && "Collecting the counters should not fail.");
+   unsigned numThreads = 4;
+   vector<thread> threads;
+   vector<RC> results(numThreads, 0);
+   for(unsigned t = 0; t < numThreads; t++)
+   {
+       threads.push_back(thread(dirtyPages, &fileHandle, t, numThreads, &results[t]));
+   }
+   for(unsigned t = 0; t < numThreads; t++)
+   {
+       threads[t].join();
+       assert(results[t] == success && "Pinning pages from several threads should not fail.");
+   }
+   rc = bpm->collectCounterValues(hitCount, missCount, evictCount);
+   assert(rc == success && evictCount - evictedBefore >= BUFFER_POOL_FRAMES && "Dirty pages should have been evicted.");
+   for(unsigned j = 0; j < fileHandle.getNumberOfPages(); j++)
+   {
+       rc = fileHandle.readPage(j, data);
+       assert(rc == success && ((char *) data)[0] == (char) ('f' + j % numThreads) && "An evicted page should read back what was written.");
+   }
+   assert(pageOnDiskIs(fileName, 0, 'f') && "An evicted page should be in the file.");
+
+   rc = bpm->setFlushPolicy(DEFAULT_DIRTY_AGE_MS, DEFAULT_DIRTY_PERCENT);
+   assert(rc == success && "Setting the flush policy should not fail.");
+   rc = bpm->setFlushPolicy(0, 101);
+   assert(rc != success && "A dirty ratio above 100 percent should be refused.");
+
+   // a dirty page latched by a thread is written once the thread is done with it
+   page = NULL;
+   rc = fileHandle.pinPage(1, page);
+   assert(rc == success && "Pinning a page should not fail.");
+   memset(page, 'g', PAGE_SIZE);
+   rc = fileHandle.unpinPage(1, true);
+   assert(rc == success && "Unpinning a page should not fail.");
+   FileHandle writer;
+   rc = pfm->openFile(fileName, writer);
+   assert(rc == success && "Opening the file again should not fail.");
+   rc = writer.pinPage(1, page, LATCH_EXCLUSIVE);
+   assert(rc == success && "Latching a page should not fail.");
+   RC finished = -1;
+   thread finisher(finishPage, &writer, 1, page, &finished);
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should wait for the latched page.");
+   finisher.join();
+   assert(finished == success && "Unpinning the latched page should not fail.");
+   rc = pfm->closeFile(writer);
+   assert(rc == success && "Closing the file should not fail.");
+   assert(pageOnDiskIs(fileName, 1, 'h') && "The latched page should be in the file.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(data);
+
+   cout << "[PASS] Test Case 21 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the write back of dirty pages
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test21");
+
+   RC rcmain = RBFTest_21(pfm);
+   return rcmain;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "wal.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Record with an int id and a varchar of 100 copies of c
+void makeRecord(void *record, int id, char c)
+{
+    int length = 100;
+    *((char *) record) = 0;
+    memcpy((char *) record + 1, &id, sizeof(int));
+    memcpy((char *) record + 1 + sizeof(int), &length, sizeof(int));
+    memset((char *) record + 1 + 2 * sizeof(int), c, length);
+}
+
+int RBFTest_22(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Create File (logged)
+   // 2. Insert / Update / Delete Record
+   // 3. Commit, alone and from several threads at once
+   // 4. Open File replaying the log of a crashed handle
+   // 5. Close File (empties the log)
+   cout << endl << "***** In RBF Test Case 22 *****" << endl;
+
+   RC rc;
+   string fileName = "test22";
+   string crashName = "test22crash";
+
+   // keep every page in the pool, only the log reaches the file
+   BufferPoolManager::instance()->setFlushPolicy(0, 0);
+
+   vector<Attribute> recordDescriptor;
+   Attribute attr;
+   attr.name = "Id";
+   attr.type = TypeInt;
+   attr.length = (AttrLength)4;
+   recordDescriptor.push_back(attr);
+   attr.name = "Payload";
+   attr.type = TypeVarChar;
+   attr.length = (AttrLength)200;
+   recordDescriptor.push_back(attr);
+
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   int numRecords = 300;
+   vector<RID> rids;
+   RID rid;
+   for(int i = 0; i < numRecords; i++)
+   {
+       makeRecord(record, i, 'a');
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+   for(int i = 0; i < numRecords; i += 3)
+   {
+       rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+       assert(rc == success && "Deleting a record should not fail.");
+   }
+   for(int i = 1; i < numRecords; i += 3)
+   {
+       makeRecord(record, i, 'b');
+       rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+       assert(rc == success && "Updating a record should not fail.");
+   }
+
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   unsigned recordCount, syncCount;
+   rc = fileHandle.collectLogCounterValues(recordCount, syncCount);
+   assert(rc == success && "A logged file should have log counters.");
+   cout << "log records: " << recordCount << " log syncs: " << syncCount << endl;
+   assert(recordCount > 0 && syncCount == 1 && "One commit should sync the log once.");
+
+   // The crashed copy has the log but none of the pages
+   copyFile(fileName, crashName);
+   copyFile(LogManager::getLogName(fileName), LogManager::getLogName(crashName));
+   FileHeader header;
+   int fd = open(crashName.c_str(), O_RDONLY);
+   assert(fd != -1 && pread(fd, &header, sizeof(FileHeader), 0) == (ssize_t) sizeof(FileHeader));
+   close(fd);
+   assert(header.numPages == 0 && "The pages should still be in the pool.");
+
+   // Opening the copy redoes the log
+   FileHandle crashHandle;
+   rc = rbfm->openFile(crashName, crashHandle);
+   assert(rc == success && "Opening a crashed file should not fail.");
+   assert(crashHandle.getNumberOfPages() == fileHandle.getNumberOfPages() && "Replay should bring back every page.");
+   for(int i = 0; i < numRecords; i++)
+   {
+       rc = rbfm->readRecord(crashHandle, recordDescriptor, rids[i], returnedData);
+       if (i % 3 == 0) {
+           assert(rc != success && "A deleted record should stay deleted.");
+           continue;
+       }
+       assert(rc == success && "Reading a replayed record should not fail.");
+       makeRecord(record, i, i % 3 == 1 ? 'b' : 'a');
+       assert(memcmp(record, returnedData, 1 + 2 * sizeof(int) + 100) == 0 && "A replayed record should match.");
+   }
+   rc = rbfm->closeFile(crashHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Closing the last handle empties the log
+   struct stat st;
+   assert(stat(LogManager::getLogName(crashName).c_str(), &st) == 0 && st.st_size == sizeof(LogFileHeader)
+          && "The log should be empty after close.");
+
+   // Committers running at once share the log syncs
+   unsigned numThreads = 4;
+   unsigned perThread = 50;
+   vector<thread> threads;
+   RC failed = 0;
+   for(unsigned t = 0; t < numThreads; t++)
+   {
+       threads.push_back(thread([&, t]() {
+           void *data = malloc(PAGE_SIZE);
+           RID newRid;
+           for(unsigned i = 0; i < perThread; i++)
+           {
+               makeRecord(data, 1000 + t * perThread + i, 'c');
+               if (rbfm->insertRecord(fileHandle, recordDescriptor, data, newRid) == -1 || fileHandle.commit() == -1) {
+                   failed = -1;
+               }
+           }
+           free(data);
+       }));
+   }
+   for(unsigned t = 0; t < numThreads; t++)
+   {
+       threads[t].join();
+   }
+   assert(failed == success && "Concurrent commits should not fail.");
+   unsigned syncCount2;
+   rc = fileHandle.collectLogCounterValues(recordCount, syncCount2);
+   assert(rc == success && "A logged file should have log counters.");
+   cout << "commits: " << numThreads * perThread << " log syncs: " << syncCount2 - syncCount << endl;
+   assert(syncCount2 - syncCount <= numThreads * perThread && "No commit should need more than one sync.");
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   BufferPoolManager::instance()->setFlushPolicy(DEFAULT_DIRTY_AGE_MS, DEFAULT_DIRTY_PERCENT);
+
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+   rc = rbfm->destroyFile(crashName);
+   assert(rc == success && "Destroying the file should not fail.");
+   assert(stat(LogManager::getLogName(fileName).c_str(), &st) == -1 && "Destroying a file should remove its log.");
+
+   free(record);
+   free(returnedData);
+
+   cout << "[PASS] Test Case 22 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the write ahead log of the record based file manager
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test22");
+   remove("test22.wal");
+   remove("test22crash");
+   remove("test22crash.wal");
+
+   RC rcmain = RBFTest_22(rbfm);
+   return rcmain;
+}
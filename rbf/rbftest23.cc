@@ -0,0 +1,212 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "crc32c.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Copy a page of the file over another one behind the back of the paged file manager,
+// or flip a byte of it if both are the same page
+void damagePage(const string &fileName, PageNum from, PageNum to)
+{
+    char *page = (char *) malloc(PAGE_SIZE);
+    int fd = open(fileName.c_str(), O_RDWR);
+    assert(pread(fd, page, PAGE_SIZE, pageOffset(from)) == (ssize_t) PAGE_SIZE && "Reading the page should not fail.");
+    if (from == to) {
+        page[100] ^= 1;
+    }
+    assert(pwrite(fd, page, PAGE_SIZE, pageOffset(to)) == (ssize_t) PAGE_SIZE && "Writing the page should not fail.");
+    close(fd);
+    free(page);
+    // the pool still has the good copy
+    BufferPoolManager::instance()->discardFile(fileName);
+}
+
+int RBFTest_23(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. CRC32C
+   // 2. Create File with checksums
+   // 3. Append Page / Read Page / Read Pages / Submit Read / Pin Page
+   // 4. Damaged and misplaced pages
+   // 5. Read Record of a damaged page
+   cout << endl << "***** In RBF Test Case 23 *****" << endl;
+
+   RC rc;
+   string fileName = "test23";
+
+   // Both implementations give the check value of CRC-32C
+   assert(crc32cSoftware(0, "123456789", 9) == 0xe3069283 && "The table CRC32C should match the check value.");
+   if (crc32cHasHardware()) {
+       assert(crc32cHardware(0, "123456789", 9) == 0xe3069283 && "The SSE4.2 CRC32C should match the check value.");
+       char *buffer = (char *) malloc(3 * PAGE_SIZE);
+       for (unsigned i = 0; i < 3 * PAGE_SIZE; i++) {
+           buffer[i] = i * 7 + i / 13;
+       }
+       for (unsigned length = 0; length < 3 * PAGE_SIZE - 3; length += 1 + length / 3) {
+           assert(crc32cHardware(length, buffer + 3, length) == crc32cSoftware(length, buffer + 3, length) && "Both CRC32C should agree.");
+       }
+       free(buffer);
+   }
+   cout << "crc32c uses " << (crc32cHasHardware() ? "sse4.2" : "tables") << endl;
+
+   rc = pfm->createFile(fileName, FILE_CHECKSUM);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   void *data = malloc(PAGE_SIZE);
+   unsigned numPages = 10;
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       memset(data, j, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // The checksum covers the page and its number
+   char *page = (char *) malloc(PAGE_SIZE);
+   int fd = open(fileName.c_str(), O_RDONLY);
+   assert(pread(fd, page, PAGE_SIZE, pageOffset(3)) == (ssize_t) PAGE_SIZE && "Reading the page should not fail.");
+   close(fd);
+   uint32_t checksum;
+   memcpy(&checksum, page + PAGE_DATA_SIZE, PAGE_CHECKSUM_SIZE);
+   assert(checksum == crc32c(3, page, PAGE_DATA_SIZE) && "The page should end with its checksum.");
+
+   damagePage(fileName, 4, 4);
+   damagePage(fileName, 5, 6);
+
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getCorruptPage() == NO_PAGE && "No page has been read yet.");
+   rc = fileHandle.readPage(3, data);
+   assert(rc == success && "Reading an intact page should not fail.");
+   memset(page, 3, PAGE_DATA_SIZE);
+   assert(memcmp(data, page, PAGE_DATA_SIZE) == 0 && "Checking the integrity of the page should not fail.");
+
+   rc = fileHandle.readPage(4, data);
+   assert(rc != success && "Reading a damaged page should fail.");
+   assert(fileHandle.getCorruptPage() == 4 && "The damaged page should be reported.");
+   rc = fileHandle.readPage(6, data);
+   assert(rc != success && "Reading a page written to the wrong place should fail.");
+   assert(fileHandle.getCorruptPage() == 6 && "The misplaced page should be reported.");
+
+   // Runs and asynchronous reads are checked too
+   void *buffers = malloc(4 * PAGE_SIZE);
+   rc = fileHandle.readPages(0, 4, buffers);
+   assert(rc == success && "Reading intact pages should not fail.");
+   rc = fileHandle.readPages(2, 4, buffers);
+   assert(rc != success && "Reading a run with a damaged page should fail.");
+   if (fileHandle.getAsyncIO() != NULL) {
+       vector<pair<PageNum, RC> > completed;
+       rc = fileHandle.submitRead(4, buffers);
+       assert(rc == success && "Submitting a read should not fail.");
+       rc = fileHandle.pollReads(completed, true);
+       assert(rc == success && completed.size() == 1 && "Polling a read should not fail.");
+       assert(completed[0].first == 4 && completed[0].second != success && "An asynchronous read of a damaged page should fail.");
+   }
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // A mapping is checked when a page is copied out of it, or handed out in place
+   rc = pfm->openFile(fileName, fileHandle, IO_MMAP);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = fileHandle.readPage(4, data);
+   assert(rc != success && fileHandle.getCorruptPage() == 4 && "Reading a damaged page through the mapping should fail.");
+   const void *mapped;
+   rc = fileHandle.readPage(6, mapped);
+   assert(rc != success && fileHandle.getCorruptPage() == 6 && "Pointing at a damaged page should fail.");
+   void *pinned;
+   rc = fileHandle.pinPage(4, pinned, LATCH_SHARED);
+   assert(rc != success && "Pinning a damaged page should fail.");
+   rc = fileHandle.readPage(1, mapped);
+   assert(rc == success && "Pointing at an intact page should not fail.");
+   rc = fileHandle.readPage(1, mapped);
+   assert(rc == success && "Pointing at a checked page again should not fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Record based files are created with checksums
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   string recordFileName = "test23rbfm";
+   rc = rbfm->createFile(recordFileName);
+   assert(rc == success && "Creating the file should not fail.");
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   void *returnedData = malloc(200);
+   int recordSize = 0;
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 25, 177.8, 6200, record, &recordSize);
+
+   RID firstRid, rid;
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, firstRid);
+   assert(rc == success && "Inserting a record should not fail.");
+   do {
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   } while (rid.pageNum == firstRid.pageNum);
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   damagePage(recordFileName, firstRid.pageNum, firstRid.pageNum);
+
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a record of an intact page should not fail.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, firstRid, returnedData);
+   assert(rc != success && "Reading a record of a damaged page should fail.");
+   assert(fileHandle.getCorruptPage() == (PageNum) firstRid.pageNum && "The damaged page should be reported.");
+   cout << "damaged page " << fileHandle.getCorruptPage() << " was found" << endl;
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(recordFileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+   free(buffers);
+   free(page);
+   free(data);
+
+   cout << "[PASS] Test Case 23 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the page checksums
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test23");
+   remove("test23rbfm");
+
+   RC rcmain = RBFTest_23(pfm);
+   return rcmain;
+}
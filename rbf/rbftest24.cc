@@ -0,0 +1,180 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Open the file with nothing of it in the buffer pool
+void openCold(PagedFileManager *pfm, const string &fileName, FileHandle &fileHandle)
+{
+    BufferPoolManager::instance()->discardFile(fileName);
+    RC rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+}
+
+int RBFTest_24(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Create File
+   // 2. Read Page in order, with a stride and without read ahead
+   // 3. Set Read Ahead Pages
+   // 4. Scan of a record based file
+   // 5. Close File
+   cout << endl << "***** In RBF Test Case 24 *****" << endl;
+
+   RC rc;
+   string fileName = "test24";
+   unsigned numPages = 300;
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   void *data = malloc(PAGE_SIZE);
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       memset(data, j, PAGE_SIZE);
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Once two pages come in order the rest are read ahead of the reader
+   unsigned hitCount, missCount, evictCount;
+   FileHandle inOrderHandle;
+   openCold(pfm, fileName, inOrderHandle);
+   for(unsigned j = 0; j < numPages; j++)
+   {
+       rc = inOrderHandle.readPage(j, data);
+       assert(rc == success && *(unsigned char *) data == (j & 0xff) && "Checking the integrity of a page should not fail.");
+   }
+   inOrderHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+   cout << "in order   hits: " << hitCount << " misses: " << missCount << endl;
+   if (inOrderHandle.getAsyncIO() != NULL) {
+       assert(missCount == 2 && hitCount == numPages - 2 && "Only the pages before the read ahead starts should miss.");
+   }
+   rc = pfm->closeFile(inOrderHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Pages far apart are not sequential
+   FileHandle strideHandle;
+   openCold(pfm, fileName, strideHandle);
+   for(unsigned j = 0; j < numPages; j += 10)
+   {
+       rc = strideHandle.readPage(j, data);
+       assert(rc == success && "Reading a page should not fail.");
+   }
+   strideHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+   cout << "stride 10  hits: " << hitCount << " misses: " << missCount << endl;
+   assert(missCount == numPages / 10 && hitCount == 0 && "Reads with a stride should not read ahead.");
+   rc = pfm->closeFile(strideHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Without read ahead every page of a cold file misses
+   FileHandle noReadAheadHandle;
+   openCold(pfm, fileName, noReadAheadHandle);
+   rc = noReadAheadHandle.setReadAheadPages(MAX_READ_AHEAD_PAGES + 1);
+   assert(rc != success && "A read ahead window above the limit should be refused.");
+   rc = noReadAheadHandle.setReadAheadPages(0);
+   assert(rc == success && "Turning read ahead off should not fail.");
+   for(unsigned j = 0; j < 50; j++)
+   {
+       rc = noReadAheadHandle.readPage(j, data);
+       assert(rc == success && "Reading a page should not fail.");
+   }
+   noReadAheadHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+   assert(missCount == 50 && "Without read ahead every page should miss.");
+   rc = pfm->closeFile(noReadAheadHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // A scan only pins pages, it reads ahead all the same
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   string recordFileName = "test24rbfm";
+   rc = rbfm->createFile(recordFileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle loadHandle;
+   rc = rbfm->openFile(recordFileName, loadHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   void *returnedData = malloc(200);
+   int recordSize = 0;
+   int numRecords = 5000;
+   RID rid;
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 25, 177.8, 6200, record, &recordSize);
+   for (int i = 0; i < numRecords; i++) {
+       rc = rbfm->insertRecord(loadHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   unsigned filePages = loadHandle.getNumberOfPages();
+   rc = rbfm->closeFile(loadHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   BufferPoolManager::instance()->discardFile(recordFileName);
+   FileHandle scanHandle;
+   rc = rbfm->openFile(recordFileName, scanHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   vector<string> attributes;
+   attributes.push_back("Age");
+   RBFM_ScanIterator rbfmScanIterator;
+   rc = rbfm->scan(scanHandle, recordDescriptor, "Age", NO_OP, NULL, attributes, rbfmScanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   int count = 0;
+   while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       count++;
+   }
+   rbfmScanIterator.close();
+   scanHandle.collectBufferCounterValues(hitCount, missCount, evictCount);
+   cout << "scan of " << filePages << " pages  hits: " << hitCount << " misses: " << missCount << endl;
+   assert(count == numRecords && "The scan should return every record.");
+   if (scanHandle.getAsyncIO() != NULL) {
+       assert(missCount <= 3 && "The scan should only miss the map page and the pages before the read ahead starts.");
+   }
+   rc = rbfm->closeFile(scanHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(recordFileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+   free(data);
+
+   cout << "[PASS] Test Case 24 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test read ahead of sequential reads
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test24");
+   remove("test24rbfm");
+
+   RC rcmain = RBFTest_24(pfm);
+   return rcmain;
+}
@@ -0,0 +1,252 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "lz4.h"
+#include "wal.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fill a page the way a table of employees would, names repeat and numbers are small
+void fillPage(char *page, unsigned seed)
+{
+    const char *names[] = { "Anteater", "Peter", "Zebra", "Marshall", "Tom" };
+    unsigned offset = 0;
+    for (unsigned i = 0; offset + 24 <= PAGE_SIZE; i++) {
+        const char *name = names[(seed + i) % 5];
+        int age = 20 + (seed * 7 + i) % 40;
+        memcpy(page + offset, name, strlen(name));
+        offset += strlen(name);
+        memcpy(page + offset, &age, sizeof(int));
+        offset += sizeof(int);
+    }
+    memset(page + offset, 0, PAGE_SIZE - offset);
+}
+
+off_t fileSize(const string &fileName)
+{
+    struct stat info;
+    assert(stat(fileName.c_str(), &info) == 0 && "The file should exist.");
+    return info.st_size;
+}
+
+int RBFTest_25(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. LZ4 compress / decompress
+   // 2. Create File with compression
+   // 3. Append Page / Write Page / Read Page of a compressed file
+   // 4. Compression counters
+   // 5. Insert Record / Update Record / Read Record of a compressed record based file
+   // 6. Open File replaying the log through the page map
+   cout << endl << "***** In RBF Test Case 25 *****" << endl;
+
+   RC rc;
+   string fileName = "test25";
+   char *page = (char *) malloc(PAGE_SIZE);
+   char *packed = (char *) malloc(PAGE_SIZE);
+   char *data = (char *) malloc(PAGE_SIZE);
+
+   // The codec gets back what it was given, and refuses what it cannot decode
+   fillPage(page, 1);
+   int length = lz4Compress(page, PAGE_SIZE, packed, PAGE_SIZE);
+   assert(length > 0 && length < PAGE_SIZE / 4 && "A page of repeated names should compress well.");
+   assert(lz4Decompress(packed, length, data, PAGE_SIZE) == PAGE_SIZE && memcmp(page, data, PAGE_SIZE) == 0 && "Decompressing should give the page back.");
+   assert(lz4Decompress(packed, length - 3, data, PAGE_SIZE) != PAGE_SIZE && "A cut off block should not decompress to a page.");
+   assert(lz4Decompress(packed, length, data, PAGE_SIZE / 2) == -1 && "A block bigger than the buffer should be refused.");
+   srand(25);
+   for (unsigned i = 0; i < PAGE_SIZE; i++) {
+       page[i] = rand();
+   }
+   assert(lz4Compress(page, PAGE_SIZE, packed, PAGE_SIZE - 128) == 0 && "Random bytes should not compress.");
+   length = lz4Compress(page, 100, packed, PAGE_SIZE);
+   assert(lz4Decompress(packed, length, data, PAGE_SIZE) == 100 && memcmp(page, data, 100) == 0 && "Short input should round trip.");
+
+   // Pages of a compressed file take a fraction of their size on disk
+   rc = pfm->createFile(fileName, FILE_COMPRESSED | FILE_CHECKSUM);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   unsigned numPages = 200;
+   for (unsigned j = 0; j < numPages; j++) {
+       fillPage(page, j);
+       rc = fileHandle.appendPage(page);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   // and one that does not compress is stored as it is
+   for (unsigned i = 0; i < PAGE_SIZE; i++) {
+       page[i] = rand();
+   }
+   rc = fileHandle.appendPage(page);
+   assert(rc == success && "Appending a page should not fail.");
+   memcpy(data, page, PAGE_SIZE);
+   uint64_t rawBytes, storedBytes, decodedBytes, decodeNanos;
+   rc = fileHandle.collectCompressionCounterValues(rawBytes, storedBytes, decodedBytes, decodeNanos);
+   assert(rc == success && rawBytes == (uint64_t) (numPages + 1) * PAGE_SIZE && "Every page written should be counted.");
+   cout << "compression ratio " << (double) rawBytes / storedBytes << endl;
+   assert(rawBytes > 3 * storedBytes && "The pages should compress.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   off_t written = fileSize(fileName);
+   cout << "file of " << numPages + 1 << " pages takes " << written << " bytes" << endl;
+   assert(written < (off_t) (numPages + 1) * PAGE_SIZE / 3 && "The file should be smaller than its pages.");
+
+   // Read back cold, through the page map saved in the file
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getNumberOfPages() == numPages + 1 && "The file should have every page.");
+   rc = fileHandle.readPage(numPages, page);
+   assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "Reading a page stored as is should not fail.");
+   for (unsigned j = 0; j < numPages; j++) {
+       rc = fileHandle.readPage(j, page);
+       fillPage(data, j);
+       assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "Checking the integrity of a page should not fail.");
+   }
+   rc = fileHandle.collectCompressionCounterValues(rawBytes, storedBytes, decodedBytes, decodeNanos);
+   assert(rc == success && decodedBytes == (uint64_t) numPages * PAGE_SIZE && "Every page decompressed should be counted.");
+   cout << "decoded " << decodedBytes << " bytes at " << (decodeNanos ? decodedBytes * 1000 / decodeNanos : 0) << " MB/s" << endl;
+
+   // Rewritten pages go elsewhere, the old images are reused once the map stops pointing at them
+   for (unsigned round = 0; round < 3; round++) {
+       for (unsigned j = 0; j < numPages; j++) {
+           fillPage(page, j + round + 1);
+           rc = fileHandle.writePage(j, page);
+           assert(rc == success && "Writing a page should not fail.");
+       }
+       rc = fileHandle.flush();
+       assert(rc == success && "Flushing the file should not fail.");
+   }
+   off_t rewritten = fileSize(fileName);
+   cout << "after rewriting every page three times it takes " << rewritten << " bytes" << endl;
+   assert(rewritten < 3 * written && "Space freed by rewrites should be reused.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   for (unsigned j = 0; j < numPages; j++) {
+       rc = fileHandle.readPage(j, page);
+       fillPage(data, j + 3);
+       assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "Checking the integrity of a rewritten page should not fail.");
+   }
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // Pages of a compressed file cannot be mapped
+   rc = pfm->openFile(fileName, fileHandle, IO_MMAP);
+   assert(rc != success && "Mapping a compressed file should fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Records of a compressed file
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   string recordFileName = "test25rbfm";
+   rc = rbfm->createFile(recordFileName, true);
+   assert(rc == success && "Creating the file should not fail.");
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   void *returnedData = malloc(200);
+   int recordSize = 0;
+   int numRecords = 3000;
+   vector<RID> rids;
+   for (int i = 0; i < numRecords; i++) {
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i % 10, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+   unsigned recordPages = fileHandle.getNumberOfPages();
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   cout << recordPages << " pages of records take " << fileSize(recordFileName) << " bytes" << endl;
+   assert(fileSize(recordFileName) < (off_t) recordPages * PAGE_SIZE / 2 && "The records should compress.");
+
+   BufferPoolManager::instance()->discardFile(recordFileName);
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   for (int i = 0; i < numRecords; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i % 10, record, &recordSize);
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a record should not fail.");
+   }
+
+   // A crash after the records changed, the log is replayed into new images
+   for (int i = 1; i < numRecords; i += 3) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 5, "Zebra", 60, 160.5, 9000, record, &recordSize);
+       rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+       assert(rc == success && "Updating a record should not fail.");
+   }
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   string crashName = "test25crash";
+   copyFile(recordFileName, crashName);
+   copyFile(LogManager::getLogName(recordFileName), LogManager::getLogName(crashName));
+   FileHandle crashHandle;
+   rc = rbfm->openFile(crashName, crashHandle);
+   assert(rc == success && "Opening a crashed file should not fail.");
+   for (int i = 0; i < numRecords; i++) {
+       if (i % 3 == 1) {
+           prepareRecord(recordDescriptor.size(), nullsIndicator, 5, "Zebra", 60, 160.5, 9000, record, &recordSize);
+       } else {
+           prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i % 10, record, &recordSize);
+       }
+       rc = rbfm->readRecord(crashHandle, recordDescriptor, rids[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a replayed record should not fail.");
+   }
+   rc = rbfm->closeFile(crashHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(crashName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(recordFileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+   free(page);
+   free(packed);
+   free(data);
+
+   cout << "[PASS] Test Case 25 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test page compression
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test25");
+   remove("test25rbfm");
+   remove("test25crash");
+
+   RC rcmain = RBFTest_25(pfm);
+   return rcmain;
+}
@@ -0,0 +1,279 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+off_t fileSize(const string &fileName)
+{
+    struct stat info;
+    assert(stat(fileName.c_str(), &info) == 0 && "The file should exist.");
+    return info.st_size;
+}
+
+// Records left in the file, found by a scan
+int countRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor)
+{
+    vector<string> attributes;
+    attributes.push_back("Age");
+    RBFM_ScanIterator scanIterator;
+    RC rc = rbfm->scan(fileHandle, recordDescriptor, "Age", NO_OP, NULL, attributes, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    int count = 0;
+    while (scanIterator.getNextRecord(rid, data) != RBFM_EOF) {
+        count++;
+    }
+    scanIterator.close();
+    free(data);
+    return count;
+}
+
+int RBFTest_26(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Free Page / Allocate Page
+   // 2. The free list kept in the header across Open File
+   // 3. Truncate
+   // 4. Delete Record giving empty pages back, Insert Record reusing them
+   // 5. Scan over freed pages
+   // 6. Delete Record of a moved record before its page is reused
+   cout << endl << "***** In RBF Test Case 26 *****" << endl;
+
+   RC rc;
+   string fileName = "test26";
+   char *page = (char *) malloc(PAGE_SIZE);
+   char *data = (char *) malloc(PAGE_SIZE);
+
+   rc = pfm->createFile(fileName, FILE_CHECKSUM);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   unsigned numPages = 20;
+   for (unsigned j = 0; j < numPages; j++) {
+       memset(page, 'a' + j, PAGE_SIZE);
+       rc = fileHandle.appendPage(page);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+
+   // Freed pages are kept in a list, each of them once
+   PageNum freed[] = { 5, 10, 19, 18 };
+   for (unsigned i = 0; i < 4; i++) {
+       rc = fileHandle.freePage(freed[i]);
+       assert(rc == success && "Freeing a page should not fail.");
+   }
+   assert(fileHandle.getFreePageCount() == 4 && "Every freed page should be counted.");
+   rc = fileHandle.freePage(5);
+   assert(rc != success && "Freeing a page twice should fail.");
+   rc = fileHandle.freePage(numPages);
+   assert(rc != success && "Freeing a page past the end should fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // The list is in the file, the last page freed is handed out first
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getFreePageCount() == 4 && "The free list should survive closing the file.");
+   memset(page, 'z', PAGE_SIZE);
+   PageNum pageNum;
+   rc = fileHandle.allocatePage(page, pageNum);
+   assert(rc == success && pageNum == 18 && "Allocating should reuse the last page freed.");
+   assert(fileHandle.getNumberOfPages() == numPages && fileHandle.getFreePageCount() == 3 && "Reusing a page should not grow the file.");
+   rc = fileHandle.readPage(pageNum, data);
+   assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "The reused page should hold what was allocated.");
+
+   // Truncate cuts the free pages at the end off the file
+   rc = fileHandle.freePage(18);
+   assert(rc == success && "Freeing a page should not fail.");
+   rc = fileHandle.truncate();
+   assert(rc == success && "Truncating the file should not fail.");
+   assert(fileHandle.getNumberOfPages() == 18 && fileHandle.getFreePageCount() == 2 && "The two free pages at the end should be gone.");
+   assert(fileSize(fileName) == pageOffset(18) && "The file should shrink.");
+   rc = fileHandle.readPage(18, data);
+   assert(rc != success && "Reading a page cut off should fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getNumberOfPages() == 18 && fileHandle.getFreePageCount() == 2 && "The truncated file should stay truncated.");
+   rc = fileHandle.allocatePage(page, pageNum);
+   assert(rc == success && pageNum == 10 && "The pages that stayed should still be in the list.");
+   rc = fileHandle.allocatePage(page, pageNum);
+   assert(rc == success && pageNum == 5 && "The pages that stayed should still be in the list.");
+   rc = fileHandle.allocatePage(page, pageNum);
+   assert(rc == success && pageNum == 18 && fileHandle.getNumberOfPages() == 19 && "With no free page left the file should grow.");
+   for (unsigned j = 0; j < 18; j++) {
+       rc = fileHandle.readPage(j, data);
+       memset(page, j == 5 || j == 10 ? 'z' : 'a' + j, PAGE_SIZE);
+       assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "Checking the integrity of a page should not fail.");
+   }
+
+   // A list that no longer matches the pages, as after a crash, is dropped
+   rc = fileHandle.freePage(3);
+   assert(rc == success && "Freeing a page should not fail.");
+   rc = fileHandle.writePage(3, page);
+   assert(rc == success && "Writing a page should not fail.");
+   rc = fileHandle.allocatePage(page, pageNum);
+   assert(rc == success && pageNum == 19 && fileHandle.getFreePageCount() == 0 && "A page in use should not be handed out again.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Pages emptied by deletes are reused by inserts
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   string recordFileName = "test26rbfm";
+   rc = rbfm->createFile(recordFileName);
+   assert(rc == success && "Creating the file should not fail.");
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   void *returnedData = malloc(200);
+   int recordSize = 0;
+   int numRecords = 2000;
+   vector<RID> rids;
+   for (int i = 0; i < numRecords; i++) {
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+   unsigned recordPages = fileHandle.getNumberOfPages();
+
+   // the first half of the records leaves its pages empty, the scan walks past them
+   for (int i = 0; i < numRecords / 2; i++) {
+       rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+       assert(rc == success && "Deleting a record should not fail.");
+   }
+   unsigned freedPages = fileHandle.getFreePageCount();
+   cout << freedPages << " of " << recordPages << " pages freed" << endl;
+   assert(freedPages > 0 && freedPages < recordPages && "Pages left empty should be freed.");
+   assert(countRecords(rbfm, fileHandle, recordDescriptor) == numRecords / 2 && "The scan should skip the freed pages.");
+   for (int i = numRecords / 2; i < numRecords; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i, record, &recordSize);
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a record should not fail.");
+   }
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // after reopening, new records go into the freed pages before the file grows
+   BufferPoolManager::instance()->discardFile(recordFileName);
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   assert(fileHandle.getFreePageCount() == freedPages && "The free list should survive closing the file.");
+   for (int i = 0; i < numRecords / 2; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Aardvark", 20 + i % 40, 160.5, 9000 + i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   cout << "file has " << fileHandle.getNumberOfPages() << " pages after inserting again" << endl;
+   assert(fileHandle.getNumberOfPages() == recordPages && fileHandle.getFreePageCount() == 0 && "Inserts should fill the freed pages.");
+   for (int i = 0; i < numRecords; i++) {
+       if (i < numRecords / 2) {
+           prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Aardvark", 20 + i % 40, 160.5, 9000 + i, record, &recordSize);
+       } else {
+           prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i, record, &recordSize);
+       }
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a record should not fail.");
+   }
+   assert(countRecords(rbfm, fileHandle, recordDescriptor) == numRecords && "The scan should find every record.");
+
+   // deleting everything and truncating leaves the free space map page
+   for (int i = 0; i < numRecords; i++) {
+       rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+       assert(rc == success && "Deleting a record should not fail.");
+   }
+   rc = fileHandle.truncate();
+   assert(rc == success && "Truncating the file should not fail.");
+   assert(fileHandle.getNumberOfPages() == 1 && fileHandle.getFreePageCount() == 0 && "Only the free space map page should be left.");
+   assert(fileSize(recordFileName) == pageOffset(1) && "The file should shrink to the map page.");
+   RID rid;
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+   assert(rc == success && rid.pageNum == 1 && "The file should grow again after a truncate.");
+   assert(countRecords(rbfm, fileHandle, recordDescriptor) == 1 && "The scan should find the new record only.");
+
+   // A record moved off a full page by an update and then deleted leaves a
+   // tombstone, not a pointer into the page an insert reuses next
+   while (rid.pageNum == 1) {
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
+   assert(rc == success && fileHandle.getFreePageCount() == 1 && "The second page should be freed.");
+   RID moved;
+   moved.pageNum = 1;
+   moved.slotNum = 0;
+   string longName(100, 'x');
+   prepareRecord(recordDescriptor.size(), nullsIndicator, longName.size(), longName, 30, 170.5, 7000, record, &recordSize);
+   rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, moved);
+   assert(rc == success && fileHandle.getFreePageCount() == 0 && "The record should move to the freed page.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, moved, returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "A moved record should be read through its pointer.");
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, moved);
+   assert(rc == success && fileHandle.getFreePageCount() == 1 && "The page the record moved to should be freed.");
+   prepareRecord(recordDescriptor.size(), nullsIndicator, longName.size(), longName, 40, 150.5, 8000, record, &recordSize);
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+   assert(rc == success && rid.pageNum == 2 && fileHandle.getFreePageCount() == 0 && "The freed page should be reused.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, moved, returnedData);
+   assert(rc != success && "A deleted moved record should stay deleted after its page is reused.");
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, moved);
+   assert(rc != success && "A deleted moved record should not be deleted again.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "The record in the reused page should be read.");
+   RID stale = rid;
+   stale.slotNum = 50;
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, stale, returnedData);
+   assert(rc != success && "A slot past the directory should not be read.");
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(recordFileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+   free(page);
+   free(data);
+
+   cout << "[PASS] Test Case 26 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test freeing and reusing pages
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test26");
+   remove("test26rbfm");
+
+   RC rcmain = RBFTest_26(pfm);
+   return rcmain;
+}
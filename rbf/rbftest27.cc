@@ -0,0 +1,165 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <chrono>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_27(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Share File / Release File
+   // 2. Destroy File while the file is shared
+   // 3. Shared files left open at exit
+   cout << endl << "***** In RBF Test Case 27 *****" << endl;
+
+   RC rc;
+   string fileName = "test27";
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   void *returnedData = malloc(200);
+   int recordSize = 0;
+
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+
+   // every user of the file gets the same handle
+   FileHandle *first;
+   FileHandle *second;
+   rc = rbfm->shareFile(fileName, first);
+   assert(rc == success && "Sharing the file should not fail.");
+   rc = rbfm->shareFile(fileName, second);
+   assert(rc == success && first == second && "Sharing the file again should give the same handle.");
+
+   RID rid;
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 25, 177.8, 6200, record, &recordSize);
+   rc = rbfm->insertRecord(*first, recordDescriptor, record, rid);
+   assert(rc == success && "Inserting a record should not fail.");
+
+   // the file stays open until its last user lets go
+   rc = rbfm->releaseFile(first);
+   assert(rc == success && "Releasing the file should not fail.");
+   rc = rbfm->readRecord(*second, recordDescriptor, rid, returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "The handle should still be open for its other user.");
+   rc = rbfm->releaseFile(second);
+   assert(rc == success && "Releasing the file should not fail.");
+   rc = rbfm->releaseFile(second);
+   assert(rc != success && "Releasing a closed file should fail.");
+
+   // opening and closing again is a lookup while someone holds the file
+   int rounds = 10000;
+   FileHandle *holder;
+   rc = rbfm->shareFile(fileName, holder);
+   assert(rc == success && "Sharing the file should not fail.");
+   auto start = chrono::steady_clock::now();
+   for (int i = 0; i < rounds; i++) {
+       FileHandle *fileHandle;
+       rc = rbfm->shareFile(fileName, fileHandle);
+       assert(rc == success && fileHandle == holder && "Sharing the file should not fail.");
+       rc = rbfm->releaseFile(fileHandle);
+       assert(rc == success && "Releasing the file should not fail.");
+   }
+   double shared = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / rounds;
+   FileHandle fileHandle;
+   start = chrono::steady_clock::now();
+   for (int i = 0; i < rounds / 100; i++) {
+       rc = rbfm->openFile(fileName, fileHandle);
+       assert(rc == success && "Opening the file should not fail.");
+       rc = rbfm->closeFile(fileHandle);
+       assert(rc == success && "Closing the file should not fail.");
+   }
+   double opened = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / (rounds / 100);
+   cout << "share and release " << shared << " us, open and close " << opened << " us" << endl;
+
+   // a file destroyed and made again under its name gets a handle of its own
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   rc = rbfm->shareFile(fileName, first);
+   assert(rc == success && first != holder && "The new file should not get the old handle.");
+   assert(first->getNumberOfPages() == 0 && "The new file should be empty.");
+   rc = rbfm->releaseFile(holder);
+   assert(rc == success && "Releasing the old file should not fail.");
+   rc = rbfm->releaseFile(first);
+   assert(rc == success && "Releasing the file should not fail.");
+
+   // a process that exits without releasing still leaves its records in the file
+   int numRecords = 500;
+   pid_t pid = fork();
+   assert(pid >= 0 && "Forking should not fail.");
+   if (pid == 0) {
+       FileHandle *child;
+       if (rbfm->shareFile(fileName, child) == -1) {
+           _exit(1);
+       }
+       for (int i = 0; i < numRecords; i++) {
+           prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i, record, &recordSize);
+           if (rbfm->insertRecord(*child, recordDescriptor, record, rid) == -1) {
+               _exit(1);
+           }
+       }
+       exit(0);
+   }
+   int status;
+   waitpid(pid, &status, 0);
+   assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "The child should insert its records.");
+
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", NO_OP, NULL, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   int count = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       int salary;
+       memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+       assert(salary == 6200 + count && "The records should be in the order they were inserted.");
+       count++;
+   }
+   scanIterator.close();
+   assert(count == numRecords && "Every record the child inserted should be in the file.");
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 27 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test sharing open files
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test27");
+
+   RC rcmain = RBFTest_27(rbfm);
+   return rcmain;
+}
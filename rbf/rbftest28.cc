@@ -0,0 +1,178 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_28(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Latency histogram buckets and percentiles
+   // 2. Reads, writes and syncs timed per file, sequential or random
+   // 3. Log writes and syncs of a logged file
+   // 4. JSON dump
+   cout << endl << "***** In RBF Test Case 28 *****" << endl;
+
+   RC rc;
+
+   // every latency lands in the bucket whose range holds it
+   for (unsigned bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+       uint64_t high = LatencyHistogram::bucketHigh(bucket);
+       assert(LatencyHistogram::bucketOf(high) == bucket && "The highest latency of a bucket should fall in it.");
+       assert((bucket == 0 || LatencyHistogram::bucketOf(LatencyHistogram::bucketHigh(bucket - 1) + 1) == bucket) && "The buckets should have no gaps.");
+   }
+   LatencyHistogram histogram;
+   for (uint64_t nanos = 1; nanos <= 1000; nanos++) {
+       histogram.record(nanos * 1000);
+   }
+   assert(histogram.getCount() == 1000 && histogram.getMaxNanos() == 1000000 && "Every latency should be counted.");
+   uint64_t p50 = histogram.getPercentile(50);
+   uint64_t p99 = histogram.getPercentile(99);
+   assert(p50 >= 500000 && p50 <= 500000 * 9 / 8 && "The median should be within a bucket of the real one.");
+   assert(p99 >= 990000 && p99 <= 1000000 && "The 99th percentile should be within a bucket of the real one.");
+   assert(histogram.getPercentile(100) == 1000000 && "The last percentile should be the largest latency.");
+
+   // recording is cheap enough to leave on
+   int rounds = 1000000;
+   uint64_t start = ioClock();
+   for (int i = 0; i < rounds; i++) {
+       histogram.record(i & 0xffff);
+   }
+   cout << "recording a latency takes " << (double) (ioClock() - start) / rounds << " ns" << endl;
+
+   string fileName = "test28";
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   IOStats *stats = fileHandle.getIOStats();
+   assert(stats != NULL && stats == IOStatsManager::instance()->getStats(fileName) && "An open file should have its stats.");
+
+   unsigned numPages = 64;
+   char *page = (char *) malloc(PAGE_SIZE);
+   for (unsigned j = 0; j < numPages; j++) {
+       memset(page, 'a' + j % 26, PAGE_SIZE);
+       rc = fileHandle.appendPage(page);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   rc = fileHandle.sync();
+   assert(rc == success && "Syncing the file should not fail.");
+
+   uint64_t count, bytes, sequential, random, nanos;
+   stats->collectOpValues(IO_OP_WRITE, count, bytes, sequential, random, nanos);
+   cout << "write: " << count << " transfers, " << bytes << " bytes, " << sequential << " sequential" << endl;
+   assert(bytes >= (uint64_t) numPages * PAGE_SIZE && sequential > 0 && "The appended pages should have been written.");
+   stats->collectOpValues(IO_OP_SYNC, count, bytes, sequential, random, nanos);
+   assert(count == 1 && sequential + random == 0 && "The sync should be counted, and be neither sequential nor random.");
+
+   // reads from disk, one page at a time in order and then spread out
+   fileHandle.setReadAheadPages(0);
+   BufferPoolManager::instance()->discardFile(fileName);
+   stats->collectOpValues(IO_OP_READ, count, bytes, sequential, random, nanos);
+   uint64_t readsBefore = count;
+   uint64_t sequentialBefore = sequential;
+   for (unsigned j = 0; j < numPages; j++) {
+       rc = fileHandle.readPage(j, page);
+       assert(rc == success && "Reading a page should not fail.");
+   }
+   stats->collectOpValues(IO_OP_READ, count, bytes, sequential, random, nanos);
+   assert(count - readsBefore == numPages && sequential - sequentialBefore >= numPages - 1 && "Reading in order should be sequential.");
+
+   BufferPoolManager::instance()->discardFile(fileName);
+   uint64_t randomBefore = random;
+   for (unsigned j = 0; j < numPages; j += 7) {
+       rc = fileHandle.readPage((j * 13) % numPages, page);
+       assert(rc == success && "Reading a page should not fail.");
+   }
+   stats->collectOpValues(IO_OP_READ, count, bytes, sequential, random, nanos);
+   assert(random - randomBefore >= numPages / 7 && "Reading spread out pages should be random.");
+   assert(stats->getHistogram(IO_OP_READ).getCount() == count && nanos > 0 && "Every read should be timed.");
+
+   // the stats stay after closing, for the next handle and the dump
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   assert(IOStatsManager::instance()->getStats(fileName) == stats && "The stats should outlive the handle.");
+
+   // a logged file times its log too
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+   string recordFileName = "test28rbfm";
+   rc = rbfm->createFile(recordFileName);
+   assert(rc == success && "Creating the file should not fail.");
+   rc = rbfm->openFile(recordFileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(200);
+   int recordSize = 0;
+   for (int i = 0; i < 100; i++) {
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 20 + i % 40, 177.8, 6200 + i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   IOStats *recordStats = fileHandle.getIOStats();
+   recordStats->collectOpValues(IO_OP_LOG_WRITE, count, bytes, sequential, random, nanos);
+   assert(count > 0 && bytes > 0 && "The log records should have been written.");
+   recordStats->collectOpValues(IO_OP_LOG_SYNC, count, bytes, sequential, random, nanos);
+   assert(count > 0 && "The log should have been synced.");
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // both files are in the dump
+   ostringstream out;
+   rc = IOStatsManager::instance()->dumpJSON(out);
+   assert(rc == success && "Dumping the stats should not fail.");
+   string json = out.str();
+   cout << json.substr(0, 300) << "..." << endl;
+   assert(json.compare(0, 10, "{\"files\":[") == 0 && "The dump should list the files.");
+   assert(json.find("\"file\":\"test28\"") != string::npos && json.find("\"file\":\"test28rbfm\"") != string::npos && "Every file should be in the dump.");
+   assert(json.find("\"logSync\":{\"count\":") != string::npos && json.find("\"p99\":") != string::npos && "Every operation should be in the dump.");
+   rc = IOStatsManager::instance()->dumpJSON(string("test28.json"));
+   assert(rc == success && "Dumping the stats into a file should not fail.");
+   remove("test28.json");
+
+   // destroying a file drops its stats
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+   assert(IOStatsManager::instance()->getStats(fileName) == NULL && "A destroyed file should have no stats.");
+   rc = rbfm->destroyFile(recordFileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(nullsIndicator);
+   free(page);
+
+   cout << "[PASS] Test Case 28 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the I/O stats of a file
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test28");
+   remove("test28rbfm");
+
+   RC rcmain = RBFTest_28(pfm);
+   return rcmain;
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_29(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Insert Record into the lowest pages with room once the last page is full
+   // 2. Insert Record preferring a page the buffer pool holds
+   // 3. Insert Record cost as the file grows
+   cout << endl << "***** In RBF Test Case 29 *****" << endl;
+
+   RC rc;
+   string fileName = "test29";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   int nameLength = PAGE_SIZE / 8;
+   string name(nameLength, 'n');
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   int recordSize = 0;
+
+   // enough records to go past the first free space map page, the
+   // inserts should not slow down as the file grows
+   vector<RID> rids;
+   int chunk = FSM_INTERVAL * 9 / 4;
+   int numRecords = chunk * 4;
+   for (int i = 0; i < numRecords; i += chunk) {
+       uint64_t start = ioClock();
+       for (int j = i; j < i + chunk; j++) {
+           RID rid;
+           prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, j % 60, 170.1, j, record, &recordSize);
+           rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+           assert(rc == success && "Inserting a record should not fail.");
+           rids.push_back(rid);
+       }
+       cout << "records " << i << " to " << i + chunk << ": " << (double) (ioClock() - start) / chunk << " ns per insert" << endl;
+   }
+
+   // fill the last page so it cannot take the next record
+   unsigned room = recordSize + SLOT_SIZE + 1;
+   while (fileHandle.freeSpace[fileHandle.getNumberOfPages() - 1] >= room) {
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, 0, 170.1, rids.size(), record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+   unsigned numPages = fileHandle.getNumberOfPages();
+   cout << rids.size() << " records on " << numPages << " pages" << endl;
+   assert(numPages > FSM_INTERVAL && "The file should have more than one free space map page.");
+
+   // make room on every 50th page by deleting two of its records
+   vector<PageNum> holes;
+   vector<bool> deleted(rids.size(), false);
+   for (unsigned i = 0; i + 1 < rids.size(); i++) {
+       if (rids[i].pageNum % 50 != 7 || rids[i].pageNum != rids[i + 1].pageNum
+           || (!holes.empty() && holes.back() == (PageNum) rids[i].pageNum)) {
+           continue;
+       }
+       for (unsigned j = i; j <= i + 1; j++) {
+           rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[j]);
+           assert(rc == success && "Deleting a record should not fail.");
+           deleted[j] = true;
+       }
+       holes.push_back(rids[i].pageNum);
+   }
+   assert(holes.size() > FIT_CANDIDATES && "Records should have been deleted across the file.");
+
+   // with no page in the pool the lowest page with room is taken, with one
+   // of the candidates in the pool that one is
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+   BufferPoolManager::instance()->discardFile(fileName);
+   PageNum cachedHole = holes[FIT_CANDIDATES / 2];
+   for (unsigned i = 0; i < rids.size(); i++) {
+       if ((PageNum) rids[i].pageNum == cachedHole && !deleted[i]) {
+           rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+           assert(rc == success && "Reading a record should not fail.");
+           break;
+       }
+   }
+   RID rid;
+   prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, 1, 170.1, -1, record, &recordSize);
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+   assert(rc == success && (PageNum) rid.pageNum == cachedHole && "The insert should go to the page in the buffer pool.");
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+   BufferPoolManager::instance()->discardFile(fileName);
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+   assert(rc == success && (PageNum) rid.pageNum == holes[0] && "The insert should go to the lowest page with room.");
+
+   // every other hole takes a record before the file grows
+   vector<RID> inserted;
+   for (unsigned i = 2; i < holes.size(); i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, 2, 170.1, -2 - i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       inserted.push_back(rid);
+   }
+   assert(fileHandle.getNumberOfPages() == numPages && "The holes should be filled before the file grows.");
+   for (unsigned i = 0; i < inserted.size(); i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, 2, 170.1, -2 - (i + 2), record, &recordSize);
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, inserted[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading an inserted record should not fail.");
+   }
+   for (unsigned i = 0; i < rids.size(); i += 97) {
+       if (deleted[i]) {
+           continue;
+       }
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, i < (unsigned) numRecords ? i % 60 : 0, 170.1, i, record, &recordSize);
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+       assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a record should not fail.");
+   }
+
+   // the file reopened finds the same room
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 3, 170.1, 3, record, &recordSize);
+   rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+   assert(rc == success && (PageNum) rid.pageNum < numPages && "A small record should find room without growing the file.");
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 29 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test finding pages with room
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test29");
+
+   RC rcmain = RBFTest_29(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Time a scan of every record of the file, returns the records seen
+static int timeScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, void *returnedData, double &nanosPerRecord)
+{
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   RC rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", NO_OP, NULL, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   int count = 0;
+   uint64_t start = ioClock();
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       count++;
+   }
+   nanosPerRecord = (double) (ioClock() - start) / max(count, 1);
+   scanIterator.close();
+   return count;
+}
+
+int RBFTest_30(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Slot count and free slot chain in the page header
+   // 2. Insert Record reusing the slots of deleted records
+   // 3. Update Record of a forwarded record keeping the record count
+   // 4. Scan cost per record on pages with many slots
+   cout << endl << "***** In RBF Test Case 30 *****" << endl;
+
+   RC rc;
+   string fileName = "test30";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   void *page = malloc(PAGE_SIZE);
+   int recordSize = 0;
+
+   // fill the first data page with small records
+   vector<RID> rids;
+   RID rid;
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 1, "a", 1, 170.1, 0, record, &recordSize);
+   unsigned room = recordSize + SLOT_SIZE + 1;
+   do {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 1, "a", 1, 170.1, rids.size(), record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   } while (fileHandle.freeSpace[rid.pageNum] >= room);
+   PageNum pageNum = rids[0].pageNum;
+   int numSlots = rids.size();
+   assert(fileHandle.getNumberOfPages() == pageNum + 1 && "The records should fit on one page.");
+   rc = fileHandle.readPage(pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   assert(RecordBasedFileManager::extractNumSlots(page) == numSlots && RecordBasedFileManager::extractNumRecords(page) == numSlots && "Every slot should hold a record.");
+   assert(RecordBasedFileManager::getStartOfDirectoryOffset(page) == PAGE_DATA_SIZE - (numSlots * SLOT_SIZE + META_INFO) && "The directory should start below its last slot.");
+   cout << numSlots << " slots on page " << pageNum << endl;
+
+   // deleting every third record leaves tombstones behind, the directory keeps its size
+   vector<bool> deleted(numSlots, false);
+   int numDeleted = 0;
+   for (int i = 0; i < numSlots; i += 3) {
+       rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+       assert(rc == success && "Deleting a record should not fail.");
+       deleted[i] = true;
+       numDeleted++;
+   }
+   rc = fileHandle.readPage(pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   assert(RecordBasedFileManager::extractNumSlots(page) == numSlots && RecordBasedFileManager::extractNumRecords(page) == numSlots - numDeleted && "Deleted records should leave their slots.");
+   for (int i = 0; i < numSlots; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 1, "a", 1, 170.1, i, record, &recordSize);
+       rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+       assert((deleted[i] ? rc != success : rc == success && memcmp(record, returnedData, recordSize) == 0) && "Only the deleted records should be gone.");
+   }
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[0]);
+   assert(rc != success && "Deleting a tombstone should fail.");
+
+   // the freed slots are handed out again before the directory grows, the last freed
+   // first. The room left over may not take the last one
+   vector<bool> reused(numSlots, false);
+   for (int i = 0; i < numDeleted - 1; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 1, "b", 2, 170.1, -1 - i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       assert((PageNum) rid.pageNum == pageNum && deleted[rid.slotNum] && !reused[rid.slotNum] && "The insert should take a freed slot.");
+       assert((i != 0 || (int) rid.slotNum == (numDeleted - 1) * 3) && "The last slot freed should be taken first.");
+       reused[rid.slotNum] = true;
+       rids[rid.slotNum] = rid;
+   }
+   rc = fileHandle.readPage(pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   assert(RecordBasedFileManager::extractNumSlots(page) == numSlots && RecordBasedFileManager::extractNumRecords(page) == numSlots - 1 && "Reusing slots should not grow the directory.");
+   assert(!reused[0] && "The first slot freed should be taken last.");
+
+   // a record moved off the page by an update, then updated again where it went
+   RID moved = rids[1];
+   int nameLength = PAGE_SIZE / 2;
+   string name(nameLength, 'n');
+   prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, 3, 170.1, 3, record, &recordSize);
+   rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, moved);
+   assert(rc == success && "Updating a record should not fail.");
+   prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength - 1, name, 4, 170.1, 4, record, &recordSize);
+   rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, moved);
+   assert(rc == success && "Updating a forwarded record should not fail.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, moved, returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading a forwarded record should not fail.");
+   rc = fileHandle.readPage(pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   assert(RecordBasedFileManager::extractNumRecords(page) == numSlots - 1 && "The pointer should be counted once.");
+
+   // an update that fits takes back the record's own slot
+   prepareRecord(recordDescriptor.size(), nullsIndicator, 2, "cc", 5, 170.1, 5, record, &recordSize);
+   rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[2]);
+   assert(rc == success && "Updating a record should not fail.");
+   rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[2], returnedData);
+   assert(rc == success && memcmp(record, returnedData, recordSize) == 0 && "Reading an updated record should not fail.");
+   rc = fileHandle.readPage(pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   assert(RecordBasedFileManager::extractNumSlots(page) == numSlots && RecordBasedFileManager::extractNumRecords(page) == numSlots - 1 && "An update in place should keep its slot.");
+
+   // the scan skips the tombstone and sees the moved record once, on its new page
+   double nanos;
+   int expected = numSlots - 1;
+   assert(timeScan(rbfm, fileHandle, recordDescriptor, returnedData, nanos) == expected && "The scan should return every record.");
+
+   // per record, a scan over pages of many slots costs what one over pages of few does
+   string bigName = "test30big";
+   rc = rbfm->createFile(bigName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle bigHandle;
+   rc = rbfm->openFile(bigName, bigHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   for (int i = 0; i < 2000; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, PAGE_SIZE / 8, string(PAGE_SIZE / 8, 'n'), 1, 170.1, i, record, &recordSize);
+       rc = rbfm->insertRecord(bigHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   for (int i = expected; i < 100000; i++) {
+       prepareRecord(recordDescriptor.size(), nullsIndicator, 1, "a", 1, 170.1, i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+   double bigNanos;
+   assert(timeScan(rbfm, bigHandle, recordDescriptor, returnedData, bigNanos) == 2000 && "The scan should return every record.");
+   assert(timeScan(rbfm, fileHandle, recordDescriptor, returnedData, nanos) == 100000 && "The scan should return every record.");
+   cout << "scan " << bigNanos << " ns per record with a few slots a page, "
+        << nanos << " ns with " << numSlots << endl;
+
+   rc = rbfm->closeFile(bigHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(bigName);
+   assert(rc == success && "Destroying the file should not fail.");
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(page);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 30 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the slot directory of a page
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test30");
+   remove("test30big");
+
+   RC rcmain = RBFTest_30(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_31(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Record View of a record in a page
+   // 2. Read Attribute of a null field and of a moved record
+   // 3. Scan projecting null fields
+   cout << endl << "***** In RBF Test Case 31 *****" << endl;
+
+   RC rc;
+   string fileName = "test31";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   void *page = malloc(PAGE_SIZE);
+   int recordSize = 0;
+   string name = "Anteaters";
+
+   // every fifth record has no age
+   int numRecords = 1000;
+   vector<RID> rids;
+   for (int i = 0; i < numRecords; i++) {
+       memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+       if (i % 5 == 0) {
+           nullsIndicator[0] = 0x40;
+       }
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, i % 9 + 1, name, 20 + i % 40, 150.5 + i, i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+
+   // the view reads every field where it lies in the page
+   for (int i = 0; i < numRecords; i += 7) {
+       rc = fileHandle.readPage(rids[i].pageNum, page);
+       assert(rc == success && "Reading a page should not fail.");
+       RecordView view;
+       assert(view.fromSlot(page, rids[i].slotNum) && view.getNumFields() == 4 && "The slot should hold a record.");
+       assert(!view.isNull(0) && view.getVarCharLength(0) == i % 9 + 1 && memcmp(view.getVarChar(0), name.c_str(), i % 9 + 1) == 0 && "The name should be read in place.");
+       assert(view.getFieldLength(0) == (int) sizeof(int) + i % 9 + 1 && "A name takes its length and its characters.");
+       if (i % 5 == 0) {
+           assert(view.isNull(1) && view.getFieldLength(1) == 0 && "A null age should take no room.");
+       } else {
+           assert(!view.isNull(1) && view.getInt(1) == 20 + i % 40 && view.getFieldLength(1) == sizeof(int) && "The age should be read in place.");
+       }
+       assert(view.getReal(2) == (float) (150.5 + i) && view.getInt(3) == i && "The height and salary should be read in place.");
+       assert(view.isNull(4) && view.getFieldLength(4) == 0 && "A field the record does not have should count as null.");
+   }
+   rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[1]);
+   assert(rc == success && "Deleting a record should not fail.");
+   rc = fileHandle.readPage(rids[1].pageNum, page);
+   assert(rc == success && "Reading a page should not fail.");
+   RecordView deleted;
+   assert(!deleted.fromSlot(page, rids[1].slotNum) && "A tombstone should have no record.");
+
+   // a null attribute comes back as its null indicator
+   rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[5], "Age", returnedData);
+   assert(rc == success && ((unsigned char *) returnedData)[0] == 0x80 && "A null attribute should be flagged null.");
+   rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[6], "Age", returnedData);
+   int value;
+   memcpy(&value, (char *) returnedData + 1, sizeof(int));
+   assert(rc == success && ((unsigned char *) returnedData)[0] == 0 && value == 26 && "An attribute should be read.");
+
+   // a record moved off its page is still found through its first RID
+   int nameLength = PAGE_SIZE / 2;
+   string longName(nameLength, 'n');
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, longName, 30, 170.1, 2, record, &recordSize);
+   rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[2]);
+   assert(rc == success && "Updating a record should not fail.");
+   rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[2], "Salary", returnedData);
+   memcpy(&value, (char *) returnedData + 1, sizeof(int));
+   assert(rc == success && value == 2 && "An attribute of a moved record should be read.");
+   rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[1], "Salary", returnedData);
+   assert(rc != success && "An attribute of a deleted record should not be read.");
+
+   // the scan flags the null age at its place among the projected attributes
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   attributes.push_back("Age");
+   attributes.push_back("EmpName");
+   int threshold = 500;
+   RBFM_ScanIterator scanIterator;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", GE_OP, &threshold, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   int count = 0;
+   uint64_t start = ioClock();
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       unsigned char nulls = ((unsigned char *) returnedData)[0];
+       int salary;
+       memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+       assert(salary >= threshold && salary < numRecords && "The scan should only return records that meet the condition.");
+       int offset = 1 + sizeof(int);
+       if (salary % 5 == 0) {
+           assert(nulls == 0x40 && "The age should be flagged null.");
+       } else {
+           int age;
+           memcpy(&age, (char *) returnedData + offset, sizeof(int));
+           assert(nulls == 0 && age == 20 + salary % 40 && "The age should follow the salary.");
+           offset += sizeof(int);
+       }
+       int length;
+       memcpy(&length, (char *) returnedData + offset, sizeof(int));
+       assert(length == salary % 9 + 1 && memcmp((char *) returnedData + offset + sizeof(int), name.c_str(), length) == 0 && "The name should follow.");
+       count++;
+   }
+   cout << "scan " << (double) (ioClock() - start) / max(count, 1) << " ns per record" << endl;
+   scanIterator.close();
+   assert(count == numRecords - threshold && "The scan should return every record that meets the condition.");
+
+   // strings compare in place, a prefix goes first
+   attributes.clear();
+   attributes.push_back("Salary");
+   char shortName[sizeof(int) + 3];
+   int shortLength = 3;
+   memcpy(shortName, &shortLength, sizeof(int));
+   memcpy(shortName + sizeof(int), "Ant", shortLength);
+   rc = rbfm->scan(fileHandle, recordDescriptor, "EmpName", EQ_OP, shortName, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   count = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       int salary;
+       memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+       assert(salary % 9 == 2 && "Only the names of three letters should match.");
+       count++;
+   }
+   scanIterator.close();
+   assert(count > 0 && "The scan should return the records with the name.");
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(page);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 31 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test reading records in place
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test31");
+
+   RC rcmain = RBFTest_31(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Values of record i, the age of every seventh record is null
+static string nameOf(int i) { return string(i % 5 + 1, 'a' + i % 26); }
+static bool ageIsNull(int i) { return i % 7 == 0; }
+static int ageOf(int i) { return i % 50; }
+static float heightOf(int i) { return (i % 40) * 0.5; }
+
+template <class T>
+static bool holds(T left, CompOp op, T right)
+{
+   switch (op) {
+       case EQ_OP: return left == right;
+       case LT_OP: return left < right;
+       case GT_OP: return left > right;
+       case LE_OP: return left <= right;
+       case GE_OP: return left >= right;
+       case NE_OP: return left != right;
+       default:    return true;
+   }
+}
+
+// Scan for the condition and check the salaries that come back against the records that meet it
+static int checkScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                     const string &attribute, CompOp op, const void *value, const vector<bool> &expected, void *returnedData)
+{
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   RC rc = rbfm->scan(fileHandle, recordDescriptor, attribute, op, value, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   int count = 0;
+   vector<bool> seen(expected.size(), false);
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       int salary;
+       memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+       assert(salary >= 0 && salary < (int) expected.size() && expected[salary] && !seen[salary] && "Only the records that meet the condition should come back, once.");
+       seen[salary] = true;
+       count++;
+   }
+   scanIterator.close();
+   for (unsigned i = 0; i < expected.size(); i++) {
+       assert((!expected[i] || seen[i]) && "Every record that meets the condition should come back.");
+   }
+   return count;
+}
+
+int RBFTest_32(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Scan with every operator on ints, reals and strings
+   // 2. Scan with no condition, over null condition attributes
+   // 3. Scan with a condition it cannot decode
+   cout << endl << "***** In RBF Test Case 32 *****" << endl;
+
+   RC rc;
+   string fileName = "test32";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   int recordSize = 0;
+
+   int numRecords = 3000;
+   for (int i = 0; i < numRecords; i++) {
+       memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+       if (ageIsNull(i)) {
+           nullsIndicator[0] = 0x40;
+       }
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameOf(i).size(), nameOf(i), ageOf(i), heightOf(i), i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+
+   // every operator on every type, a null age meets none of them
+   CompOp ops[] = { EQ_OP, LT_OP, GT_OP, LE_OP, GE_OP, NE_OP };
+   int age = 25;
+   float height = 10.0;
+   string name = "mm";
+   char nameValue[sizeof(int) + 2];
+   int nameLength = name.size();
+   memcpy(nameValue, &nameLength, sizeof(int));
+   memcpy(nameValue + sizeof(int), name.c_str(), nameLength);
+   for (unsigned o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+       vector<bool> ages(numRecords), heights(numRecords), names(numRecords);
+       for (int i = 0; i < numRecords; i++) {
+           ages[i] = !ageIsNull(i) && holds(ageOf(i), ops[o], age);
+           heights[i] = holds(heightOf(i), ops[o], height);
+           names[i] = holds(nameOf(i), ops[o], name);
+       }
+       int count = checkScan(rbfm, fileHandle, recordDescriptor, "Age", ops[o], &age, ages, returnedData);
+       assert(count > 0 && "Some ages should meet the condition.");
+       count = checkScan(rbfm, fileHandle, recordDescriptor, "Height", ops[o], &height, heights, returnedData);
+       assert(count > 0 && "Some heights should meet the condition.");
+       count = checkScan(rbfm, fileHandle, recordDescriptor, "EmpName", ops[o], nameValue, names, returnedData);
+       assert(count > 0 && "Some names should meet the condition.");
+   }
+
+   // no condition takes the records with a null age too, and needs no attribute
+   vector<bool> all(numRecords, true);
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, "Age", NO_OP, NULL, all, returnedData) == numRecords && "Every record should come back.");
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, "", NO_OP, NULL, all, returnedData) == numRecords && "Every record should come back.");
+
+   // the value is taken when the scan starts
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   int salary = 10;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", LT_OP, &salary, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   salary = numRecords;
+   RID rid;
+   int count = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       count++;
+   }
+   scanIterator.close();
+   assert(count == 10 && "Changing the value after the scan started should not change the scan.");
+
+   // a condition on an attribute the records do not have, or without a value
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Weight", EQ_OP, &salary, attributes, scanIterator);
+   assert(rc != success && "Scanning on an unknown attribute should fail.");
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", EQ_OP, NULL, attributes, scanIterator);
+   assert(rc != success && "Scanning without a value should fail.");
+
+   // the cost per record of no condition and of one
+   for (int pass = 0; pass < 2; pass++) {
+       CompOp op = pass == 0 ? NO_OP : GE_OP;
+       salary = 0;
+       rc = rbfm->scan(fileHandle, recordDescriptor, "Salary", op, &salary, attributes, scanIterator);
+       assert(rc == success && "Scanning the file should not fail.");
+       count = 0;
+       uint64_t start = ioClock();
+       while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+           count++;
+       }
+       cout << (pass == 0 ? "no condition " : "salary >= 0 ") << (double) (ioClock() - start) / count << " ns per record" << endl;
+       scanIterator.close();
+       assert(count == numRecords && "Every record should come back.");
+   }
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 32 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test the conditions of a scan
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test32");
+
+   RC rcmain = RBFTest_32(rbfm);
+   return rcmain;
+}
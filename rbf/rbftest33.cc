@@ -0,0 +1,151 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_33(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Scan a batch at a time, against a record at a time
+   // 2. Batches of every capacity, over deleted and moved records
+   // 3. Batches of records larger than a page between them
+   cout << endl << "***** In RBF Test Case 33 *****" << endl;
+
+   RC rc;
+   string fileName = "test33";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   int recordSize = 0;
+
+   // records of many sizes, a few of them nearly a page long
+   int numRecords = 5000;
+   vector<RID> rids;
+   for (int i = 0; i < numRecords; i++) {
+       int nameLength = i % 500 == 0 ? PAGE_SIZE / 2 : i % 30 + 1;
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, string(nameLength, 'a' + i % 26), i % 60, 160.5, i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+       rids.push_back(rid);
+   }
+
+   // some records go, some move to another page
+   for (int i = 3; i < numRecords; i += 11) {
+       rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+       assert(rc == success && "Deleting a record should not fail.");
+   }
+   for (int i = 5; i < numRecords; i += 97) {
+       if (i % 11 == 3) {
+           continue;
+       }
+       int nameLength = PAGE_SIZE / 3;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, string(nameLength, 'z'), i % 60, 160.5, i, record, &recordSize);
+       rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+       assert(rc == success && "Updating a record should not fail.");
+   }
+
+   vector<string> attributes;
+   attributes.push_back("EmpName");
+   attributes.push_back("Salary");
+   int age = 30;
+
+   // what a record at a time gives
+   vector<RID> expectedRids;
+   vector<string> expectedData;
+   RBFM_ScanIterator scanIterator;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &age, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   uint64_t start = ioClock();
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       int length;
+       memcpy(&length, (char *) returnedData + 1, sizeof(int));
+       expectedRids.push_back(rid);
+       expectedData.push_back(string((char *) returnedData, 1 + sizeof(int) + length + sizeof(int)));
+   }
+   double recordNanos = (double) (ioClock() - start) / expectedRids.size();
+   scanIterator.close();
+   assert(expectedRids.size() > 1000 && "The scan should return records.");
+
+   // every capacity gives the same records in the same order, in full batches
+   unsigned capacities[] = { 1, 7, RECORD_BATCH_SIZE, 100000 };
+   for (unsigned c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+       RecordBatch batch(capacities[c]);
+       rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &age, attributes, scanIterator);
+       assert(rc == success && "Scanning the file should not fail.");
+       unsigned count = 0;
+       unsigned batches = 0;
+       bool partial = false;
+       start = ioClock();
+       while (scanIterator.getNextBatch(batch) != RBFM_EOF) {
+           assert(batch.size() > 0 && batch.size() <= capacities[c] && !partial && "Only the last batch should be short.");
+           partial = !batch.isFull();
+           for (unsigned i = 0; i < batch.size(); i++, count++) {
+               assert(count < expectedRids.size() && "The batches should not return more records.");
+               assert(batch.getRID(i).pageNum == expectedRids[count].pageNum && batch.getRID(i).slotNum == expectedRids[count].slotNum && "The RIDs should come in scan order.");
+               assert(batch.getLength(i) == expectedData[count].size() && memcmp(batch.getData(i), expectedData[count].data(), batch.getLength(i)) == 0 && "The data should be what getNextRecord gives.");
+           }
+           batches++;
+       }
+       double batchNanos = (double) (ioClock() - start) / max(count, 1u);
+       assert(count == expectedRids.size() && "The batches should return every record.");
+       assert(scanIterator.getNextBatch(batch) == RBFM_EOF && batch.size() == 0 && "A finished scan should stay finished.");
+       scanIterator.close();
+       cout << "capacity " << capacities[c] << ": " << batches << " batches, " << batchNanos << " ns per record, "
+            << recordNanos << " ns a record at a time" << endl;
+   }
+
+   // a scan that meets nothing gives no batch
+   age = -1;
+   RecordBatch batch;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &age, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   assert(scanIterator.getNextBatch(batch) == RBFM_EOF && batch.size() == 0 && "No record should meet the condition.");
+   scanIterator.close();
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 33 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test scanning a batch at a time
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test33");
+
+   RC rcmain = RBFTest_33(rbfm);
+   return rcmain;
+}
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <algorithm>
+
+#include "pfm.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Values of record i, the age of every seventh record is null
+static string nameOf(int i) { return string(i % 5 + 1, 'a' + i % 26); }
+static bool ageIsNull(int i) { return i % 7 == 0; }
+static int ageOf(int i) { return i % 50; }
+static float heightOf(int i) { return (i % 40) * 0.5; }
+
+static ScanPredicate predicate(const string &attribute, CompOp op, const void *value)
+{
+   ScanPredicate p = { attribute, op, value };
+   return p;
+}
+
+// Scan on the groups and check the salaries that come back against the records that meet them
+static int checkScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                     const vector<ScanConjunction> &groups, const vector<bool> &expected, void *returnedData)
+{
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   RC rc = rbfm->scan(fileHandle, recordDescriptor, groups, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   int count = 0;
+   vector<bool> seen(expected.size(), false);
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       int salary;
+       memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+       assert(salary >= 0 && salary < (int) expected.size() && expected[salary] && !seen[salary] && "Only the records that meet the conditions should come back, once.");
+       seen[salary] = true;
+       count++;
+   }
+   scanIterator.close();
+   for (unsigned i = 0; i < expected.size(); i++) {
+       assert((!expected[i] || seen[i]) && "Every record that meets the conditions should come back.");
+   }
+   return count;
+}
+
+int RBFTest_34(RecordBasedFileManager *rbfm)
+{
+   // Functions Tested:
+   // 1. Scan on every condition of a conjunction, over ints, reals, strings and nulls
+   // 2. Scan on groups of conditions, a record meeting any group
+   // 3. Scan on conditions that always hold or cannot be decoded
+   // 4. Scan on several conditions a batch at a time
+   cout << endl << "***** In RBF Test Case 34 *****" << endl;
+
+   RC rc;
+   string fileName = "test34";
+   rc = rbfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = rbfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   vector<Attribute> recordDescriptor;
+   createRecordDescriptor(recordDescriptor);
+   int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+   unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+   void *record = malloc(PAGE_SIZE);
+   void *returnedData = malloc(PAGE_SIZE);
+   int recordSize = 0;
+
+   int numRecords = 5000;
+   for (int i = 0; i < numRecords; i++) {
+       memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+       if (ageIsNull(i)) {
+           nullsIndicator[0] = 0x40;
+       }
+       RID rid;
+       prepareRecord(recordDescriptor.size(), nullsIndicator, nameOf(i).size(), nameOf(i), ageOf(i), heightOf(i), i, record, &recordSize);
+       rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+       assert(rc == success && "Inserting a record should not fail.");
+   }
+
+   int age = 20;
+   float height = 5.0;
+   int salary = 4000;
+   string name = "ccc";
+   char nameValue[sizeof(int) + 3];
+   int nameLength = name.size();
+   memcpy(nameValue, &nameLength, sizeof(int));
+   memcpy(nameValue + sizeof(int), name.c_str(), nameLength);
+
+   // every condition of the conjunction holds, whatever order they are given in.
+   // A null age meets no condition on it
+   ScanConjunction conditions;
+   conditions.push_back(predicate("Age", GE_OP, &age));
+   conditions.push_back(predicate("EmpName", LT_OP, nameValue));
+   conditions.push_back(predicate("Height", NE_OP, &height));
+   conditions.push_back(predicate("Salary", LT_OP, &salary));
+   vector<bool> expected(numRecords);
+   for (int i = 0; i < numRecords; i++) {
+       expected[i] = !ageIsNull(i) && ageOf(i) >= age && nameOf(i) < name && heightOf(i) != height && i < salary;
+   }
+   vector<ScanConjunction> groups(1, conditions);
+   int count = checkScan(rbfm, fileHandle, recordDescriptor, groups, expected, returnedData);
+   assert(count > 0 && "Some records should meet every condition.");
+   reverse(groups[0].begin(), groups[0].end());
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, groups, expected, returnedData) == count && "The order of the conditions should not matter.");
+
+   // a record meets the groups if it meets every condition of one of them
+   int lowSalary = 100;
+   int nullAge = 0;
+   ScanConjunction second;
+   second.push_back(predicate("Salary", LT_OP, &lowSalary));
+   ScanConjunction third;
+   third.push_back(predicate("Age", EQ_OP, &nullAge));
+   third.push_back(predicate("EmpName", EQ_OP, nameValue));
+   groups.push_back(second);
+   groups.push_back(third);
+   for (int i = 0; i < numRecords; i++) {
+       expected[i] = expected[i] || i < lowSalary || (!ageIsNull(i) && ageOf(i) == nullAge && nameOf(i) == name);
+   }
+   count = checkScan(rbfm, fileHandle, recordDescriptor, groups, expected, returnedData);
+   assert(count > 0 && "Some records should meet the groups.");
+
+   // the same scan a batch at a time
+   vector<string> attributes;
+   attributes.push_back("Salary");
+   RBFM_ScanIterator scanIterator;
+   RecordBatch batch(64);
+   rc = rbfm->scan(fileHandle, recordDescriptor, groups, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   int batchCount = 0;
+   while (scanIterator.getNextBatch(batch) != RBFM_EOF) {
+       for (unsigned i = 0; i < batch.size(); i++, batchCount++) {
+           int batchSalary;
+           memcpy(&batchSalary, (char *) batch.getData(i) + 1, sizeof(int));
+           assert(expected[batchSalary] && "Only the records that meet the groups should come back.");
+       }
+   }
+   scanIterator.close();
+   assert(batchCount == count && "The batches should return every record that meets the groups.");
+
+   // a condition that always holds drops out of its group, a group left empty
+   // takes every record, as does a scan on no group at all
+   vector<bool> all(numRecords, true);
+   ScanConjunction always;
+   always.push_back(predicate("", NO_OP, NULL));
+   groups.push_back(always);
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, groups, all, returnedData) == numRecords && "Every record should come back.");
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, vector<ScanConjunction>(), all, returnedData) == numRecords && "Every record should come back.");
+   conditions.push_back(predicate("Weight", NO_OP, NULL));
+   for (int i = 0; i < numRecords; i++) {
+       expected[i] = !ageIsNull(i) && ageOf(i) >= age && nameOf(i) < name && heightOf(i) != height && i < salary;
+   }
+   assert(checkScan(rbfm, fileHandle, recordDescriptor, vector<ScanConjunction>(1, conditions), expected, returnedData) > 0 && "NO_OP should not change the conjunction.");
+
+   // a single condition given as a conjunction matches the scan on one
+   ScanConjunction single(1, predicate("Age", LT_OP, &age));
+   rc = rbfm->scan(fileHandle, recordDescriptor, single, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   RID rid;
+   count = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       count++;
+   }
+   scanIterator.close();
+   int singleCount = 0;
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &age, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       singleCount++;
+   }
+   scanIterator.close();
+   assert(count == singleCount && count > 0 && "A conjunction of one condition should be the scan on it.");
+
+   // any condition on an attribute the records do not have, or without a value, fails the scan
+   conditions.push_back(predicate("Weight", EQ_OP, &age));
+   rc = rbfm->scan(fileHandle, recordDescriptor, conditions, attributes, scanIterator);
+   assert(rc != success && "Scanning on an unknown attribute should fail.");
+   conditions.back() = predicate("Age", EQ_OP, NULL);
+   rc = rbfm->scan(fileHandle, recordDescriptor, conditions, attributes, scanIterator);
+   assert(rc != success && "Scanning without a value should fail.");
+   conditions.pop_back();
+
+   // the cost per record of the conjunction tested in the scan, and of the
+   // scan on one of its conditions with the rest tested on the copy it gives
+   attributes.clear();
+   attributes.push_back("EmpName");
+   attributes.push_back("Age");
+   attributes.push_back("Height");
+   attributes.push_back("Salary");
+   uint64_t start = ioClock();
+   rc = rbfm->scan(fileHandle, recordDescriptor, conditions, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   count = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       count++;
+   }
+   scanIterator.close();
+   double pushedNanos = (double) (ioClock() - start) / numRecords;
+   start = ioClock();
+   rc = rbfm->scan(fileHandle, recordDescriptor, "Height", NE_OP, &height, attributes, scanIterator);
+   assert(rc == success && "Scanning the file should not fail.");
+   int filtered = 0;
+   while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+       char *field = (char *) returnedData + 1;
+       int length;
+       memcpy(&length, field, sizeof(int));
+       string recordName(field + sizeof(int), length);
+       field += sizeof(int) + length;
+       if (((unsigned char *) returnedData)[0] & 0x40) {
+           continue;
+       }
+       int recordAge;
+       int recordSalary;
+       memcpy(&recordAge, field, sizeof(int));
+       memcpy(&recordSalary, field + sizeof(int) + sizeof(float), sizeof(int));
+       if (recordAge >= age && recordName < name && recordSalary < salary) {
+           filtered++;
+       }
+   }
+   scanIterator.close();
+   double filteredNanos = (double) (ioClock() - start) / numRecords;
+   assert(count == filtered && "Both ways should find the same records.");
+   cout << "conjunction in the scan " << pushedNanos << " ns per record, tested on the copies "
+        << filteredNanos << " ns" << endl;
+
+   rc = rbfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = rbfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(record);
+   free(returnedData);
+   free(nullsIndicator);
+
+   cout << "[PASS] Test Case 34 Passed!" << endl << endl;
+
+   return 0;
+}
+
+int main()
+{
+	// To test scans on several conditions
+   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+   remove("test34");
+
+   RC rcmain = RBFTest_34(rbfm);
+   return rcmain;
+}
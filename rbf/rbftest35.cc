@@ -0,0 +1,123 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned NUM_PAGES = 64;
+const unsigned NUM_THREADS = 4;
+const unsigned ROUNDS = 2000;
+
+atomic<int> wrongPages(0);
+
+// Every thread owns the pages numbered like it, writes them and reads them
+// back through buffers that are not aligned, so O_DIRECT has to stage them
+void transferPages(FileHandle *fileHandle, unsigned thread)
+{
+   char *buffer = (char *) malloc(PAGE_SIZE + 1);
+   char *data = buffer + 1;
+   for(unsigned i = 0; i < ROUNDS; i++)
+   {
+       PageNum pageNum = NUM_THREADS * (i % (NUM_PAGES / NUM_THREADS)) + thread;
+       char fill = 'a' + (thread * 7 + i) % 26;
+       memset(data, fill, PAGE_SIZE);
+       if(fileHandle->writePageToDisk(pageNum, data) != success)
+       {
+           wrongPages++;
+           continue;
+       }
+       memset(data, 0, PAGE_SIZE);
+       if(fileHandle->readPageFromDisk(pageNum, data) != success)
+       {
+           wrongPages++;
+           continue;
+       }
+       for(unsigned j = 0; j < PAGE_DATA_SIZE; j++)
+       {
+           if(data[j] != fill)
+           {
+               wrongPages++;
+               break;
+           }
+       }
+   }
+   free(buffer);
+}
+
+int RBFTest_35(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Write Page To Disk / Read Page From Disk of unaligned buffers on an IO_DIRECT handle
+   // 2. The same from several threads at once
+   // 3. Header read and written through an IO_DIRECT handle
+   cout << endl << "***** In RBF Test Case 35 *****" << endl;
+
+   RC rc;
+   string fileName = "test35";
+
+   rc = pfm->createFile(fileName);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle, IO_DIRECT);
+   assert(rc == success && "Opening the file for direct I/O should not fail.");
+
+   char *data = (char *) malloc(PAGE_SIZE);
+   memset(data, 0, PAGE_SIZE);
+   for(unsigned j = 0; j < NUM_PAGES; j++)
+   {
+       rc = fileHandle.appendPage(data);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+
+   vector<thread> threads;
+   for(unsigned i = 0; i < NUM_THREADS; i++)
+   {
+       threads.push_back(thread(transferPages, &fileHandle, i));
+   }
+   for(unsigned i = 0; i < threads.size(); i++)
+   {
+       threads[i].join();
+   }
+   assert(wrongPages == 0 && "Every page should read back what its thread wrote.");
+
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   // the header went out and comes back through aligned pages
+   rc = pfm->openFile(fileName, fileHandle, IO_DIRECT);
+   assert(rc == success && "Reopening the file for direct I/O should not fail.");
+   assert(fileHandle.getNumberOfPages() == NUM_PAGES && "The header should keep the number of pages.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+   free(data);
+
+   cout << "[PASS] Test Case 35 Passed!" << endl << endl;
+   return 0;
+}
+
+int main()
+{
+   // To test direct I/O from several threads
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test35");
+
+   RC rcmain = RBFTest_35(pfm);
+   return rcmain;
+}
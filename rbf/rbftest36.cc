@@ -0,0 +1,193 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "wal.h"
+#include "iostats.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned NUM_PAGES = 64;
+const unsigned CUT_PAGES = 16;
+
+off_t logSize(const string &fileName)
+{
+    struct stat info;
+    assert(stat(LogManager::getLogName(fileName).c_str(), &info) == 0 && "The log should exist.");
+    return info.st_size;
+}
+
+// Write every page of the file filled with a character of its own for the round
+void writeRound(FileHandle &fileHandle, char *page, unsigned round)
+{
+    for (unsigned j = 0; j < NUM_PAGES; j++) {
+        memset(page, 'a' + (round + j) % 26, PAGE_SIZE);
+        RC rc = fileHandle.writePage(j, page);
+        assert(rc == success && "Writing a page should not fail.");
+    }
+}
+
+// Open a copy of the file and its log the way a crash would leave them
+void openCrashed(PagedFileManager *pfm, const string &fileName, const string &crashName, FileHandle &crashHandle)
+{
+    copyFile(fileName, crashName);
+    copyFile(LogManager::getLogName(fileName), LogManager::getLogName(crashName));
+    RC rc = pfm->openFile(crashName, crashHandle);
+    assert(rc == success && "Opening a crashed file should not fail.");
+}
+
+int RBFTest_36(PagedFileManager *pfm)
+{
+   // Functions Tested:
+   // 1. Flush of a logged file empties its log
+   // 2. Commit checkpoints a long log
+   // 3. Open File replaying the records logged after a checkpoint
+   // 4. Truncate of a logged file, the cut pages stay cut after a crash
+   // 5. Close File without records since the checkpoint syncing nothing
+   cout << endl << "***** In RBF Test Case 36 *****" << endl;
+
+   RC rc;
+   string fileName = "test36";
+   string crashName = "test36crash";
+   char *page = (char *) malloc(PAGE_SIZE);
+   char *data = (char *) malloc(PAGE_SIZE);
+
+   rc = pfm->createFile(fileName, FILE_LOGGED | FILE_CHECKSUM);
+   assert(rc == success && "Creating the file should not fail.");
+   FileHandle fileHandle;
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+
+   memset(page, 0, PAGE_SIZE);
+   for (unsigned j = 0; j < NUM_PAGES; j++) {
+       rc = fileHandle.appendPage(page);
+       assert(rc == success && "Appending a page should not fail.");
+   }
+   writeRound(fileHandle, page, 0);
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   assert(logSize(fileName) > (off_t) (NUM_PAGES * PAGE_SIZE) && "The log should hold every page.");
+
+   // The pages are in the file once flushed, the log lets go of them
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+   assert(logSize(fileName) == sizeof(LogFileHeader) && "The log should be empty after a flush.");
+
+   // Records logged after the checkpoint are replayed on top of it
+   writeRound(fileHandle, page, 1);
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   FileHandle crashHandle;
+   openCrashed(pfm, fileName, crashName, crashHandle);
+   assert(crashHandle.getNumberOfPages() == NUM_PAGES && "Replay should keep every page.");
+   for (unsigned j = 0; j < NUM_PAGES; j++) {
+       memset(data, 'a' + (1 + j) % 26, PAGE_SIZE);
+       rc = crashHandle.readPage(j, page);
+       assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "A page should have its last committed image.");
+   }
+   rc = pfm->closeFile(crashHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = pfm->destroyFile(crashName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // Committing keeps the log short however long the file is written
+   off_t longest = 0;
+   for (unsigned round = 2; round < 60; round++) {
+       writeRound(fileHandle, page, round);
+       rc = fileHandle.commit();
+       assert(rc == success && "Committing should not fail.");
+       longest = max(longest, logSize(fileName));
+   }
+   cout << "longest log " << longest << " bytes" << endl;
+   assert(longest < (off_t) (LOG_CHECKPOINT_SIZE + 2 * NUM_PAGES * PAGE_SIZE) && "Commits should checkpoint a long log.");
+
+   // Pages cut off by truncate are not brought back by a replay, even
+   // though the log had records of them
+   writeRound(fileHandle, page, 60);
+   for (unsigned j = NUM_PAGES - CUT_PAGES; j < NUM_PAGES; j++) {
+       rc = fileHandle.freePage(j);
+       assert(rc == success && "Freeing a page should not fail.");
+   }
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+
+   // not while another handle may still be writing into the log
+   FileHandle otherHandle;
+   rc = pfm->openFile(fileName, otherHandle);
+   assert(rc == success && "Opening the file again should not fail.");
+   rc = fileHandle.truncate();
+   assert(rc == success && fileHandle.getNumberOfPages() == NUM_PAGES && "A file whose log is shared should keep its pages.");
+   assert(fileHandle.getFreePageCount() == CUT_PAGES && "The pages kept should stay free.");
+   rc = pfm->closeFile(otherHandle);
+   assert(rc == success && "Closing the file should not fail.");
+
+   rc = fileHandle.truncate();
+   assert(rc == success && fileHandle.getNumberOfPages() == NUM_PAGES - CUT_PAGES && "Truncating should cut the free pages.");
+   memset(page, 'z', PAGE_SIZE);
+   rc = fileHandle.writePage(0, page);
+   assert(rc == success && "Writing a page should not fail.");
+   rc = fileHandle.commit();
+   assert(rc == success && "Committing should not fail.");
+   openCrashed(pfm, fileName, crashName, crashHandle);
+   assert(crashHandle.getNumberOfPages() == NUM_PAGES - CUT_PAGES && "Replay should not bring back the cut pages.");
+   rc = crashHandle.readPage(0, data);
+   assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "A page written after the cut should be replayed.");
+   for (unsigned j = 1; j < NUM_PAGES - CUT_PAGES; j++) {
+       memset(page, 'a' + (60 + j) % 26, PAGE_SIZE);
+       rc = crashHandle.readPage(j, data);
+       assert(rc == success && memcmp(page, data, PAGE_DATA_SIZE) == 0 && "A page kept by the cut should have its last image.");
+   }
+   rc = pfm->closeFile(crashHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   rc = pfm->destroyFile(crashName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   // a file closed with nothing logged since its checkpoint is in the file already
+   rc = fileHandle.flush();
+   assert(rc == success && "Flushing the file should not fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   IOStats *stats = IOStatsManager::instance()->getStats(fileName);
+   uint64_t syncs, count, bytes, sequential, random, nanos;
+   stats->collectOpValues(IO_OP_SYNC, syncs, bytes, sequential, random, nanos);
+   rc = pfm->openFile(fileName, fileHandle);
+   assert(rc == success && "Opening the file should not fail.");
+   rc = fileHandle.readPage(0, data);
+   assert(rc == success && "Reading a page should not fail.");
+   rc = pfm->closeFile(fileHandle);
+   assert(rc == success && "Closing the file should not fail.");
+   stats->collectOpValues(IO_OP_SYNC, count, bytes, sequential, random, nanos);
+   assert(count == syncs && "A clean close with an empty log should not sync the file.");
+   assert(logSize(fileName) == sizeof(LogFileHeader) && "The log should stay empty.");
+
+   rc = pfm->destroyFile(fileName);
+   assert(rc == success && "Destroying the file should not fail.");
+
+   free(page);
+   free(data);
+
+   cout << "[PASS] Test Case 36 Passed!" << endl << endl;
+   return 0;
+}
+
+int main()
+{
+   // To test checkpoints of the log
+   PagedFileManager *pfm = PagedFileManager::instance();
+
+   remove("test36");
+   remove("test36crash");
+   remove(LogManager::getLogName("test36").c_str());
+   remove(LogManager::getLogName("test36crash").c_str());
+
+   RC rcmain = RBFTest_36(pfm);
+   return rcmain;
+}
@@ -26,6 +26,23 @@ bool FileExists(string &fileName)
 }
 
 
+// Copy a file the way a crash would leave it, nothing the process still holds gets in
+void copyFile(const string &from, const string &to)
+{
+    char *buffer = (char *) malloc(PAGE_SIZE);
+    int in = open(from.c_str(), O_RDONLY);
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(in != -1 && out != -1 && "Copying a file should not fail.");
+    ssize_t n;
+    while ((n = read(in, buffer, PAGE_SIZE)) > 0) {
+        assert(write(out, buffer, n) == n && "Copying a file should not fail.");
+    }
+    close(in);
+    close(out);
+    free(buffer);
+}
+
+
 // Calculate actual bytes for nulls-indicator for the given field counts
 int getActualByteForNullsIndicator(int fieldCount) {
 
@@ -0,0 +1,506 @@
+#include "wal.h"
+#include "iostats.h"
+
+#include <errno.h>
+
+LogManager* LogManager::_log_manager = 0;
+
+LogManager* LogManager::instance()
+{
+    if(!_log_manager)
+        _log_manager = new LogManager();
+
+    return _log_manager;
+}
+
+
+LogManager::LogManager()
+{
+}
+
+
+LogManager::~LogManager()
+{
+}
+
+
+RC LogManager::openLog(const string &fileName, WriteAheadLog *&log, bool &first)
+{
+    lock_guard<mutex> guard(logsLock);
+    auto it = logs.find(fileName);
+    if (it != logs.end()) {
+        it->second.users++;
+        log = it->second.log;
+        first = false;
+        return 0;
+    }
+
+    log = new WriteAheadLog(IOStatsManager::instance()->openStats(fileName));
+    if (log->open(getLogName(fileName)) == -1) {
+        delete log;
+        log = NULL;
+        return -1;
+    }
+    OpenLog openLog;
+    openLog.log = log;
+    openLog.users = 1;
+    openLog.unflushed = false;
+    logs[fileName] = openLog;
+    first = true;
+    return 0;
+}
+
+
+RC LogManager::closeLog(WriteAheadLog *log, bool flushed)
+{
+    lock_guard<mutex> guard(logsLock);
+    for (auto it = logs.begin(); it != logs.end(); ++it) {
+        if (it->second.log != log) {
+            continue;
+        }
+        if (!flushed) {
+            it->second.unflushed = true;
+        }
+        if (--it->second.users > 0) {
+            return 0;
+        }
+
+        // every change the records describe is in the file now, a log
+        // without records is left as it is
+        RC rc = 0;
+        if (!it->second.unflushed && !log->isEmpty()) {
+            rc = log->truncate(log->getEndLSN());
+        }
+        delete log;
+        logs.erase(it);
+        return rc;
+    }
+    return -1;
+}
+
+
+bool LogManager::isShared(WriteAheadLog *log)
+{
+    lock_guard<mutex> guard(logsLock);
+    for (auto it = logs.begin(); it != logs.end(); ++it) {
+        if (it->second.log == log) {
+            return it->second.users > 1;
+        }
+    }
+    return false;
+}
+
+
+RC LogManager::truncateLog(WriteAheadLog *log, uint64_t lsn)
+{
+    lock_guard<mutex> guard(logsLock);
+    for (auto it = logs.begin(); it != logs.end(); ++it) {
+        if (it->second.log != log) {
+            continue;
+        }
+        if (log->truncate(lsn) == -1) {
+            return -1;
+        }
+        // whatever a user left behind unwritten is in the file now too
+        it->second.unflushed = false;
+        return 0;
+    }
+    return -1;
+}
+
+
+RC LogManager::destroyLog(const string &fileName)
+{
+    if (std::remove(getLogName(fileName).c_str()) == -1 && errno != ENOENT) {
+        return -1;
+    }
+    return 0;
+}
+
+
+// FNV-1a, enough to tell a record from the torn remains of one
+static unsigned checksum(const char *data, size_t length)
+{
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+WriteAheadLog::WriteAheadLog(IOStats *ioStats) : ioStats(ioStats)
+{
+    fd = -1;
+    startLSN = 0;
+    writtenLSN = 0;
+    nextLSN = 0;
+    durableLSN = 0;
+    syncing = false;
+    recordCounter = 0;
+    syncCounter = 0;
+}
+
+
+WriteAheadLog::~WriteAheadLog()
+{
+    if (fd != -1) {
+        close(fd);
+    }
+    IOStatsManager::instance()->closeStats(ioStats);
+}
+
+
+RC WriteAheadLog::open(const string &logName)
+{
+    this->logName = logName;
+    fd = ::open(logName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+
+    LogFileHeader header;
+    ssize_t done = pread(fd, &header, sizeof(LogFileHeader), 0);
+    if (done == 0) {
+        // a new log
+        header.magic = LOG_MAGIC;
+        header.reserved = 0;
+        header.startLSN = 0;
+        if (pwrite(fd, &header, sizeof(LogFileHeader), 0) != (ssize_t) sizeof(LogFileHeader)) {
+            return -1;
+        }
+    } else if (done != (ssize_t) sizeof(LogFileHeader) || header.magic != LOG_MAGIC) {
+        return -1;
+    }
+
+    // records already in the file are durable as far as we are concerned, the
+    // end of them is found by replay
+    struct stat buffer;
+    if (fstat(fd, &buffer) == -1) {
+        return -1;
+    }
+    startLSN = header.startLSN;
+    nextLSN = startLSN + (buffer.st_size - sizeof(LogFileHeader));
+    writtenLSN = nextLSN;
+    durableLSN = nextLSN;
+    return 0;
+}
+
+
+RC WriteAheadLog::logPage(PageNum pageNum, const void *before, const void *after, uint64_t &lsn)
+{
+    // collect the changed ranges a word at a time, short unchanged gaps are
+    // logged along with their neighbours
+    vector<LogRange> ranges;
+    if (before != NULL) {
+        const char *oldPage = (const char *) before;
+        const char *newPage = (const char *) after;
+        for (unsigned offset = 0; offset < PAGE_SIZE; offset += sizeof(uint64_t)) {
+            if (memcmp(oldPage + offset, newPage + offset, sizeof(uint64_t)) == 0) {
+                continue;
+            }
+            if (!ranges.empty() && offset - (ranges.back().offset + ranges.back().length) <= LOG_RANGE_GAP) {
+                ranges.back().length = offset + sizeof(uint64_t) - ranges.back().offset;
+                continue;
+            }
+            LogRange range;
+            range.offset = offset;
+            range.length = sizeof(uint64_t);
+            ranges.push_back(range);
+        }
+        if (ranges.empty()) {
+            // nothing changed, nothing to redo
+            lsn = 0;
+            return 0;
+        }
+    }
+
+    unsigned length = sizeof(LogRecordHeader);
+    for (unsigned i = 0; i < ranges.size(); i++) {
+        length += sizeof(LogRange) + ranges[i].length;
+    }
+    if (before == NULL) {
+        length += PAGE_SIZE;
+    }
+
+    lock_guard<mutex> guard(logLock);
+    size_t start = buffer.size();
+    buffer.resize(start + length);
+    char *record = &buffer[start];
+    LogRecordHeader header;
+    header.length = length;
+    header.checksum = 0;
+    header.pageNum = pageNum;
+    header.numRanges = ranges.size();
+    memcpy(record, &header, sizeof(LogRecordHeader));
+    unsigned offset = sizeof(LogRecordHeader);
+    for (unsigned i = 0; i < ranges.size(); i++) {
+        memcpy(record + offset, &ranges[i], sizeof(LogRange));
+        offset += sizeof(LogRange);
+        memcpy(record + offset, (const char *) after + ranges[i].offset, ranges[i].length);
+        offset += ranges[i].length;
+    }
+    if (before == NULL) {
+        memcpy(record + offset, (const char *) after, PAGE_SIZE);
+    }
+    header.checksum = checksum(record + 2 * sizeof(unsigned), length - 2 * sizeof(unsigned));
+    memcpy(record + sizeof(unsigned), &header.checksum, sizeof(unsigned));
+
+    nextLSN += length;
+    lsn = nextLSN;
+    recordCounter++;
+
+    // a full buffer goes to the file, syncing it is left to the committers
+    if (buffer.size() >= LOG_BUFFER_SIZE) {
+        return writeBuffer();
+    }
+    return 0;
+}
+
+
+RC WriteAheadLog::writeBuffer()
+{
+    uint64_t start = ioClock();
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t written = pwrite(fd, &buffer[done], buffer.size() - done, logOffset(writtenLSN + done));
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        done += written;
+    }
+    ioStats->record(IO_OP_LOG_WRITE, logOffset(writtenLSN), buffer.size(), ioClock() - start);
+    writtenLSN += buffer.size();
+    buffer.clear();
+    return 0;
+}
+
+
+RC WriteAheadLog::force(uint64_t lsn)
+{
+    unique_lock<mutex> guard(logLock);
+    while (durableLSN < lsn) {
+        if (syncing) {
+            // the sync under way may already cover us
+            synced.wait(guard);
+            continue;
+        }
+
+        // everything buffered so far goes out with one write and one fsync,
+        // records appended meanwhile wait for the next committer
+        syncing = true;
+        uint64_t target = nextLSN;
+        vector<char> records;
+        records.swap(buffer);
+        uint64_t from = writtenLSN;
+        writtenLSN = target;
+        guard.unlock();
+
+        RC rc = 0;
+        uint64_t start = ioClock();
+        size_t done = 0;
+        while (rc == 0 && done < records.size()) {
+            ssize_t written = pwrite(fd, &records[done], records.size() - done, logOffset(from + done));
+            if (written == -1 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                rc = -1;
+            } else {
+                done += written;
+            }
+        }
+        if (rc == 0 && !records.empty()) {
+            ioStats->record(IO_OP_LOG_WRITE, logOffset(from), records.size(), ioClock() - start);
+        }
+        start = ioClock();
+        if (rc == 0 && fdatasync(fd) == -1) {
+            rc = -1;
+        }
+        if (rc == 0) {
+            ioStats->record(IO_OP_LOG_SYNC, -1, 0, ioClock() - start);
+        }
+
+        guard.lock();
+        syncing = false;
+        syncCounter++;
+        if (rc == 0) {
+            durableLSN = target;
+        }
+        synced.notify_all();
+        if (rc == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+uint64_t WriteAheadLog::getEndLSN()
+{
+    lock_guard<mutex> guard(logLock);
+    return nextLSN;
+}
+
+
+bool WriteAheadLog::isEmpty()
+{
+    lock_guard<mutex> guard(logLock);
+    return nextLSN == startLSN;
+}
+
+
+uint64_t WriteAheadLog::getSize()
+{
+    lock_guard<mutex> guard(logLock);
+    return nextLSN - startLSN;
+}
+
+
+RC WriteAheadLog::replay(FileHandle &fileHandle, unsigned &numPages)
+{
+    lock_guard<mutex> guard(logLock);
+    size_t size = nextLSN - startLSN;
+    char *records = (char *) malloc(size);
+    if (records == NULL && size != 0) {
+        return -1;
+    }
+    if (size != 0 && pread(fd, records, size, sizeof(LogFileHeader)) != (ssize_t) size) {
+        free(records);
+        return -1;
+    }
+
+    // consecutive records of a page are applied to one copy of it
+    RC rc = 0;
+    char *page = (char *) malloc(PAGE_SIZE);
+    PageNum pageNum = NO_PAGE;
+    size_t offset = 0;
+    while (rc == 0 && offset + sizeof(LogRecordHeader) <= size) {
+        LogRecordHeader header;
+        memcpy(&header, records + offset, sizeof(LogRecordHeader));
+        // the log ends at the first record that was not completely written
+        if (header.length < sizeof(LogRecordHeader) || header.length > size - offset
+            || header.checksum != checksum(records + offset + 2 * sizeof(unsigned), header.length - 2 * sizeof(unsigned))) {
+            break;
+        }
+
+        if (header.pageNum != pageNum) {
+            if (pageNum != NO_PAGE && fileHandle.writePageToDisk(pageNum, page) == -1) {
+                rc = -1;
+                break;
+            }
+            pageNum = header.pageNum;
+            // a page past the end of the file was appended, its image is in the log.
+            // a page torn by the crash fails its checksum, so it is read unchecked
+            if (pageNum >= numPages || fileHandle.readPageFromDisk(pageNum, page, false) == -1) {
+                memset(page, 0, PAGE_SIZE);
+            }
+        }
+
+        char *body = records + offset + sizeof(LogRecordHeader);
+        if (header.numRanges == 0) {
+            memcpy(page, body, PAGE_SIZE);
+        }
+        for (unsigned i = 0; i < header.numRanges; i++) {
+            LogRange range;
+            memcpy(&range, body, sizeof(LogRange));
+            body += sizeof(LogRange);
+            if (range.offset + range.length <= PAGE_SIZE) {
+                memcpy(page + range.offset, body, range.length);
+            }
+            body += range.length;
+        }
+        numPages = max(numPages, pageNum + 1);
+        offset += header.length;
+    }
+    if (rc == 0 && pageNum != NO_PAGE && fileHandle.writePageToDisk(pageNum, page) == -1) {
+        rc = -1;
+    }
+    free(page);
+    free(records);
+    return rc;
+}
+
+
+RC WriteAheadLog::truncate(uint64_t lsn)
+{
+    unique_lock<mutex> guard(logLock);
+    // a committer writing records out has moved writtenLSN past them already
+    while (syncing) {
+        synced.wait(guard);
+    }
+    lsn = min(lsn, nextLSN);
+    if (lsn <= startLSN) {
+        return 0;
+    }
+
+    LogFileHeader header;
+    header.magic = LOG_MAGIC;
+    header.reserved = 0;
+    header.startLSN = lsn;
+    if (lsn == nextLSN) {
+        // nothing is kept, the log is emptied where it is
+        if (ftruncate(fd, sizeof(LogFileHeader)) == -1
+            || pwrite(fd, &header, sizeof(LogFileHeader), 0) != (ssize_t) sizeof(LogFileHeader)
+            || fdatasync(fd) == -1) {
+            return -1;
+        }
+        startLSN = nextLSN;
+        writtenLSN = nextLSN;
+        durableLSN = nextLSN;
+        buffer.clear();
+        return 0;
+    }
+
+    // the records after lsn go into a new log that replaces the old one in
+    // one rename, a crash leaves one or the other and both replay the same
+    vector<char> records(nextLSN - lsn);
+    size_t inFile = writtenLSN > lsn ? writtenLSN - lsn : 0;
+    if (inFile != 0 && pread(fd, &records[0], inFile, logOffset(lsn)) != (ssize_t) inFile) {
+        return -1;
+    }
+    if (inFile < records.size()) {
+        memcpy(&records[inFile], &buffer[buffer.size() - (records.size() - inFile)], records.size() - inFile);
+    }
+
+    string newName = logName + ".new";
+    int newFd = ::open(newName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (newFd == -1) {
+        return -1;
+    }
+    if (pwrite(newFd, &header, sizeof(LogFileHeader), 0) != (ssize_t) sizeof(LogFileHeader)
+        || pwrite(newFd, &records[0], records.size(), sizeof(LogFileHeader)) != (ssize_t) records.size()
+        || fdatasync(newFd) == -1 || rename(newName.c_str(), logName.c_str()) == -1) {
+        close(newFd);
+        std::remove(newName.c_str());
+        return -1;
+    }
+
+    // the rename is only durable once the directory is
+    size_t slash = logName.rfind('/');
+    string dirName = slash == string::npos ? "." : logName.substr(0, slash + 1);
+    int dirFd = ::open(dirName.c_str(), O_RDONLY);
+    if (dirFd != -1) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    close(fd);
+    fd = newFd;
+    startLSN = lsn;
+    writtenLSN = nextLSN;
+    durableLSN = nextLSN;
+    buffer.clear();
+    return 0;
+}
+
+
+RC WriteAheadLog::collectCounterValues(unsigned &recordCount, unsigned &syncCount)
+{
+    lock_guard<mutex> guard(logLock);
+    recordCount = recordCounter;
+    syncCount = syncCounter;
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef _wal_h_
+#define _wal_h_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "pfm.h"
+
+using namespace std;
+
+const unsigned LOG_MAGIC = 0x314c4157;          // "WAL1"
+const unsigned LOG_BUFFER_SIZE = 64 * 1024;     // records are written out once this much is buffered
+const unsigned LOG_RANGE_GAP = 8;               // unchanged bytes cheaper to log than to start a new range
+const unsigned LOG_CHECKPOINT_SIZE = 4 * 1024 * 1024;   // a commit checkpoints the file once its log is this long
+
+// First bytes of a log file, the LSN of its first record follows from startLSN
+typedef struct
+{
+    unsigned magic;
+    unsigned reserved;
+    uint64_t startLSN;           // LSNs keep growing when the log is emptied
+} LogFileHeader;
+
+// A redo record changes one page. It is followed by numRanges LogRange
+// entries each with its bytes, or by a whole page when numRanges is 0
+typedef struct
+{
+    unsigned length;             // of the whole record, this header included
+    unsigned checksum;           // of everything after this field, a torn record at the end fails it
+    PageNum pageNum;
+    unsigned numRanges;
+} LogRecordHeader;
+
+typedef struct
+{
+    unsigned offset;             // first changed byte of the page
+    unsigned length;
+} LogRange;
+
+
+// Redo log of one paged file, kept in <file>.wal and shared by every handle
+// open on the file. A record holds the bytes a record level change wrote to
+// a page, and replaying records in order gives the same page whatever part of
+// them already reached the file. The LSN of a record is the log position just
+// past it, a frame holding a logged change is only written back once the log
+// is durable up to the frame's LSN.
+//
+// Committers share fsyncs: the first one in writes and syncs everything
+// buffered so far, the ones arriving meanwhile wait for it and the next of
+// them syncs whatever they added.
+class WriteAheadLog
+{
+public:
+    WriteAheadLog(IOStats *ioStats);                                            // Transfers on the log are timed into the stats of its file
+    ~WriteAheadLog();
+
+    RC open(const string &logName);                                             // Open or create the log file
+    RC logPage(PageNum pageNum, const void *before, const void *after, uint64_t &lsn); // Append the change from before to after, NULL before logs the whole page
+    RC force(uint64_t lsn);                                                     // Make the log durable up to lsn
+    uint64_t getEndLSN();                                                       // LSN of the last record appended
+    bool isEmpty();
+    uint64_t getSize();                                                         // Bytes of records since the log was last emptied
+    RC replay(FileHandle &fileHandle, unsigned &numPages);                      // Apply every complete record to the file, numPages grows to cover them
+    RC truncate(uint64_t lsn);                                                  // Drop the records up to lsn, the pages they changed are in the file
+    RC collectCounterValues(unsigned &recordCount, unsigned &syncCount);        // Records appended and fsyncs done
+
+private:
+    int fd;
+    string logName;
+    uint64_t startLSN;
+    uint64_t writtenLSN;          // records before it are in the file
+    uint64_t nextLSN;
+    uint64_t durableLSN;
+    vector<char> buffer;          // records from writtenLSN to nextLSN
+    bool syncing;                 // a committer is writing and syncing the log
+    unsigned recordCounter;
+    unsigned syncCounter;
+    IOStats *ioStats;
+    mutex logLock;
+    condition_variable synced;
+
+    RC writeBuffer();
+    off_t logOffset(uint64_t lsn) { return sizeof(LogFileHeader) + (off_t) (lsn - startLSN); };
+};
+
+
+// Logs are shared by the handles of a file, the last one to close its log empties it.
+// A handle alone on its file empties it at a checkpoint too, see FileHandle::checkpoint
+class LogManager
+{
+public:
+    static LogManager* instance();                                              // Access to the _log_manager instance
+
+    RC openLog(const string &fileName, WriteAheadLog *&log, bool &first);       // Get the log of a file, first is set for its first user
+    RC closeLog(WriteAheadLog *log, bool flushed);                              // Release a log, flushed when every page of the handle is in the file
+    bool isShared(WriteAheadLog *log);                                          // More than one handle uses the log
+    RC truncateLog(WriteAheadLog *log, uint64_t lsn);                           // Drop the records up to lsn, every page of the file is in it
+    RC destroyLog(const string &fileName);                                      // Remove the log of a destroyed file
+    static string getLogName(const string &fileName) { return fileName + ".wal"; };
+
+protected:
+    LogManager();                                                               // Constructor
+    ~LogManager();                                                              // Destructor
+
+private:
+    static LogManager *_log_manager;
+
+    typedef struct
+    {
+        WriteAheadLog *log;
+        unsigned users;
+        bool unflushed;           // a user went away without writing its pages, keep the records
+    } OpenLog;
+    unordered_map<string, OpenLog> logs;
+    mutex logsLock;
+};
+
+#endif
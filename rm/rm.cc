@@ -16,6 +16,7 @@ RelationManager::RelationManager()
     rbfm = RecordBasedFileManager::instance();
     ix = IndexManager::instance();
     RelationManager::createCatalog();
+    holdCatalog();
 
     // Populate the indexmap
     int tableId = 0;
@@ -90,6 +91,8 @@ RelationManager::RelationManager()
 
 RelationManager::~RelationManager()
 {
+    releaseTables();
+    releaseCatalog();
     if (_rm != NULL) {
         delete _rm;
     }
@@ -142,7 +145,7 @@ RC RelationManager::createCatalog()
         return -1;
     }
 
-    return 0;
+    return holdCatalog();
 }
 
 RC RelationManager::deleteCatalog()
@@ -150,6 +153,7 @@ RC RelationManager::deleteCatalog()
     columnsDescriptor.clear();
     tablesDescriptor.clear();
     indexDescriptor.clear();
+    releaseCatalog();
 
     // return -1 if error on destroy file
     if (rbfm->destroyFile("Tables") == -1 || rbfm->destroyFile("Columns") == -1|| rbfm->destroyFile("Indexes") == -1) return -1;
@@ -157,8 +161,81 @@ RC RelationManager::deleteCatalog()
     return 0;
 }
 
+RC RelationManager::holdCatalog()
+{
+    if (!catalogHandles.empty()) {
+        return 0;
+    }
+
+    // every catalog lookup shares these handles instead of opening the files again
+    const char *catalogNames[] = { "Tables", "Columns", "Indexes" };
+    for (int i = 0; i < 3; i++) {
+        FileHandle *handle;
+        if (rbfm->shareFile(catalogNames[i], handle) == -1) {
+            releaseCatalog();
+            return -1;
+        }
+        catalogHandles.push_back(handle);
+    }
+    return 0;
+}
+
+RC RelationManager::releaseCatalog()
+{
+    RC rc = 0;
+    for (unsigned i = 0; i < catalogHandles.size(); i++) {
+        if (rbfm->releaseFile(catalogHandles[i]) == -1) {
+            rc = -1;
+        }
+    }
+    catalogHandles.clear();
+    return rc;
+}
+
+RC RelationManager::holdTable(const string &fileName, FileHandle *&handle)
+{
+    // a table file stays open between operations, closing it after every tuple
+    // would write its header and sync it and its log each time
+    auto it = tableHandles.find(fileName);
+    if (it != tableHandles.end()) {
+        handle = it->second;
+        return 0;
+    }
+    if (rbfm->shareFile(fileName, handle) == -1) {
+        return -1;
+    }
+    tableHandles[fileName] = handle;
+    return 0;
+}
+
+RC RelationManager::releaseTable(const string &fileName)
+{
+    auto it = tableHandles.find(fileName);
+    if (it == tableHandles.end()) {
+        return 0;
+    }
+    FileHandle *handle = it->second;
+    tableHandles.erase(it);
+    return rbfm->releaseFile(handle);
+}
+
+RC RelationManager::releaseTables()
+{
+    RC rc = 0;
+    for (auto it = tableHandles.begin(); it != tableHandles.end(); ++it) {
+        if (rbfm->releaseFile(it->second) == -1) {
+            rc = -1;
+        }
+    }
+    tableHandles.clear();
+    return rc;
+}
+
 RC RelationManager::createTable(const string &tableName, const vector<Attribute> &attrs)
 {
+    // a handle kept for a file destroyed behind our back must not serve the new one
+    releaseTable(tableName);
+
     // Create the new table file and error if the file already exists
     if (rbfm->createFile(tableName) == -1) {
         return -1;
@@ -188,32 +265,34 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
     }
 
     // Open the "tables" file
-    FileHandle tablesHandle;
-    if (rbfm->openFile("Tables", tablesHandle) == -1) {
+    FileHandle *tablesHandle;
+    if (rbfm->shareFile("Tables", tablesHandle) == -1) {
         return -1;
     }
 
     // Add table desc to tables
     prepareTablesRecord(maxTableId + 1, tableName, tableName, TypeUser, buffer);
-    rbfm->insertRecord(tablesHandle, this->getTablesDesc(), buffer, rid);
+    rbfm->insertRecord(*tablesHandle, this->getTablesDesc(), buffer, rid);
 
     // Close tables file
-    rbfm->closeFile(tablesHandle);
+    tablesHandle->commit();
+    rbfm->releaseFile(tablesHandle);
 
     // Open "columns" file
-    FileHandle columnsHandle;
-    if (rbfm->openFile("Columns", columnsHandle) == -1) {
+    FileHandle *columnsHandle;
+    if (rbfm->shareFile("Columns", columnsHandle) == -1) {
         return -1;
     }
 
     // Loop through attrs and iterative insert each row into the columns table
     for (int i = 0; i < attrs.size(); i++) {
         prepareColumnsRecord(maxTableId + 1, attrs[i].name, attrs[i].type, attrs[i].length, i + 1, buffer);
-        rbfm->insertRecord(columnsHandle, this->getColumnsDesc(), buffer, rid);
+        rbfm->insertRecord(*columnsHandle, this->getColumnsDesc(), buffer, rid);
     }
 
     // CLose the columns file
-    rbfm->closeFile(columnsHandle);
+    columnsHandle->commit();
+    rbfm->releaseFile(columnsHandle);
 
     free(buffer);
     return 0;
@@ -283,19 +362,22 @@ RC RelationManager::deleteTable(const string &tableName)
     }
 
     // Open "Tables" file
-    FileHandle handle;
-    if (rbfm->openFile("Tables", handle) == -1) {
+    FileHandle *handle;
+    if (rbfm->shareFile("Tables", handle) == -1) {
         return -1;
     }
+    SharedFileRef tablesRef(rbfm, handle);
 
     // Get the descriptor from the tableName
     vector<Attribute> descriptor;
     if (getAttributes("Tables", descriptor) == -1) return -1;
 
     // Delete tuple from Tables table
-    if (rbfm->deleteRecord(handle, descriptor, rid) == -1) {
+    if (rbfm->deleteRecord(*handle, descriptor, rid) == -1) {
         return -1;
     }
+    handle->commit();
+    tablesRef.release();
 
     // Initialize selection attributes
     value = malloc(sizeof(int));
@@ -304,9 +386,10 @@ RC RelationManager::deleteTable(const string &tableName)
     attributes.push_back("table-id");
 
     // Open "Columns" table"
-    if (rbfm->openFile("Columns", handle) == -1) {
+    if (rbfm->shareFile("Columns", handle) == -1) {
         return -1;
     }
+    SharedFileRef columnsRef(rbfm, handle);
 
     // Get the descriptor from the tableName
     descriptor.clear();
@@ -318,14 +401,18 @@ RC RelationManager::deleteTable(const string &tableName)
 
     if (rc != -1) {
         while (rmsi.getNextTuple(rid, buffer) != RM_EOF){
-            if (rbfm->deleteRecord(handle, descriptor, rid) == -1) {
+            if (rbfm->deleteRecord(*handle, descriptor, rid) == -1) {
+                rmsi.close();
                 return -1;
             }
         }
         rmsi.close();
     }
+    handle->commit();
+    columnsRef.release();
 
     // Destroy the file
+    releaseTable(fileName);
     rbfm->destroyFile(fileName);
 
     return 0;
@@ -335,7 +422,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
 {
     // Initialize RBFM iterator and file Handle
     RBFM_ScanIterator rbfmsi;
-    FileHandle handle;
+    FileHandle *handle;
     RID rid;
     void* data = malloc(PAGE_SIZE);
 
@@ -343,7 +430,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     vector<string> names;
     names.push_back("table-id");
 
-    if (rbfm->openFile("Tables", handle) == -1) {
+    if (rbfm->shareFile("Tables", handle) == -1) {
         return -1;
     }
 
@@ -354,12 +441,12 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     memcpy((char *) compValue + sizeof(int), tableName.c_str(), varLength);
 
     // Initialize RBFMSI to scan through table's records looking for "Columns" and extract id
-    if (rbfm->scan(handle, getTablesDesc(), "table-name", EQ_OP, compValue, names, rbfmsi)
+    if (rbfm->scan(*handle, getTablesDesc(), "table-name", EQ_OP, compValue, names, rbfmsi)
         == -1) {
 
         free(data);
         free(compValue);
-        rbfm->closeFile(handle);
+        rbfm->releaseFile(handle);
         rbfmsi.close();
         return RM_EOF;
     }
@@ -373,7 +460,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
         // If either of these 2 fields are null, return -1
         if (rbfm->isFieldNull(data, 0) || rbfm->isFieldNull(data, 1)) {
             free(data);
-            rbfm->closeFile(handle);
+            rbfm->releaseFile(handle);
             rbfmsi.close();
             return -1;
         }
@@ -384,14 +471,12 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     }
 
     // close respective objects
-    rbfm->closeFile(handle);
     rbfmsi.close();
+    rbfm->releaseFile(handle);
 
     // Open the "Columns" file
-    if (rbfm->openFile("Columns", handle) == -1) {
+    if (rbfm->shareFile("Columns", handle) == -1) {
         free(data);
-        rbfm->closeFile(handle);
-        rbfmsi.close();
         return -1;
     }
 
@@ -406,11 +491,11 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     memcpy((char *) compValue, &tableId, sizeof(int));
 
     // Scan over each row of Columns, looking for where table-id == TableID
-    if (rbfm->scan(handle, getColumnsDesc(), "table-id", EQ_OP, compValue, names, rbfmsi)
+    if (rbfm->scan(*handle, getColumnsDesc(), "table-id", EQ_OP, compValue, names, rbfmsi)
         == -1) {
         free(data);
         free(compValue);
-        rbfm->closeFile(handle);
+        rbfm->releaseFile(handle);
         rbfmsi.close();
         return RM_EOF;
     }
@@ -424,7 +509,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
         // If reading the descriptor and any of the fields are null, this is bad.
         if (rbfm->isFieldNull(data, 0) || rbfm->isFieldNull(data, 1) || rbfm->isFieldNull(data, 2)) {
             free(data);
-            rbfm->closeFile(handle);
+            rbfm->releaseFile(handle);
             rbfmsi.close();
             return -1;
         }
@@ -452,8 +537,8 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
 
     free(compValue);
     free(data);
-    rbfm->closeFile(handle);
     rbfmsi.close();
+    rbfm->releaseFile(handle);
 
     return 0;
 }
@@ -473,8 +558,8 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     }
 
     // Open the file related to tableName
-    FileHandle handle;
-    if (rbfm->openFile(fileName, handle) == -1) {
+    FileHandle *handle;
+    if (holdTable(fileName, handle) == -1) {
         return -1;
     }
 
@@ -483,10 +568,7 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     if (getAttributes(tableName, descriptor) == -1) return -1;
 
     // Insert data
-    if (rbfm->insertRecord(handle, descriptor, data, rid) == -1) return -1;
-
-    // Close the file
-    if (rbfm->closeFile(handle) == -1) return -1;
+    if (rbfm->insertRecord(*handle, descriptor, data, rid) == -1) return -1;
 
     // variables used for index insertion
     string indexFile;
@@ -500,15 +582,7 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
             // read in key
             void *key = malloc(PAGE_SIZE);
 
-            if (rbfm->openFile(fileName, handle) == -1) {
-                return -1;
-            }
-
-            rbfm->readAttribute(handle, descriptor, rid, descriptor[i].name, key);
-
-            if (rbfm->closeFile(handle) == -1) {
-                return -1;
-            }
+            rbfm->readAttribute(*handle, descriptor, rid, descriptor[i].name, key);
 
             if (ix->openFile(indexFile, indexHandle) == -1) {
                 return -1;
@@ -542,8 +616,8 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
     }
 
     // Open the file related to tableName
-    FileHandle handle;
-    if (rbfm->openFile(fileName, handle) == -1) {
+    FileHandle *handle;
+    if (holdTable(fileName, handle) == -1) {
         return -1;
     }
 
@@ -560,10 +634,7 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
     }
 
     // Delete the record
-    if (rbfm->deleteRecord(handle, descriptor, rid) == -1) return -1;
-
-    // Close the file
-    if (rbfm->closeFile(handle) == -1) return -1;
+    if (rbfm->deleteRecord(*handle, descriptor, rid) == -1) return -1;
 
     // variables used for index insertion
     string indexFile;
@@ -610,8 +681,8 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
     }
 
     // Open the file related to tableName
-    FileHandle handle;
-    if (rbfm->openFile(fileName, handle) == -1) {
+    FileHandle *handle;
+    if (holdTable(fileName, handle) == -1) {
         return -1;
     }
 
@@ -619,9 +690,7 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
     vector<Attribute> descriptor;
     if (getAttributes(tableName, descriptor) == -1) return -1;
 
-    if (rbfm->updateRecord(handle, descriptor, data, rid) == -1) return -1;
-
-    if (rbfm->closeFile(handle) == -1) return -1;
+    if (rbfm->updateRecord(*handle, descriptor, data, rid) == -1) return -1;
 
     return 0;
 }
@@ -635,8 +704,8 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
     }
 
     // Open the file related to tableName
-    FileHandle handle;
-    if (rbfm->openFile(fileName, handle) == -1) {
+    FileHandle *handle;
+    if (holdTable(fileName, handle) == -1) {
         return -1;
     }
 
@@ -644,11 +713,7 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
     vector<Attribute> descriptor;
     if (getAttributes(tableName, descriptor) == -1) return -1;
 
-    if (rbfm->readRecord(handle, descriptor, rid, data) == -1) {
-        rbfm->closeFile(handle);
-        return -1;
-    }
-    if (rbfm->closeFile(handle) == -1) return -1;
+    if (rbfm->readRecord(*handle, descriptor, rid, data) == -1) return -1;
 
     return 0;
 }
@@ -667,8 +732,8 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     }
 
     // Open the file related to tableName
-    FileHandle handle;
-    if (rbfm->openFile(fileName, handle) == -1) {
+    FileHandle *handle;
+    if (holdTable(fileName, handle) == -1) {
         return -1;
     }
 
@@ -676,11 +741,7 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     vector<Attribute> descriptor;
     if (getAttributes(tableName, descriptor) == -1) return -1;
 
-    if (rbfm->readAttribute(handle, descriptor, rid, attributeName, data) == -1){
-        rbfm->closeFile(handle);
-        return -1;
-    }
-    if (rbfm->closeFile(handle) == -1) return -1;
+    if (rbfm->readAttribute(*handle, descriptor, rid, attributeName, data) == -1) return -1;
 
     return 0;
 }
@@ -697,14 +758,14 @@ RC RelationManager::scan(const string &tableName,
     // save a point to the rbfm
     rm_ScanIterator.scanRBFM = rbfm;
 
-    FileHandle handle;
+    FileHandle *handle;
     RID rid;
     void* data = malloc(PAGE_SIZE);
 
     // Get FileName of tableName
     vector<string> names;
     names.push_back("file-name");
-    if (rbfm->openFile("Tables", handle) == -1) {
+    if (rbfm->shareFile("Tables", handle) == -1) {
         return -1;
     }
 
@@ -715,9 +776,9 @@ RC RelationManager::scan(const string &tableName,
     memcpy((char *) compValue + sizeof(int), tableName.c_str(), varLength);
 
     // Initialize RBFMSI to scan through table's records looking for "Columns" and extract id
-    if (rbfm->scan(handle, getTablesDesc(), "table-name", EQ_OP, compValue, names, rm_ScanIterator.rbfmsi)
+    if (rbfm->scan(*handle, getTablesDesc(), "table-name", EQ_OP, compValue, names, rm_ScanIterator.rbfmsi)
         == -1) {
-        rbfm->closeFile(handle);
+        rbfm->releaseFile(handle);
         return RM_EOF;
     }
 
@@ -730,6 +791,7 @@ RC RelationManager::scan(const string &tableName,
         // If the is null, return -1
         if (rbfm->isFieldNull(data, 0)) {
         	rm_ScanIterator.rbfmsi.close();
+            rbfm->releaseFile(handle);
             return -1;
         }
 
@@ -745,21 +807,24 @@ RC RelationManager::scan(const string &tableName,
         delete []name;
     }
 
-    rbfm->closeFile(handle);
     rm_ScanIterator.rbfmsi.close();
+    rbfm->releaseFile(handle);
 
     // Get the descriptor
     vector<Attribute> scanDescriptor;
     RelationManager::getAttributes(tableName, scanDescriptor);
     
     // Open the handle for the file to be scanned over, this will be attached to the rbfmsi
-    rm_ScanIterator.handle = new FileHandle;
-    if (rbfm->openFile(fileName, *rm_ScanIterator.handle) == -1) return -1;
+    if (rbfm->shareFile(fileName, rm_ScanIterator.handle) == -1) {
+        rm_ScanIterator.handle = NULL;
+        return -1;
+    }
 
     // Connecting the Iterator to the correct scan function.
     if (rbfm->scan(*rm_ScanIterator.handle, scanDescriptor, conditionAttribute, compOp, value, attributeNames, rm_ScanIterator.rbfmsi)
         == -1) {
-        rbfm->closeFile(*rm_ScanIterator.handle);
+        rbfm->releaseFile(rm_ScanIterator.handle);
+        rm_ScanIterator.handle = NULL;
         return RM_EOF;
     }
 
@@ -791,32 +856,34 @@ RC RelationManager::createSystemTable(const string &tableName, const vector<Attr
     }
 
     // Open the "tables" file
-    FileHandle tablesHandle;
-    if (rbfm->openFile("Tables", tablesHandle) == -1) {
+    FileHandle *tablesHandle;
+    if (rbfm->shareFile("Tables", tablesHandle) == -1) {
         return -1;
     }
 
     // Add table desc to tables
     prepareTablesRecord(maxTableId + 1, tableName, tableName, TypeSystem, buffer);
-    rbfm->insertRecord(tablesHandle, this->getTablesDesc(), buffer, rid);
+    rbfm->insertRecord(*tablesHandle, this->getTablesDesc(), buffer, rid);
 
     // Close tables file
-    rbfm->closeFile(tablesHandle);
+    tablesHandle->commit();
+    rbfm->releaseFile(tablesHandle);
 
     // Open "columns" file
-    FileHandle columnsHandle;
-    if (rbfm->openFile("Columns", columnsHandle) == -1) {
+    FileHandle *columnsHandle;
+    if (rbfm->shareFile("Columns", columnsHandle) == -1) {
         return -1;
     }
 
     // Loop through attrs and iterative insert each row into the columns table
     for (int i = 0; i < attrs.size(); i++) {
         prepareColumnsRecord(maxTableId + 1, attrs[i].name, attrs[i].type, attrs[i].length, i + 1, buffer);
-        rbfm->insertRecord(columnsHandle, this->getColumnsDesc(), buffer, rid);
+        rbfm->insertRecord(*columnsHandle, this->getColumnsDesc(), buffer, rid);
     }
 
     // CLose the columns file
-    rbfm->closeFile(columnsHandle);
+    columnsHandle->commit();
+    rbfm->releaseFile(columnsHandle);
 
     free(buffer);
     return 0;
@@ -1007,8 +1074,12 @@ void prepareIndexesRecord(const int tableId, const string &column, const string
 
 
 RC RM_ScanIterator::close() {
-    scanRBFM->closeFile(*handle);
-    delete handle;
+    // the record scan keeps its current page pinned until it is closed
+    rbfmsi.close();
+    if (handle != NULL) {
+        scanRBFM->releaseFile(handle);
+        handle = NULL;
+    }
     return 0;
 }
 
@@ -1124,18 +1195,19 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
     }
 
     // Open the "indexes" file
-    FileHandle indexesHandle;
-    if (rbfm->openFile("Indexes", indexesHandle) == -1) {
+    FileHandle *indexesHandle;
+    if (rbfm->shareFile("Indexes", indexesHandle) == -1) {
         return -1;
     }
 
     // add index record to indexes
     buffer = malloc(PAGE_SIZE);
     prepareIndexesRecord(tableId, attributeName, ixFileName, buffer);
-    rbfm->insertRecord(indexesHandle, this->getIndexesDesc(), buffer, rid);
+    rbfm->insertRecord(*indexesHandle, this->getIndexesDesc(), buffer, rid);
 
     // Close indexes file
-    rbfm->closeFile(indexesHandle);
+    indexesHandle->commit();
+    rbfm->releaseFile(indexesHandle);
 
     free(buffer); //This was causing double frees
 
@@ -1213,15 +1285,18 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
     }
 
     // open handle for deletion
-    FileHandle handle;
-    if (rbfm->openFile("Indexes", handle) == -1) {
+    FileHandle *handle;
+    if (rbfm->shareFile("Indexes", handle) == -1) {
         return -1;
     }
+    SharedFileRef indexesRef(rbfm, handle);
 
     // delete tuple
-    if (rbfm->deleteRecord(handle, getIndexesDesc(), rid) == -1) {
+    if (rbfm->deleteRecord(*handle, getIndexesDesc(), rid) == -1) {
         return -1;
     }
+    handle->commit();
+    indexesRef.release();
 
     // destroy the file
     if (ix->destroyFile(indexFile) == -1) {
@@ -1447,6 +1522,6 @@ RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key) {
 }
 
 RC RM_IndexScanIterator::close() {
-    // let the destructor handle freeign memory
-    return 0;
+    // let the destructor handle freeign memory, the leaf the scan stopped on is still pinned
+    return ix_ScanIterator->close();
 }
@@ -26,10 +26,31 @@ void prepareTablesRecord(const int id, const string &table, const string &file,
 void prepareColumnsRecord(const int id, const string &name, const AttrType type, const int length, const int position, void *buffer);
 void prepareIndexesRecord(const int tableId, const int columnId, const string &fileName, void *buffer);
 
+// SharedFileRef drops a reference taken with shareFile when it goes out of
+// scope, so an operation that returns early still lets go of the file
+class SharedFileRef {
+public:
+    SharedFileRef(RecordBasedFileManager *rbfm, FileHandle *handle) : rbfm(rbfm), handle(handle) {};
+    ~SharedFileRef() { release(); };
+
+    RC release() {
+        if (handle == NULL) {
+            return 0;
+        }
+        FileHandle *released = handle;
+        handle = NULL;
+        return rbfm->releaseFile(released);
+    };
+
+private:
+    RecordBasedFileManager *rbfm;
+    FileHandle *handle;
+};
+
 // RM_ScanIterator is an iteratr to go through tuples
 class RM_ScanIterator {
 public:
-    RM_ScanIterator() {}; 
+    RM_ScanIterator() { handle = NULL; }; 
     ~RM_ScanIterator() {};
 
     RBFM_ScanIterator rbfmsi;
@@ -38,6 +59,7 @@ public:
 
     // "data" follows the same format as RelationManager::insertTuple()
     RC getNextTuple(RID &rid, void *data) { return rbfmsi.getNextRecord(rid, data); };
+    RC getNextBatch(RecordBatch &batch) { return rbfmsi.getNextBatch(batch); };    // RM_EOF once no tuple is left
     RC close();
 
     // Getters and Setters
@@ -140,6 +162,11 @@ public:
     RC getTableFileNameAndAuthType(const string &tableName, string &fileName, int &authType);
     RC getIndexFileName(const string &tableName, const string &attributeName, string &indexName, RID &rid, int &tableId);
     bool doesIndexExist(const int &tableId, const string &attributeName);
+    RC holdCatalog();                 // keep the catalog files open for as long as the catalog exists
+    RC releaseCatalog();
+    RC holdTable(const string &fileName, FileHandle *&handle);   // keep a table file open between operations, like the catalog
+    RC releaseTable(const string &fileName);                      // drop the reference holdTable keeps, done before the file is destroyed
+    RC releaseTables();
 
 
     // Extra credit work (10 points)
@@ -159,6 +186,8 @@ private:
     vector<Attribute> tablesDescriptor;
     vector<Attribute> columnsDescriptor;
     vector<Attribute> indexDescriptor;
+    vector<FileHandle*> catalogHandles;   // one reference to each catalog file, taken by holdCatalog
+    unordered_map<string, FileHandle*> tableHandles;   // one reference to each table file used, taken by holdTable
 };
 
 #endif